@@ -45,7 +45,8 @@ client_static_t	cls;
 client_state_t	cl;
 // FIXME: put these on hunk?
 efrag_t			cl_efrags[MAX_EFRAGS];
-entity_t		cl_entities[MAX_EDICTS];
+entity_t		*cl_entities;		// reserved for MAX_EDICTS_LIMIT, see CL_EntityNum
+int				cl_max_entities;	// how many of them there is room for
 entity_t		cl_static_entities[MAX_STATIC_ENTITIES];
 lightstyle_t	cl_lightstyle[MAX_LIGHTSTYLES];
 dlight_t		cl_dlights[MAX_DLIGHTS];
@@ -73,7 +74,7 @@ void CL_ClearState (void)
 
 // clear other arrays	
 	memset (cl_efrags, 0, sizeof(cl_efrags));
-	memset (cl_entities, 0, sizeof(cl_entities));
+	memset (cl_entities, 0, cl_max_entities*sizeof(entity_t));
 	memset (cl_dlights, 0, sizeof(cl_dlights));
 	memset (cl_lightstyle, 0, sizeof(cl_lightstyle));
 	memset (cl_temp_entities, 0, sizeof(cl_temp_entities));
@@ -718,6 +719,12 @@ void CL_Init (void)
 {	
 	SZ_Alloc (&cls.message, 1024);
 
+	cl_entities = Sys_ReserveMemory (MAX_EDICTS_LIMIT*sizeof(entity_t));
+	if (!cl_entities)
+		Sys_Error ("CL_Init: couldn't reserve %i entities", MAX_EDICTS_LIMIT);
+	cl_max_entities = MAX_EDICTS;
+	Sys_CommitMemory (cl_entities, cl_max_entities*sizeof(entity_t));
+
 	CL_InitInput ();
 	CL_InitTEnts ();
 	
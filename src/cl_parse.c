@@ -80,8 +80,15 @@ entity_t	*CL_EntityNum (int num)
 {
 	if (num >= cl.num_entities)
 	{
-		if (num >= MAX_EDICTS)
+		if (num < 0 || num >= MAX_EDICTS_LIMIT)
 			Host_Error ("CL_EntityNum: %i is an invalid number",num);
+		if (num >= cl_max_entities)
+		{	// make room in place, entity pointers are kept all over
+			cl_max_entities = (num + 256) & ~255;
+			if (cl_max_entities > MAX_EDICTS_LIMIT)
+				cl_max_entities = MAX_EDICTS_LIMIT;
+			Sys_CommitMemory (cl_entities, cl_max_entities*sizeof(entity_t));
+		}
 		while (cl.num_entities<=num)
 		{
 			cl_entities[cl.num_entities].colormap = vid.colormap;
@@ -120,13 +127,20 @@ void CL_ParseStartSoundPacket(void)
 	else
 		attenuation = DEFAULT_SOUND_PACKET_ATTENUATION;
 	
-	channel = MSG_ReadShort ();
+	if (field_mask & SND_LARGEENTITY)
+	{
+		ent = (unsigned short)MSG_ReadShort ();
+		channel = MSG_ReadByte ();
+	}
+	else
+	{
+		channel = MSG_ReadShort ();
+		ent = channel >> 3;
+		channel &= 7;
+	}
 	sound_num = MSG_ReadByte ();
 
-	ent = channel >> 3;
-	channel &= 7;
-
-	if (ent > MAX_EDICTS)
+	if (ent < 0 || ent >= MAX_EDICTS_LIMIT)
 		Host_Error ("CL_ParseStartSoundPacket: ent = %i", ent);
 	
 	for (i=0 ; i<3 ; i++)
@@ -281,6 +295,14 @@ void CL_ParseServerInfo (void)
 		S_TouchSound (str);
 	}
 
+//
+// both lists are known now, so let the file system get ahead of the loads
+//
+	for (i=1 ; i<nummodels ; i++)
+		Mod_Prefetch (model_precache[i]);
+	for (i=1 ; i<numsounds ; i++)
+		S_PrefetchSound (sound_precache[i]);
+
 //
 // now we try to load everything else until a cache allocation fails
 //
@@ -291,6 +313,7 @@ void CL_ParseServerInfo (void)
 		if (cl.model_precache[i] == NULL)
 		{
 			Con_Printf("Model %s not found\n", model_precache[i]);
+			COM_FlushPrefetch ();
 			return;
 		}
 		CL_KeepaliveMessage ();
@@ -304,6 +327,8 @@ void CL_ParseServerInfo (void)
 	}
 	S_EndPrecaching ();
 
+	COM_FlushPrefetch ();
+
 
 // local state
 	cl_entities[0].model = cl.worldmodel = cl.model_precache[1];
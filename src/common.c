@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // common.c -- misc functions used in client and server
 
 #include "quakedef.h"
+#include "inflate.h"
 
 #define NUM_SAFE_ARGVS  7
 
@@ -1014,14 +1015,15 @@ being registered.
 */
 void COM_CheckRegistered (void)
 {
-	int             h;
-	unsigned short  check[128];
+	unsigned short  check[129];		// room for the 0 COM_LoadFile adds
+	unsigned short  *data;
 	int                     i;
 
-	COM_OpenFile("gfx/pop.lmp", &h);
+// loaded, not read off the handle, so a deflated pk3 member is inflated
+	data = (unsigned short *)COM_LoadStackFile ("gfx/pop.lmp", check, sizeof(check));
 	static_registered = 0;
 
-	if (h == -1)
+	if (!data)
 	{
 #if WINDED
 	Sys_Error ("This dedicated server requires a full registered copy of Quake");
@@ -1032,11 +1034,10 @@ void COM_CheckRegistered (void)
 		return;
 	}
 
-	Sys_FileRead (h, check, sizeof(check));
-	COM_CloseFile (h);
-	
+	if (com_filesize < 256)
+		Sys_Error ("Corrupted data file.");
 	for (i=0 ; i<128 ; i++)
-		if (pop[i] != (unsigned short)BigShort (check[i]))
+		if (pop[i] != (unsigned short)BigShort (data[i]))
 			Sys_Error ("Corrupted data file.");
 	
 	Cvar_Set ("cmdline", com_cmdline);
@@ -1047,6 +1048,8 @@ void COM_CheckRegistered (void)
 
 
 void COM_Path_f (void);
+void COM_Rescan_f (void);
+void COM_FileStats_f (void);
 
 
 /*
@@ -1151,6 +1154,8 @@ void COM_Init (char *basedir)
 	Cvar_RegisterVariable (&registered);
 	Cvar_RegisterVariable (&cmdline);
 	Cmd_AddCommand ("path", COM_Path_f);
+	Cmd_AddCommand ("path_rescan", COM_Rescan_f);
+	Cmd_AddCommand ("filestats", COM_FileStats_f);
 
 	COM_InitFilesystem ();
 	COM_CheckRegistered ();
@@ -1199,16 +1204,22 @@ QUAKE FILESYSTEM
 */
 
 int     com_filesize;
+qboolean	com_filemapped;		// last COM_Map*File call returned a pak view
 
 
 //
 // in memory
 //
 
-typedef struct
+typedef struct packfile_s
 {
 	char    name[MAX_QPATH];
-	int             filepos, filelen;
+	int             filepos, filelen;	// filepos is -1 until a zip member is opened
+	int		method;		// ZIP_STORED or ZIP_DEFLATED, always stored for paks
+	int		complen;	// bytes in the pak, filelen is the size once inflated
+	int		headerpos;	// zip local header, holds the real filepos
+	struct pack_s		*pack;		// pak file this entry lives in
+	struct packfile_s	*hashnext;	// next entry in the same com_filehash chain
 } packfile_t;
 
 typedef struct pack_s
@@ -1217,6 +1228,8 @@ typedef struct pack_s
 	int             handle;
 	int             numfiles;
 	packfile_t      *files;
+	int		order;		// position on com_searchpaths, 0 is searched first
+	int		mapping;	// Sys_FileMapOpen handle, -1 if not mapped
 } pack_t;
 
 //
@@ -1235,123 +1248,1158 @@ typedef struct
 	int             dirlen;
 } dpackheader_t;
 
-#define MAX_FILES_IN_PACK       2048
+//
+// zip files are read field by field, their records aren't aligned
+//
+#define	ZIP_LOCAL_SIG		0x04034b50
+#define	ZIP_CENTRAL_SIG		0x02014b50
+#define	ZIP_END_SIG			0x06054b50
+
+#define	ZIP_LOCAL_SIZE		30
+#define	ZIP_CENTRAL_SIZE	46
+#define	ZIP_END_SIZE		22
+
+#define	ZIP_STORED			0
+#define	ZIP_DEFLATED		8
 
 char    com_cachedir[MAX_OSPATH];
 char    com_gamedir[MAX_OSPATH];
 
+//
+// listing of a directory on the search path, so loose file lookups can be
+// answered without touching the disk
+//
+#define	DIR_HASH_SIZE	1024
+
+typedef struct dirfile_s
+{
+	char    name[MAX_QPATH];
+	struct dirfile_s	*hashnext;
+} dirfile_t;
+
+typedef struct
+{
+	int		numfiles;
+	dirfile_t	*hash[DIR_HASH_SIZE];
+} dirlist_t;
+
 typedef struct searchpath_s
 {
 	char    filename[MAX_OSPATH];
 	pack_t  *pack;          // only one of filename / pack will be used
+	dirlist_t	*dirlist;	// NULL if the directory is searched on disk
 	struct searchpath_s *next;
 } searchpath_t;
 
 searchpath_t    *com_searchpaths;
 
+//
+// every pak entry on the search path, hashed by name.  Each chain is kept in
+// search order, so the first name match on a chain is the one that overrides
+// all the others.
+//
+#define	FILE_HASH_SIZE	4096
+
+packfile_t		*com_filehash[FILE_HASH_SIZE];
+
+packfile_t		*com_foundpackfile;	// set by COM_FindFile for pak members
+char			com_foundpath[MAX_OSPATH];	// the pak or loose file COM_FindFile opened
+
+/*
+============
+COM_HashString
+============
+*/
+unsigned COM_HashString (char *s)
+{
+	unsigned	hash;
+
+	hash = 0;
+	while (*s)
+		hash = hash * 31 + (byte)*s++;
+
+	return hash;
+}
+
+/*
+============
+COM_HashFileName
+============
+*/
+unsigned COM_HashFileName (char *name)
+{
+	unsigned	hash;
+	int			c;
+
+// case is ignored so the same hash works for directory listings
+	hash = 0;
+	while (*name)
+	{
+		c = (byte)*name++;
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		hash = hash * 31 + c;
+	}
+
+	return hash;
+}
+
+/*
+============
+COM_HashSearchPaths
+
+Links the entries of every pak from search to the end of the path into
+com_filehash.  The tail of the path is hashed first so that entries from
+earlier search paths end up in front of the ones they override.
+============
+*/
+void COM_HashSearchPaths (searchpath_t *search, int order)
+{
+	pack_t			*pak;
+	packfile_t		*file;
+	unsigned		hash;
+	int				i;
+
+	if (!search)
+		return;
+
+	COM_HashSearchPaths (search->next, order + 1);
+
+	pak = search->pack;
+	if (!pak)
+		return;
+
+	pak->order = order;
+	for (i=pak->numfiles-1 ; i>=0 ; i--)
+	{
+		file = &pak->files[i];
+		file->pack = pak;
+		hash = COM_HashFileName (file->name) & (FILE_HASH_SIZE-1);
+		file->hashnext = com_filehash[hash];
+		com_filehash[hash] = file;
+	}
+}
+
+/*
+============
+COM_BuildFileHash
+
+Rebuilds the pak name index.  Must be called whenever com_searchpaths changes.
+============
+*/
+void COM_BuildFileHash (void)
+{
+	memset (com_filehash, 0, sizeof(com_filehash));
+	COM_HashSearchPaths (com_searchpaths, 0);
+}
+
+/*
+============
+COM_FindPackFile
+
+Returns the highest priority pak entry for filename that is at or after
+position order on the search path, or NULL if no pak holds it.
+============
+*/
+packfile_t *COM_FindPackFile (char *filename, int order)
+{
+	packfile_t		*file;
+
+	for (file = com_filehash[COM_HashFileName (filename) & (FILE_HASH_SIZE-1)] ; file ; file = file->hashnext)
+	{
+		if (file->pack->order < order)
+			continue;
+		if (!strcmp (file->name, filename))
+			return file;
+	}
+
+	return NULL;
+}
+
+int COM_ZipShort (byte *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+int COM_ZipLong (byte *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+}
+
+/*
+============
+COM_AddDirFile
+============
+*/
+void COM_AddDirFile (dirlist_t *list, char *name)
+{
+	dirfile_t		*file;
+	unsigned		hash;
+
+	if (strlen(name) >= MAX_QPATH)
+		return;		// can't be asked for anyway
+
+	hash = COM_HashFileName (name) & (DIR_HASH_SIZE-1);
+	for (file = list->hash[hash] ; file ; file = file->hashnext)
+		if (!Q_strcasecmp (file->name, name))
+			return;
+
+	file = malloc (sizeof(dirfile_t));
+	if (!file)
+		Sys_Error ("COM_AddDirFile: out of memory");
+	strcpy (file->name, name);
+	file->hashnext = list->hash[hash];
+	list->hash[hash] = file;
+	list->numfiles++;
+}
+
+/*
+============
+COM_FindDirFile
+
+Directory names are matched without regard to case, like the file system
+the listing came from.
+============
+*/
+qboolean COM_FindDirFile (dirlist_t *list, char *name)
+{
+	dirfile_t		*file;
+
+	for (file = list->hash[COM_HashFileName (name) & (DIR_HASH_SIZE-1)] ; file ; file = file->hashnext)
+		if (!Q_strcasecmp (file->name, name))
+			return true;
+
+	return false;
+}
+
+/*
+============
+COM_FreeDirList
+============
+*/
+void COM_FreeDirList (dirlist_t *list)
+{
+	dirfile_t		*file, *next;
+	int				i;
+
+	for (i=0 ; i<DIR_HASH_SIZE ; i++)
+	{
+		for (file = list->hash[i] ; file ; file = next)
+		{
+			next = file->hashnext;
+			free (file);
+		}
+	}
+	free (list);
+}
+
+dirlist_t	*com_listing;	// target of COM_ListFile
+
+void COM_ListFile (char *name)
+{
+	COM_AddDirFile (com_listing, name);
+}
+
+/*
+============
+COM_ListDirectory
+
+Reads the whole tree under a directory search path into memory.
+-nodircache leaves every lookup going to the disk.
+============
+*/
+void COM_ListDirectory (searchpath_t *search)
+{
+	if (search->dirlist)
+	{
+		COM_FreeDirList (search->dirlist);
+		search->dirlist = NULL;
+	}
+
+	if (COM_CheckParm ("-nodircache"))
+		return;
+
+	com_listing = malloc (sizeof(dirlist_t));
+	if (!com_listing)
+		return;
+	memset (com_listing, 0, sizeof(dirlist_t));
+
+	Sys_ListFiles (search->filename, COM_ListFile);
+
+	search->dirlist = com_listing;
+	com_listing = NULL;
+}
+
+/*
+============
+COM_AddCachedFile
+
+Files written into a directory on the search path after it was listed
+have to be added, or they won't be found until the next rescan.  Takes
+the same full path the file was written with.
+============
+*/
+void COM_AddCachedFile (char *path)
+{
+	searchpath_t    *search;
+	int				len;
+
+	for (search = com_searchpaths ; search ; search = search->next)
+	{
+		if (!search->dirlist)
+			continue;
+		len = strlen (search->filename);
+		if (!Q_strncasecmp (path, search->filename, len) && path[len] == '/')
+		{
+			COM_AddDirFile (search->dirlist, path + len + 1);
+			return;
+		}
+	}
+}
+
+/*
+============
+COM_Rescan_f
+
+Throws away the directory listings and reads them again, for when files
+have been changed behind the engine's back.
+============
+*/
+void COM_Rescan_f (void)
+{
+	searchpath_t    *search;
+	int				count;
+
+	count = 0;
+	for (search = com_searchpaths ; search ; search = search->next)
+	{
+		if (search->pack)
+			continue;
+		COM_ListDirectory (search);
+		if (search->dirlist)
+			count += search->dirlist->numfiles;
+	}
+
+	Con_Printf ("%i loose files on the search path\n", count);
+}
+
 /*
 ============
 COM_Path_f
 
-============
+============
+*/
+void COM_Path_f (void)
+{
+	searchpath_t    *s;
+	
+	Con_Printf ("Current search path:\n");
+	for (s=com_searchpaths ; s ; s=s->next)
+	{
+		if (s->pack)
+		{
+			Con_Printf ("%s (%i files)\n", s->pack->filename, s->pack->numfiles);
+		}
+		else if (s->dirlist)
+			Con_Printf ("%s (%i files)\n", s->filename, s->dirlist->numfiles);
+		else
+			Con_Printf ("%s\n", s->filename);
+	}
+}
+
+/*
+=============================================================================
+
+FILE STATISTICS
+
+Every name that goes through COM_FindFile gets a record of how often it was
+looked for, where it was found, and how long the lookups and loads took.
+"filestats" lists the most expensive ones, and -filestats writes them all
+to filestats.csv in the game directory at shutdown.
+
+=============================================================================
+*/
+
+#define	FILESTAT_HASH_SIZE	1024
+
+typedef struct filestat_s
+{
+	char		name[MAX_QPATH];
+	char		*source;		// pak or directory it was last found in
+	qboolean	packed;			// source is a pak
+	int			opens, misses;
+	int			loads, prefetched;
+	int			bytes;
+	double		findtime, readtime;
+	struct filestat_s	*hashnext;
+	struct filestat_s	*next;
+} filestat_t;
+
+filestat_t	*com_filestathash[FILESTAT_HASH_SIZE];
+filestat_t	*com_filestats;
+int			com_numfilestats;
+filestat_t	*com_foundstat;		// set by COM_FindFile
+
+/*
+============
+COM_FileStat
+
+Finds or makes the record for name
+============
+*/
+filestat_t *COM_FileStat (char *name)
+{
+	filestat_t	*stat;
+	unsigned	hash;
+
+	hash = COM_HashFileName (name) & (FILESTAT_HASH_SIZE-1);
+	for (stat = com_filestathash[hash] ; stat ; stat = stat->hashnext)
+		if (!Q_strcasecmp (stat->name, name))
+			return stat;
+
+	stat = malloc (sizeof(*stat));
+	if (!stat)
+		Sys_Error ("COM_FileStat: out of memory");
+	memset (stat, 0, sizeof(*stat));
+	Q_strncpy (stat->name, name, sizeof(stat->name)-1);
+
+	stat->hashnext = com_filestathash[hash];
+	com_filestathash[hash] = stat;
+	stat->next = com_filestats;
+	com_filestats = stat;
+	com_numfilestats++;
+
+	return stat;
+}
+
+/*
+============
+COM_CountFind
+
+Records a COM_FindFile that started at start.  A NULL source is a miss.
+============
+*/
+void COM_CountFind (char *filename, char *source, qboolean packed, double start)
+{
+	filestat_t	*stat;
+
+	stat = COM_FileStat (filename);
+	if (source)
+	{
+		stat->opens++;
+		stat->source = source;
+		stat->packed = packed;
+	}
+	else
+		stat->misses++;
+	stat->findtime += Sys_FloatTime () - start;
+
+	com_foundstat = source ? stat : NULL;
+}
+
+/*
+============
+COM_CompareFileStats
+
+Most time first
+============
+*/
+int COM_CompareFileStats (const void *a, const void *b)
+{
+	filestat_t	*sa, *sb;
+	double		ta, tb;
+
+	sa = *(filestat_t **)a;
+	sb = *(filestat_t **)b;
+	ta = sa->findtime + sa->readtime;
+	tb = sb->findtime + sb->readtime;
+
+	if (ta > tb)
+		return -1;
+	if (ta < tb)
+		return 1;
+	return Q_strcasecmp (sa->name, sb->name);
+}
+
+/*
+============
+COM_SortedFileStats
+
+Returns a malloced list of every record, most expensive first
+============
+*/
+filestat_t **COM_SortedFileStats (void)
+{
+	filestat_t	**list, *stat;
+	int			i;
+
+	list = malloc ((com_numfilestats + 1) * sizeof(*list));
+	if (!list)
+		return NULL;
+
+	i = 0;
+	for (stat = com_filestats ; stat ; stat = stat->next)
+		list[i++] = stat;
+	qsort (list, com_numfilestats, sizeof(*list), COM_CompareFileStats);
+
+	return list;
+}
+
+/*
+============
+COM_FileStats_f
+
+filestats [count | clear]
+============
+*/
+void COM_FileStats_f (void)
+{
+	filestat_t	**list, *stat;
+	int			i, count;
+	int			opens, bytes;
+	double		findtime, readtime;
+
+	if (Cmd_Argc () == 2 && !Q_strcasecmp (Cmd_Argv (1), "clear"))
+	{
+		while (com_filestats)
+		{
+			stat = com_filestats->next;
+			free (com_filestats);
+			com_filestats = stat;
+		}
+		memset (com_filestathash, 0, sizeof(com_filestathash));
+		com_numfilestats = 0;
+		com_foundstat = NULL;
+		return;
+	}
+
+	count = 20;
+	if (Cmd_Argc () == 2)
+		count = Q_atoi (Cmd_Argv (1));
+
+	list = COM_SortedFileStats ();
+	if (!list)
+		return;
+
+	Con_Printf ("  find ms   read ms opens    bytes name\n");
+	opens = bytes = 0;
+	findtime = readtime = 0;
+	for (i=0 ; i<com_numfilestats ; i++)
+	{
+		stat = list[i];
+		if (i < count)
+			Con_Printf ("%9.2f %9.2f %5i %8i %s%s\n", stat->findtime*1000,
+				stat->readtime*1000, stat->opens + stat->misses, stat->bytes,
+				stat->name, stat->opens ? (stat->packed ? "" : " (loose)") : " (missing)");
+		opens += stat->opens + stat->misses;
+		bytes += stat->bytes;
+		findtime += stat->findtime;
+		readtime += stat->readtime;
+	}
+	Con_Printf ("%9.2f %9.2f %5i %8i total for %i files\n", findtime*1000,
+		readtime*1000, opens, bytes, com_numfilestats);
+
+	free (list);
+}
+
+/*
+============
+COM_WriteFileStats
+
+Called at shutdown
+============
+*/
+void COM_WriteFileStats (void)
+{
+	filestat_t	**list, *stat;
+	char		name[MAX_OSPATH];
+	FILE		*f;
+	int			i;
+
+	if (!COM_CheckParm ("-filestats"))
+		return;
+
+	list = COM_SortedFileStats ();
+	if (!list)
+		return;
+
+	sprintf (name, "%s/filestats.csv", com_gamedir);
+	f = fopen (name, "w");
+	if (!f)
+	{
+		Sys_Printf ("Couldn't write %s\n", name);
+		free (list);
+		return;
+	}
+	COM_AddCachedFile (name);
+
+	fprintf (f, "name,source,from,opens,misses,loads,prefetched,bytes,find_ms,read_ms\n");
+	for (i=0 ; i<com_numfilestats ; i++)
+	{
+		stat = list[i];
+		fprintf (f, "%s,%s,%s,%i,%i,%i,%i,%i,%.3f,%.3f\n", stat->name,
+			stat->source ? stat->source : "",
+			stat->opens ? (stat->packed ? "pak" : "loose") : "missing",
+			stat->opens, stat->misses, stat->loads, stat->prefetched,
+			stat->bytes, stat->findtime*1000, stat->readtime*1000);
+	}
+
+	fclose (f);
+	free (list);
+}
+
+/*
+============
+COM_WriteFile
+
+The filename will be prefixed by the current game directory
+============
+*/
+void COM_WriteFile (char *filename, void *data, int len)
+{
+	int             handle;
+	char    name[MAX_OSPATH];
+	
+	sprintf (name, "%s/%s", com_gamedir, filename);
+
+	handle = Sys_FileOpenWrite (name);
+	if (handle == -1)
+	{
+		Sys_Printf ("COM_WriteFile: failed on %s\n", name);
+		return;
+	}
+	
+	Sys_Printf ("COM_WriteFile: %s\n", name);
+	Sys_FileWrite (handle, data, len);
+	Sys_FileClose (handle);
+
+	COM_AddCachedFile (name);
+}
+
+
+/*
+============
+COM_CreatePath
+
+Only used for CopyFile
+============
+*/
+void    COM_CreatePath (char *path)
+{
+	char    *ofs;
+	
+	for (ofs = path+1 ; *ofs ; ofs++)
+	{
+		if (*ofs == '/')
+		{       // create the directory
+			*ofs = 0;
+			Sys_mkdir (path);
+			*ofs = '/';
+		}
+	}
+}
+
+
+/*
+===========
+COM_CopyFile
+
+Copies a file over from the net to the local cache, creating any directories
+needed.  This is for the convenience of developers using ISDN from home.
+===========
+*/
+void COM_CopyFile (char *netpath, char *cachepath)
+{
+	int             in, out;
+	int             remaining, count;
+	char    buf[4096];
+	
+	remaining = Sys_FileOpenRead (netpath, &in);            
+	COM_CreatePath (cachepath);     // create directories up to the cache file
+	out = Sys_FileOpenWrite (cachepath);
+	
+	while (remaining)
+	{
+		if (remaining < sizeof(buf))
+			count = remaining;
+		else
+			count = sizeof(buf);
+		Sys_FileRead (in, buf, count);
+		Sys_FileWrite (out, buf, count);
+		remaining -= count;
+	}
+
+	Sys_FileClose (in);
+	Sys_FileClose (out);    
+}
+
+/*
+===========
+COM_FindZipData
+
+Zip central directories don't say exactly where a member's data starts,
+that takes a look at its local header
+===========
+*/
+void COM_FindZipData (packfile_t *file)
+{
+	byte	header[ZIP_LOCAL_SIZE];
+
+	Sys_FileSeek (file->pack->handle, file->headerpos);
+	if (Sys_FileRead (file->pack->handle, header, ZIP_LOCAL_SIZE) != ZIP_LOCAL_SIZE
+	|| COM_ZipLong (header) != ZIP_LOCAL_SIG)
+		Sys_Error ("%s has a bad header for %s", file->pack->filename, file->name);
+
+	file->filepos = file->headerpos + ZIP_LOCAL_SIZE
+		+ COM_ZipShort (header + 26) + COM_ZipShort (header + 28);
+}
+
+/*
+===========
+COM_InflateMember
+
+Inflates a zip member into dest, reading the compressed data through a pak
+view if there is one, or from the pak handle (which must already be at the
+member's data) if not.
+===========
+*/
+void COM_InflateMember (int handle, packfile_t *file, byte *dest)
+{
+	byte		*source;
+	qboolean	mapped;
+	qboolean	ok;
+
+	source = NULL;
+	mapped = false;
+	if (file->pack->mapping != -1)
+	{
+		source = Sys_FileMapView (file->pack->mapping, file->filepos, file->complen);
+		mapped = source != NULL;
+	}
+	if (!source)
+	{
+		source = malloc (file->complen);
+		if (!source)
+			Sys_Error ("COM_InflateMember: not enough memory for %s", file->name);
+		Sys_FileRead (handle, source, file->complen);
+	}
+
+	ok = Inflate (dest, file->filelen, source, file->complen);
+
+	if (mapped)
+		Sys_FileUnmapView (source);
+	else
+		free (source);
+
+	if (!ok)
+		Sys_Error ("%s is damaged in %s", file->name, file->pack->filename);
+}
+
+/*
+===========
+COM_InflateToFile
+
+Callers that want a FILE * get the inflated member in a temporary file.
+tmpfile () wants the root of the drive on Windows, where users often can't
+write, so the file goes in the game directory and is gone once closed.
+===========
+*/
+FILE *COM_InflateToFile (packfile_t *file)
+{
+	static int	count;
+	char	name[MAX_OSPATH];
+	FILE	*f;
+	byte	*buf;
+
+	sprintf (name, "%s/inflate%i.tmp", com_gamedir, count++);
+#ifdef _WIN32
+	f = fopen (name, "w+bD");	// deleted when closed
+#else
+	f = fopen (name, "w+b");
+	if (f)
+		remove (name);		// stays readable until closed
+#endif
+	if (!f)
+	{
+		Con_Printf ("Couldn't write %s for %s\n", name, file->name);
+		return NULL;
+	}
+
+	buf = malloc (file->filelen + 1);
+	if (!buf)
+		Sys_Error ("COM_InflateToFile: not enough memory for %s", file->name);
+
+	Sys_FileSeek (file->pack->handle, file->filepos);
+	COM_InflateMember (file->pack->handle, file, buf);
+	fwrite (buf, 1, file->filelen, f);
+	free (buf);
+
+	fseek (f, 0, SEEK_SET);
+	return f;
+}
+
+/*
+=============================================================================
+
+PREFETCHING
+
+When a list of files that are about to be loaded is known up front, they
+can be read on the io thread while the files before them are being parsed.
+Compressed zip members in mapped paks are inflated on the worker threads
+instead, since their data is already a view away.
+
+=============================================================================
+*/
+
+#define	MAX_PREFETCH		(MAX_MODELS+MAX_SOUNDS)
+#define	PREFETCH_MIN_SIZE	0x1000			// not worth a job below this
+#define	PREFETCH_MAX_BYTES	(32*1024*1024)	// file data held at once
+
+typedef struct
+{
+	qboolean	active;		// false once used
+	packfile_t	*file;		// pak member, or NULL for a loose file
+	char		path[MAX_OSPATH];	// the pak, or the loose file
+	int			filepos, filelen;
+	int			method, complen;
+	int			mapping;	// read through a pak view if not -1
+	byte		*data;		// file contents, NULL if the view was only touched
+	qboolean	ok;
+	sysjob_t	job;
+} prefetch_t;
+
+prefetch_t	com_prefetch[MAX_PREFETCH];
+int			com_numprefetch;
+int			com_prefetchbytes;
+
+/*
+===========
+COM_PrefetchJob
+
+Runs on the io thread or a worker, so it can't touch anything but its own
+prefetch_t.  It uses its own FILE rather than the pak handle, which the main
+thread may be seeking around in.
+===========
+*/
+void COM_PrefetchJob (void *data)
+{
+	prefetch_t		*p;
+	FILE			*f;
+	byte			*source;
+	volatile byte	*in;
+	int				i, sum;
+
+	p = (prefetch_t *)data;
+	p->ok = false;
+
+	if (p->mapping != -1)
+	{
+		source = Sys_FileMapView (p->mapping, p->filepos, p->complen);
+		if (!source)
+			return;
+
+		if (p->data)
+			p->ok = Inflate (p->data, p->filelen, source, p->complen);
+		else
+		{	// stored members are loaded as views, so just fault the pages in
+			in = source;
+			sum = 0;
+			for (i=0 ; i<p->complen ; i+=4096)
+				sum += in[i];
+			p->ok = true;
+		}
+
+		Sys_FileUnmapView (source);
+		return;
+	}
+
+	f = fopen (p->path, "rb");
+	if (!f)
+		return;
+	fseek (f, p->filepos, SEEK_SET);
+
+	if (p->method == ZIP_DEFLATED)
+	{
+		source = malloc (p->complen);
+		if (source)
+		{
+			if (fread (source, 1, p->complen, f) == p->complen)
+				p->ok = Inflate (p->data, p->filelen, source, p->complen);
+			free (source);
+		}
+	}
+	else
+		p->ok = fread (p->data, 1, p->filelen, f) == p->filelen;
+
+	fclose (f);
+}
+
+/*
+===========
+COM_FindPrefetch
+
+Looks for the file COM_FindFile just found
+===========
+*/
+prefetch_t *COM_FindPrefetch (void)
+{
+	prefetch_t	*p;
+	int			i;
+
+	for (i=0, p=com_prefetch ; i<com_numprefetch ; i++, p++)
+	{
+		if (!p->active || p->file != com_foundpackfile)
+			continue;
+		if (p->file || !Q_strcasecmp (p->path, com_foundpath))
+			return p;
+	}
+
+	return NULL;
+}
+
+/*
+===========
+COM_SearchFile
+
+Walks the search path for filename, the one search every lookup makes.
+Returns the pak or directory it is in, or NULL.  A pak member is left in
+com_foundpackfile and com_foundpath; a loose file's path goes in netpath,
+and its time in findtime when anything needs it (1 when a directory
+listing answered).
+===========
+*/
+searchpath_t *COM_SearchFile (char *filename, char *netpath, int *findtime)
+{
+	searchpath_t	*search;
+	packfile_t		*packfile;
+	int				order;
+
+	com_foundpackfile = NULL;
+
+	search = com_searchpaths;
+	order = 0;
+	if (proghack)
+	{	// gross hack to use quake 1 progs with quake 2 maps
+		if (!strcmp(filename, "progs.dat"))
+		{
+			search = search->next;
+			order = 1;
+		}
+	}
+
+// find the pak entry that wins, if any; only directories that come
+// before it on the path still need to be checked
+	packfile = COM_FindPackFile (filename, order);
+
+	for ( ; search ; search = search->next)
+	{
+	// is the element a pak file?
+		if (search->pack)
+		{
+			if (!packfile || packfile->pack != search->pack)
+				continue;
+
+			com_foundpackfile = packfile;
+			strcpy (com_foundpath, search->pack->filename);
+			if (packfile->filepos == -1)
+				COM_FindZipData (packfile);
+			return search;
+		}
+
+	// check a file in the directory tree
+		if (!static_registered)
+		{       // if not a registered version, don't ever go beyond base
+			if ( strchr (filename, '/') || strchr (filename,'\\'))
+				continue;
+		}
+		if (search->dirlist && !COM_FindDirFile (search->dirlist, filename))
+			continue;
+
+		sprintf (netpath, "%s/%s",search->filename, filename);
+
+	// the listing can say the file is there, but not how old it is,
+	// which the cache needs
+		*findtime = 1;
+		if (!search->dirlist || com_cachedir[0])
+		{
+			*findtime = Sys_FileTime (netpath);
+			if (*findtime == -1)
+				continue;
+		}
+		return search;
+	}
+
+	return NULL;
+}
+
+/*
+===========
+COM_LocateFile
+
+Where COM_FindFile would find filename, without opening it or counting a
+find.  Sets com_foundpackfile and com_foundpath and returns the length, or
+-1 if it isn't there.  A loose file still has to be opened for its length,
+and is left to COM_FindFile when it would be copied to the cache first.
+===========
+*/
+int COM_LocateFile (char *filename)
+{
+	searchpath_t	*search;
+	char			netpath[MAX_OSPATH];
+	int				findtime, len, h;
+
+	search = COM_SearchFile (filename, netpath, &findtime);
+	if (!search)
+		return -1;
+	if (search->pack)
+		return com_foundpackfile->filelen;
+	if (com_cachedir[0])
+		return -1;
+
+	len = Sys_FileOpenRead (netpath, &h);
+	if (h == -1)
+		return -1;
+	Sys_FileClose (h);
+	strcpy (com_foundpath, netpath);
+	return len;
+}
+
+/*
+===========
+COM_PrefetchFile
+
+Starts reading path in the background, so a COM_LoadFile for it soon after
+finds it already in memory.
+===========
 */
-void COM_Path_f (void)
+void COM_PrefetchFile (char *path)
 {
-	searchpath_t    *s;
-	
-	Con_Printf ("Current search path:\n");
-	for (s=com_searchpaths ; s ; s=s->next)
+	packfile_t	*file;
+	prefetch_t	*p;
+	int			len;
+
+	if (com_numprefetch == MAX_PREFETCH)
+		return;
+
+	len = COM_LocateFile (path);
+	if (len == -1)
+		return;
+
+	file = com_foundpackfile;
+	if (len < PREFETCH_MIN_SIZE || COM_FindPrefetch ())
+		return;		// too small to bother, or already on its way
+
+	p = &com_prefetch[com_numprefetch];
+	p->file = file;
+	strcpy (p->path, com_foundpath);
+	p->filelen = len;
+	p->mapping = -1;
+	p->data = NULL;
+	if (file)
 	{
-		if (s->pack)
-		{
-			Con_Printf ("%s (%i files)\n", s->pack->filename, s->pack->numfiles);
-		}
-		else
-			Con_Printf ("%s\n", s->filename);
+		p->filepos = file->filepos;
+		p->method = file->method;
+		p->complen = file->method == ZIP_DEFLATED ? file->complen : len;
+		p->mapping = file->pack->mapping;
+	}
+	else
+	{
+		p->filepos = 0;
+		p->method = ZIP_STORED;
+		p->complen = len;
+	}
+
+// stored members of mapped paks are loaded as views, so they only need
+// their pages faulted in and take up no memory here
+	if (p->mapping == -1 || p->method == ZIP_DEFLATED)
+	{
+		if (com_prefetchbytes + len > PREFETCH_MAX_BYTES)
+			return;
+		p->data = malloc (len);
+		if (!p->data)
+			return;
+		com_prefetchbytes += len;
 	}
+
+	p->active = true;
+	p->ok = false;
+	com_numprefetch++;
+
+	if (p->mapping != -1 && p->method == ZIP_DEFLATED)
+		Sys_QueueJob (&p->job, COM_PrefetchJob, p);
+	else
+		Sys_QueueIOJob (&p->job, COM_PrefetchJob, p);
 }
 
 /*
-============
-COM_WriteFile
+===========
+COM_ReleasePrefetch
 
-The filename will be prefixed by the current game directory
-============
+A read that hasn't started is dropped rather than made
+===========
 */
-void COM_WriteFile (char *filename, void *data, int len)
+void COM_ReleasePrefetch (prefetch_t *p)
 {
-	int             handle;
-	char    name[MAX_OSPATH];
-	
-	sprintf (name, "%s/%s", com_gamedir, filename);
+	Sys_CancelJob (&p->job);
 
-	handle = Sys_FileOpenWrite (name);
-	if (handle == -1)
+	if (p->data)
 	{
-		Sys_Printf ("COM_WriteFile: failed on %s\n", name);
-		return;
+		free (p->data);
+		com_prefetchbytes -= p->filelen;
 	}
-	
-	Sys_Printf ("COM_WriteFile: %s\n", name);
-	Sys_FileWrite (handle, data, len);
-	Sys_FileClose (handle);
+	p->active = false;
 }
 
-
 /*
-============
-COM_CreatePath
+===========
+COM_FlushPrefetch
 
-Only used for CopyFile
-============
+Throws away whatever was prefetched but never loaded
+===========
 */
-void    COM_CreatePath (char *path)
+void COM_FlushPrefetch (void)
 {
-	char    *ofs;
-	
-	for (ofs = path+1 ; *ofs ; ofs++)
-	{
-		if (*ofs == '/')
-		{       // create the directory
-			*ofs = 0;
-			Sys_mkdir (path);
-			*ofs = '/';
-		}
-	}
-}
+	int		i;
 
+	for (i=0 ; i<com_numprefetch ; i++)
+		if (com_prefetch[i].active)
+			COM_ReleasePrefetch (&com_prefetch[i]);
+
+	com_numprefetch = 0;
+	com_prefetchbytes = 0;
+}
 
 /*
 ===========
-COM_CopyFile
+COM_ReadFoundFile
 
-Copies a file over from the net to the local cache, creating any directories
-needed.  This is for the convenience of developers using ISDN from home.
+Fills dest with the file COM_FindFile just opened, from the prefetched copy
+if there is one.  The handle has to be at the file's data.
 ===========
 */
-void COM_CopyFile (char *netpath, char *cachepath)
+void COM_ReadFoundFile (int handle, byte *dest, int len)
 {
-	int             in, out;
-	int             remaining, count;
-	char    buf[4096];
-	
-	remaining = Sys_FileOpenRead (netpath, &in);            
-	COM_CreatePath (cachepath);     // create directories up to the cache file
-	out = Sys_FileOpenWrite (cachepath);
-	
-	while (remaining)
+	prefetch_t	*p;
+
+	p = COM_FindPrefetch ();
+	if (p)
 	{
-		if (remaining < sizeof(buf))
-			count = remaining;
-		else
-			count = sizeof(buf);
-		Sys_FileRead (in, buf, count);
-		Sys_FileWrite (out, buf, count);
-		remaining -= count;
+		Sys_WaitJob (&p->job);
+		if (p->ok && p->data && p->filelen == len)
+		{
+			memcpy (dest, p->data, len);
+			COM_ReleasePrefetch (p);
+			if (com_foundstat)
+				com_foundstat->prefetched++;
+			return;
+		}
+		COM_ReleasePrefetch (p);	// read it the slow way
 	}
 
-	Sys_FileClose (in);
-	Sys_FileClose (out);    
+	if (com_foundpackfile && com_foundpackfile->method == ZIP_DEFLATED)
+		COM_InflateMember (handle, com_foundpackfile, dest);
+	else
+		Sys_FileRead (handle, dest, len);
 }
 
 /*
@@ -1368,98 +2416,79 @@ int COM_FindFile (char *filename, int *handle, FILE **file)
 	char            netpath[MAX_OSPATH];
 	char            cachepath[MAX_OSPATH];
 	pack_t          *pak;
+	packfile_t      *packfile;
 	int                     i;
 	int                     findtime, cachetime;
+	double                  start;
 
 	if (file && handle)
 		Sys_Error ("COM_FindFile: both handle and file set");
 	if (!file && !handle)
 		Sys_Error ("COM_FindFile: neither handle or file set");
-		
-//
-// search through the path, one element at a time
-//
-	search = com_searchpaths;
-	if (proghack)
-	{	// gross hack to use quake 1 progs with quake 2 maps
-		if (!strcmp(filename, "progs.dat"))
-			search = search->next;
-	}
 
-	for ( ; search ; search = search->next)
+	start = Sys_FloatTime ();
+
+	search = COM_SearchFile (filename, netpath, &findtime);
+	if (search && search->pack)
 	{
-	// is the element a pak file?
-		if (search->pack)
+		pak = search->pack;
+		packfile = com_foundpackfile;
+
+		// found it!
+		Sys_Printf ("PackFile: %s : %s\n",pak->filename, filename);
+		if (handle)
 		{
-		// look through all the pak file elements
-			pak = search->pack;
-			for (i=0 ; i<pak->numfiles ; i++)
-				if (!strcmp (pak->files[i].name, filename))
-				{       // found it!
-					Sys_Printf ("PackFile: %s : %s\n",pak->filename, filename);
-					if (handle)
-					{
-						*handle = pak->handle;
-						Sys_FileSeek (pak->handle, pak->files[i].filepos);
-					}
-					else
-					{       // open a new file on the pakfile
-						*file = fopen (pak->filename, "rb");
-						if (*file)
-							fseek (*file, pak->files[i].filepos, SEEK_SET);
-					}
-					com_filesize = pak->files[i].filelen;
-					return com_filesize;
-				}
+			*handle = pak->handle;
+			Sys_FileSeek (pak->handle, packfile->filepos);
 		}
+		else if (packfile->method == ZIP_DEFLATED)
+			*file = COM_InflateToFile (packfile);
 		else
-		{               
-	// check a file in the directory tree
-			if (!static_registered)
-			{       // if not a registered version, don't ever go beyond base
-				if ( strchr (filename, '/') || strchr (filename,'\\'))
-					continue;
-			}
-			
-			sprintf (netpath, "%s/%s",search->filename, filename);
-			
-			findtime = Sys_FileTime (netpath);
-			if (findtime == -1)
-				continue;
-				
-		// see if the file needs to be updated in the cache
-			if (!com_cachedir[0])
-				strcpy (cachepath, netpath);
-			else
-			{	
+		{       // open a new file on the pakfile
+			*file = fopen (pak->filename, "rb");
+			if (*file)
+				fseek (*file, packfile->filepos, SEEK_SET);
+		}
+		com_filesize = packfile->filelen;
+		COM_CountFind (filename, pak->filename, true, start);
+		return com_filesize;
+	}
+
+	if (search)
+	{
+	// see if the file needs to be updated in the cache
+		if (!com_cachedir[0])
+			strcpy (cachepath, netpath);
+		else
+		{	
 #if defined(_WIN32)
-				if ((strlen(netpath) < 2) || (netpath[1] != ':'))
-					sprintf (cachepath,"%s%s", com_cachedir, netpath);
-				else
-					sprintf (cachepath,"%s%s", com_cachedir, netpath+2);
-#else
+			if ((strlen(netpath) < 2) || (netpath[1] != ':'))
 				sprintf (cachepath,"%s%s", com_cachedir, netpath);
+			else
+				sprintf (cachepath,"%s%s", com_cachedir, netpath+2);
+#else
+			sprintf (cachepath,"%s%s", com_cachedir, netpath);
 #endif
 
-				cachetime = Sys_FileTime (cachepath);
-			
-				if (cachetime < findtime)
-					COM_CopyFile (netpath, cachepath);
-				strcpy (netpath, cachepath);
-			}	
-
-			Sys_Printf ("FindFile: %s\n",netpath);
-			com_filesize = Sys_FileOpenRead (netpath, &i);
-			if (handle)
-				*handle = i;
-			else
-			{
-				Sys_FileClose (i);
-				*file = fopen (netpath, "rb");
-			}
-			return com_filesize;
-		}
+			cachetime = Sys_FileTime (cachepath);
 		
+			if (cachetime < findtime)
+				COM_CopyFile (netpath, cachepath);
+			strcpy (netpath, cachepath);
+		}	
+
+		Sys_Printf ("FindFile: %s\n",netpath);
+		strcpy (com_foundpath, netpath);
+		com_filesize = Sys_FileOpenRead (netpath, &i);
+		if (handle)
+			*handle = i;
+		else
+		{
+			Sys_FileClose (i);
+			*file = fopen (netpath, "rb");
+		}
+		COM_CountFind (filename, search->filename, false, start);
+		return com_filesize;
 	}
 	
 	Sys_Printf ("FindFile: can't find %s\n", filename);
@@ -1469,6 +2498,7 @@ int COM_FindFile (char *filename, int *handle, FILE **file)
 	else
 		*file = NULL;
 	com_filesize = -1;
+	COM_CountFind (filename, NULL, false, start);
 	return -1;
 }
 
@@ -1530,19 +2560,42 @@ Allways appends a 0 byte.
 cache_user_t *loadcache;
 byte    *loadbuf;
 int             loadsize;
+qboolean	loadmap;
 byte *COM_LoadFile (char *path, int usehunk)
 {
 	int             h;
 	byte    *buf;
 	char    base[32];
 	int             len;
+	double          start;
 
 	buf = NULL;     // quiet compiler warning
+	com_filemapped = false;
 
 // look for it in the filesystem or pack files
 	len = COM_OpenFile (path, &h);
 	if (h == -1)
 		return NULL;
+
+	if (com_foundstat)
+	{
+		com_foundstat->loads++;
+		com_foundstat->bytes += len;
+	}
+
+// use a view straight into the pak if the caller can take one
+	if (loadmap && com_foundpackfile && com_foundpackfile->method == ZIP_STORED
+	&& com_foundpackfile->pack->mapping != -1)
+	{
+		buf = Sys_FileMapView (com_foundpackfile->pack->mapping,
+			com_foundpackfile->filepos, len);
+		if (buf)
+		{
+			COM_CloseFile (h);
+			com_filemapped = true;
+			return buf;
+		}
+	}
 	
 // extract the filename base name for hunk tag
 	COM_FileBase (path, base);
@@ -1571,7 +2624,10 @@ byte *COM_LoadFile (char *path, int usehunk)
 	((byte *)buf)[len] = 0;
 
 	Draw_BeginDisc ();
-	Sys_FileRead (h, buf, len);                     
+	start = Sys_FloatTime ();
+	COM_ReadFoundFile (h, buf, len);
+	if (com_foundstat)
+		com_foundstat->readtime += Sys_FloatTime () - start;
 	COM_CloseFile (h);
 	Draw_EndDisc ();
 
@@ -1606,6 +2662,72 @@ byte *COM_LoadStackFile (char *path, void *buffer, int bufsize)
 	return buf;
 }
 
+/*
+============
+COM_MapStackFile
+
+Same as COM_LoadStackFile, except that uncompressed pak members are not read
+at all: a copy-on-write view into the mapped pak is returned instead.  When
+that happens com_filemapped is set and the caller must release the view with
+COM_UnmapFile.  Views are not 0 terminated.
+============
+*/
+byte *COM_MapStackFile (char *path, void *buffer, int bufsize)
+{
+	byte    *buf;
+
+	loadmap = true;
+	buf = COM_LoadStackFile (path, buffer, bufsize);
+	loadmap = false;
+
+	return buf;
+}
+
+/*
+============
+COM_MapHunkFile
+
+Same as COM_LoadHunkFile, but returns a pak view when possible.  Meant for
+data that stays resident until the pak is closed, so the view is never
+released.
+============
+*/
+byte *COM_MapHunkFile (char *path)
+{
+	byte    *buf;
+
+	loadmap = true;
+	buf = COM_LoadHunkFile (path);
+	loadmap = false;
+
+	return buf;
+}
+
+/*
+============
+COM_UnmapFile
+============
+*/
+void COM_UnmapFile (byte *buf)
+{
+	Sys_FileUnmapView (buf);
+}
+
+/*
+=================
+COM_MapPack
+
+-nopakmap reads pak members through the file handle like it used to
+=================
+*/
+void COM_MapPack (pack_t *pack)
+{
+	if (COM_CheckParm ("-nopakmap"))
+		pack->mapping = -1;
+	else
+		pack->mapping = Sys_FileMapOpen (pack->filename);
+}
+
 /*
 =================
 COM_LoadPackFile
@@ -1624,7 +2746,7 @@ pack_t *COM_LoadPackFile (char *packfile)
 	int                             numpackfiles;
 	pack_t                  *pack;
 	int                             packhandle;
-	dpackfile_t             info[MAX_FILES_IN_PACK];
+	dpackfile_t             *info;
 	unsigned short          crc;
 
 	if (Sys_FileOpenRead (packfile, &packhandle) == -1)
@@ -1641,14 +2763,17 @@ pack_t *COM_LoadPackFile (char *packfile)
 
 	numpackfiles = header.dirlen / sizeof(dpackfile_t);
 
-	if (numpackfiles > MAX_FILES_IN_PACK)
-		Sys_Error ("%s has %i files", packfile, numpackfiles);
+	if (header.dirlen < 0 || header.dirofs < 0)
+		Sys_Error ("%s has a bad directory", packfile);
 
 	if (numpackfiles != PAK0_COUNT)
 		com_modified = true;    // not the original file
 
 	newfiles = Hunk_AllocName (numpackfiles * sizeof(packfile_t), "packfile");
 
+// the on-disk directory is only needed until it has been parsed
+	info = Hunk_TempAlloc (header.dirlen);
+
 	Sys_FileSeek (packhandle, header.dirofs);
 	Sys_FileRead (packhandle, (void *)info, header.dirlen);
 
@@ -1665,6 +2790,8 @@ pack_t *COM_LoadPackFile (char *packfile)
 		strcpy (newfiles[i].name, info[i].name);
 		newfiles[i].filepos = LittleLong(info[i].filepos);
 		newfiles[i].filelen = LittleLong(info[i].filelen);
+		newfiles[i].method = ZIP_STORED;
+		newfiles[i].complen = newfiles[i].filelen;
 	}
 
 	pack = Hunk_Alloc (sizeof (pack_t));
@@ -1672,12 +2799,178 @@ pack_t *COM_LoadPackFile (char *packfile)
 	pack->handle = packhandle;
 	pack->numfiles = numpackfiles;
 	pack->files = newfiles;
+	COM_MapPack (pack);
 	
 	Con_Printf ("Added packfile %s (%i files)\n", packfile, numpackfiles);
 	return pack;
 }
 
 
+/*
+=================
+COM_LoadZipFile
+
+Takes an explicit path to a zip (or pk3) file and loads its central
+directory.  Only stored and deflated members are usable, anything else
+is left out.
+=================
+*/
+pack_t *COM_LoadZipFile (char *zipfile)
+{
+	int				ziphandle, ziplen;
+	int				i, readlen;
+	int				numentries, numzipfiles;
+	int				dirofs, dirlen;
+	int				namelen, extralen, commentlen;
+	byte			*buf, *p, *end;
+	packfile_t		*newfiles, *file;
+	pack_t			*pack;
+
+	ziplen = Sys_FileOpenRead (zipfile, &ziphandle);
+	if (ziplen == -1)
+		return NULL;
+
+//
+// the end record sits in front of a comment of up to 64k
+//
+	readlen = ziplen < 0x10000 + ZIP_END_SIZE ? ziplen : 0x10000 + ZIP_END_SIZE;
+	buf = Hunk_TempAlloc (readlen);
+	Sys_FileSeek (ziphandle, ziplen - readlen);
+	Sys_FileRead (ziphandle, buf, readlen);
+
+	for (i=readlen-ZIP_END_SIZE ; i>=0 ; i--)
+		if (COM_ZipLong (buf + i) == ZIP_END_SIG)
+			break;
+	if (i < 0)
+		Sys_Error ("%s is not a zip file", zipfile);
+
+	numentries = COM_ZipShort (buf + i + 10);
+	dirlen = COM_ZipLong (buf + i + 12);
+	dirofs = COM_ZipLong (buf + i + 16);
+	if (dirlen < 0 || dirofs < 0 || dirofs + dirlen > ziplen)
+		Sys_Error ("%s has a bad directory", zipfile);
+
+//
+// parse the central directory
+//
+	newfiles = Hunk_AllocName (numentries * sizeof(packfile_t), "packfile");
+
+	buf = Hunk_TempAlloc (dirlen);
+	Sys_FileSeek (ziphandle, dirofs);
+	Sys_FileRead (ziphandle, buf, dirlen);
+
+	numzipfiles = 0;
+	p = buf;
+	end = buf + dirlen;
+	for (i=0 ; i<numentries ; i++)
+	{
+		if (p + ZIP_CENTRAL_SIZE > end || COM_ZipLong (p) != ZIP_CENTRAL_SIG)
+			Sys_Error ("%s has a bad directory", zipfile);
+
+		namelen = COM_ZipShort (p + 28);
+		extralen = COM_ZipShort (p + 30);
+		commentlen = COM_ZipShort (p + 32);
+		if (p + ZIP_CENTRAL_SIZE + namelen > end)
+			Sys_Error ("%s has a bad directory", zipfile);
+
+		file = &newfiles[numzipfiles];
+		file->method = COM_ZipShort (p + 10);
+		file->complen = COM_ZipLong (p + 20);
+		file->filelen = COM_ZipLong (p + 24);
+		file->headerpos = COM_ZipLong (p + 42);
+		file->filepos = -1;
+
+	// skip directories, encrypted members and methods we can't decode
+		if (namelen > 0 && namelen < MAX_QPATH
+		&& p[ZIP_CENTRAL_SIZE + namelen - 1] != '/'
+		&& !(COM_ZipShort (p + 8) & 1)
+		&& (file->method == ZIP_STORED || file->method == ZIP_DEFLATED)
+		&& file->complen >= 0 && file->filelen >= 0)
+		{
+			memcpy (file->name, p + ZIP_CENTRAL_SIZE, namelen);
+			file->name[namelen] = 0;
+			numzipfiles++;
+		}
+
+		p += ZIP_CENTRAL_SIZE + namelen + extralen + commentlen;
+	}
+
+	com_modified = true;
+
+	pack = Hunk_Alloc (sizeof (pack_t));
+	strcpy (pack->filename, zipfile);
+	pack->handle = ziphandle;
+	pack->numfiles = numzipfiles;
+	pack->files = newfiles;
+	COM_MapPack (pack);
+
+	Con_Printf ("Added zipfile %s (%i files)\n", zipfile, numzipfiles);
+	return pack;
+}
+
+/*
+=================
+COM_AddZipFiles
+
+Adds every .pk3 and .zip in the root of a game directory, in alphabetical
+order, so later names override earlier ones
+=================
+*/
+#define	MAX_ZIPS_IN_DIR		64
+
+char	com_zipnames[MAX_ZIPS_IN_DIR][MAX_QPATH];
+int		com_numzipnames;
+
+void COM_ListZipFile (char *name)
+{
+	char	*ext;
+
+	if (com_numzipnames == MAX_ZIPS_IN_DIR || strchr (name, '/'))
+		return;
+	ext = COM_FileExtension (name);
+	if (Q_strcasecmp (ext, "pk3") && Q_strcasecmp (ext, "zip"))
+		return;
+	strcpy (com_zipnames[com_numzipnames++], name);
+}
+
+int COM_CompareZipNames (const void *a, const void *b)
+{
+	return Q_strcasecmp ((char *)a, (char *)b);
+}
+
+void COM_AddZipFiles (searchpath_t *dirsearch)
+{
+	int				i;
+	searchpath_t	*search;
+	pack_t			*pak;
+	dirfile_t		*file;
+	char			zipfile[MAX_OSPATH];
+
+	com_numzipnames = 0;
+	if (dirsearch->dirlist)
+	{	// already listed, no need to go to the disk again
+		for (i=0 ; i<DIR_HASH_SIZE ; i++)
+			for (file = dirsearch->dirlist->hash[i] ; file ; file = file->hashnext)
+				COM_ListZipFile (file->name);
+	}
+	else
+		Sys_ListFiles (dirsearch->filename, COM_ListZipFile);
+
+	qsort (com_zipnames, com_numzipnames, sizeof(com_zipnames[0]), COM_CompareZipNames);
+
+	for (i=0 ; i<com_numzipnames ; i++)
+	{
+		sprintf (zipfile, "%s/%s", dirsearch->filename, com_zipnames[i]);
+		pak = COM_LoadZipFile (zipfile);
+		if (!pak)
+			continue;
+		search = Hunk_Alloc (sizeof(searchpath_t));
+		search->pack = pak;
+		search->next = com_searchpaths;
+		com_searchpaths = search;
+	}
+}
+
 /*
 ================
 COM_AddGameDirectory
@@ -1689,7 +2982,7 @@ then loads and adds pak1.pak pak2.pak ...
 void COM_AddGameDirectory (char *dir)
 {
 	int                             i;
-	searchpath_t    *search;
+	searchpath_t    *search, *dirsearch;
 	pack_t                  *pak;
 	char                    pakfile[MAX_OSPATH];
 
@@ -1702,6 +2995,8 @@ void COM_AddGameDirectory (char *dir)
 	strcpy (search->filename, dir);
 	search->next = com_searchpaths;
 	com_searchpaths = search;
+	COM_ListDirectory (search);
+	dirsearch = search;
 
 //
 // add any pak files in the format pak0.pak pak1.pak, ...
@@ -1718,6 +3013,13 @@ void COM_AddGameDirectory (char *dir)
 		com_searchpaths = search;               
 	}
 
+//
+// then any zip files, which override the paks
+//
+	COM_AddZipFiles (dirsearch);
+
+	COM_BuildFileHash ();
+
 //
 // add the contents of the parms.txt file to the end of the command line
 //
@@ -1813,11 +3115,23 @@ void COM_InitFilesystem (void)
 				if (!search->pack)
 					Sys_Error ("Couldn't load packfile: %s", com_argv[i]);
 			}
+			else if ( !strcmp(COM_FileExtension(com_argv[i]), "pk3")
+			|| !strcmp(COM_FileExtension(com_argv[i]), "zip") )
+			{
+				search->pack = COM_LoadZipFile (com_argv[i]);
+				if (!search->pack)
+					Sys_Error ("Couldn't load zipfile: %s", com_argv[i]);
+			}
 			else
+			{
 				strcpy (search->filename, com_argv[i]);
+				COM_ListDirectory (search);
+			}
 			search->next = com_searchpaths;
 			com_searchpaths = search;
 		}
+
+		COM_BuildFileHash ();
 	}
 
 	if (COM_CheckParm ("-proghack"))
@@ -155,6 +155,7 @@ char *COM_SkipPath (char *pathname);
 void COM_StripExtension (char *in, char *out);
 void COM_FileBase (char *in, char *out);
 void COM_DefaultExtension (char *path, char *extension);
+unsigned COM_HashString (char *s);
 
 char	*va(char *format, ...);
 // does a varargs printf into a temp buffer
@@ -163,6 +164,7 @@ char	*va(char *format, ...);
 //============================================================================
 
 extern int com_filesize;
+extern qboolean com_filemapped;
 struct cache_user_s;
 
 extern	char	com_gamedir[MAX_OSPATH];
@@ -171,12 +173,22 @@ void COM_WriteFile (char *filename, void *data, int len);
 int COM_OpenFile (char *filename, int *hndl);
 int COM_FOpenFile (char *filename, FILE **file);
 void COM_CloseFile (int h);
+void COM_AddCachedFile (char *path);
 
 byte *COM_LoadStackFile (char *path, void *buffer, int bufsize);
 byte *COM_LoadTempFile (char *path);
 byte *COM_LoadHunkFile (char *path);
 void COM_LoadCacheFile (char *path, struct cache_user_s *cu);
 
+void COM_PrefetchFile (char *path);
+void COM_FlushPrefetch (void);
+
+void COM_WriteFileStats (void);
+
+byte *COM_MapStackFile (char *path, void *buffer, int bufsize);
+byte *COM_MapHunkFile (char *path);
+void COM_UnmapFile (byte *buf);
+
 
 extern	struct cvar_s	registered;
 
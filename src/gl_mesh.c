@@ -329,6 +329,7 @@ void GL_MakeAliasModelDisplayLists (model_t *m, aliashdr_t *hdr)
 			fwrite (&commands, numcommands * sizeof(commands[0]), 1, f);
 			fwrite (&vertexorder, numorder * sizeof(vertexorder[0]), 1, f);
 			fclose (f);
+			COM_AddCachedFile (fullpath);
 		}
 	}
 
@@ -205,6 +205,7 @@ model_t *Mod_FindName (char *name)
 		if (mod_numknown == MAX_MOD_KNOWN)
 			Sys_Error ("mod_numknown == MAX_MOD_KNOWN");
 		strcpy (mod->name, name);
+		mod->cache.owner = CACHE_MODEL;
 		mod->needload = true;
 		mod_numknown++;
 	}
@@ -243,6 +244,7 @@ model_t *Mod_LoadModel (model_t *mod, qboolean crash)
 	void	*d;
 	unsigned *buf;
 	byte	stackbuf[1024];		// avoid dirtying the cache heap
+	qboolean	mapped;
 
 	if (!mod->needload)
 	{
@@ -267,13 +269,14 @@ model_t *Mod_LoadModel (model_t *mod, qboolean crash)
 //
 // load the file
 //
-	buf = (unsigned *)COM_LoadStackFile (mod->name, stackbuf, sizeof(stackbuf));
+	buf = (unsigned *)COM_MapStackFile (mod->name, stackbuf, sizeof(stackbuf));
 	if (!buf)
 	{
 		if (crash)
 			Sys_Error ("Mod_NumForName: %s not found", mod->name);
 		return NULL;
 	}
+	mapped = com_filemapped;
 	
 //
 // allocate a new model
@@ -304,9 +307,38 @@ model_t *Mod_LoadModel (model_t *mod, qboolean crash)
 		break;
 	}
 
+// the loaders copy everything they keep
+	if (mapped)
+		COM_UnmapFile ((byte *)buf);
+
 	return mod;
 }
 
+/*
+==================
+Mod_Prefetch
+
+Lets the file system start on a model that is about to be loaded,
+unless it is already resident
+==================
+*/
+void Mod_Prefetch (char *name)
+{
+	model_t	*mod;
+
+	if (name[0] == '*')
+		return;		// inline models come with the world
+
+	mod = Mod_FindName (name);
+	if (!mod->needload)
+	{
+		if (mod->type != mod_alias || Cache_Check (&mod->cache))
+			return;
+	}
+
+	COM_PrefetchFile (mod->name);
+}
+
 /*
 ==================
 Mod_ForName
@@ -943,6 +975,37 @@ void Mod_LoadLeafs (lump_t *l)
 	}	
 }
 
+/*
+=================
+Mod_MakeHullNodes
+
+Copies each clipnode's plane into it
+=================
+*/
+mclipnode_t *Mod_MakeHullNodes (dclipnode_t *in, int count)
+{
+	mclipnode_t	*out, *nodes;
+	mplane_t	*plane;
+	int			i;
+
+	nodes = out = Hunk_AllocName ( count*sizeof(*out), loadname);
+
+	for (i=0 ; i<count ; i++, out++, in++)
+	{
+		if (in->planenum < 0 || in->planenum >= loadmodel->numplanes)
+			Sys_Error ("Mod_MakeHullNodes: bad planenum in %s", loadmodel->name);
+		plane = loadmodel->planes + in->planenum;
+		VectorCopy (plane->normal, out->normal);
+		out->dist = plane->dist;
+		out->type = plane->type;
+		out->children[0] = in->children[0];
+		out->children[1] = in->children[1];
+		out->pad = 0;
+	}
+
+	return nodes;
+}
+
 /*
 =================
 Mod_LoadClipnodes
@@ -993,6 +1056,9 @@ void Mod_LoadClipnodes (lump_t *l)
 		out->children[0] = LittleShort(in->children[0]);
 		out->children[1] = LittleShort(in->children[1]);
 	}
+
+	loadmodel->hulls[1].nodes = Mod_MakeHullNodes (loadmodel->clipnodes, count);
+	loadmodel->hulls[2].nodes = loadmodel->hulls[1].nodes;
 }
 
 /*
@@ -1032,6 +1098,8 @@ void Mod_MakeHull0 (void)
 				out->children[j] = child - loadmodel->nodes;
 		}
 	}
+
+	hull->nodes = Mod_MakeHullNodes (hull->clipnodes, count);
 }
 
 /*
@@ -1639,6 +1707,14 @@ void Mod_LoadAliasModel (model_t *mod, void *buffer)
 //	
 	end = Hunk_LowMark ();
 	total = end - start;
+
+	if (!Hunk_Contiguous (start))
+	{	// the hunk filled up part way through, so load it again in one piece
+		Hunk_FreeToLowMark (start);
+		Hunk_Reserve (total);
+		Mod_LoadAliasModel (mod, buffer);
+		return;
+	}
 	
 	Cache_Alloc (&mod->cache, total, loadname);
 	if (!mod->cache.data)
@@ -192,11 +192,22 @@ typedef struct mleaf_s
 	byte		ambient_sound_level[NUM_AMBIENTS];
 } mleaf_t;
 
+// a clipnode with its plane, so a trace reads one place for each node
+typedef struct
+{
+	vec3_t		normal;
+	float		dist;
+	int			type;			// < 3 for an axial plane
+	int			children[2];	// negative numbers are contents
+	int			pad;			// to 32 bytes
+} mclipnode_t;
+
 // !!! if this is changed, it must be changed in asm_i386.h too !!!
 typedef struct
 {
 	dclipnode_t	*clipnodes;
 	mplane_t	*planes;
+	mclipnode_t	*nodes;			// the same, for tracing
 	int			firstclipnode;
 	int			lastclipnode;
 	vec3_t		clip_mins;
@@ -423,6 +434,7 @@ void	Mod_ClearAll (void);
 model_t *Mod_ForName (char *name, qboolean crash);
 void	*Mod_Extradata (model_t *mod);	// handles caching
 void	Mod_TouchModel (char *name);
+void	Mod_Prefetch (char *name);
 
 mleaf_t *Mod_PointInLeaf (float *p, model_t *model);
 byte	*Mod_LeafPVS (mleaf_t *leaf, model_t *model);
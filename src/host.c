@@ -134,6 +134,9 @@ void Host_Error (char *error, ...)
 	vsprintf (string,error,argptr);
 	va_end (argptr);
 	Con_Printf ("Host_Error: %s\n",string);
+
+	PR_BenchAbort ();
+	SV_TraceBenchAbort ();
 	
 	if (sv.active)
 		Host_ShutdownServer (false);
@@ -257,6 +260,7 @@ void Host_WriteConfiguration (void)
 			Con_Printf ("Couldn't write config.cfg.\n");
 			return;
 		}
+		COM_AddCachedFile (va("%s/config.cfg",com_gamedir));
 		
 		Key_WriteBindings (f);
 		Cvar_WriteVariables (f);
@@ -375,6 +379,7 @@ void SV_DropClient (qboolean crash)
 // free the client (the body stays around)
 	host_client->active = false;
 	host_client->name[0] = 0;
+	ED_StringsChanged ();
 	host_client->old_frags = -999999;
 	net_activeconnections--;
 
@@ -477,6 +482,7 @@ not reinitialize anything.
 void Host_ClearMemory (void)
 {
 	Con_DPrintf ("Clearing memory\n");
+	COM_FlushPrefetch ();
 	D_FlushCaches ();
 	Mod_ClearAll ();
 	if (host_hunklevel)
@@ -944,6 +950,7 @@ void Host_Shutdown(void)
 	scr_disabled_for_loading = true;
 
 	Host_WriteConfiguration (); 
+	COM_WriteFileStats ();
 
 	CDAudio_Shutdown ();
 	NET_Shutdown ();
@@ -521,6 +521,7 @@ void Host_Savegame_f (void)
 		Con_Printf ("ERROR: couldn't open.\n");
 		return;
 	}
+	COM_AddCachedFile (name);
 	
 	fprintf (f, "%i\n", SAVEGAME_VERSION);
 	Host_SavegameComment (comment);
@@ -678,6 +679,7 @@ void Host_Loadgame_f (void)
 		else
 		{	// parse an edict
 
+			SV_GrowEdicts (entnum+1);
 			ent = EDICT_NUM(entnum);
 			memset (&ent->v, 0, progs->entityfields * 4);
 			ent->free = false;
@@ -724,6 +726,7 @@ void SaveGamestate()
 		Con_Printf ("ERROR: couldn't open.\n");
 		return;
 	}
+	COM_AddCachedFile (name);
 	
 	fprintf (f, "%i\n", SAVEGAME_VERSION);
 	Host_SavegameComment (comment);
@@ -841,6 +844,7 @@ int LoadGamestate(char *level, char *startspot)
 			
 		// parse an edict
 
+		SV_GrowEdicts (entnum+1);
 		ent = EDICT_NUM(entnum);
 		memset (&ent->v, 0, progs->entityfields * 4);
 		ent->free = false;
@@ -936,6 +940,7 @@ void Host_Name_f (void)
 		if (Q_strcmp(host_client->name, newName) != 0)
 			Con_Printf ("%s renamed to %s\n", host_client->name, newName);
 	Q_strcpy (host_client->name, newName);
+	ED_StringsChanged ();
 	host_client->edict->v.netname = host_client->name - pr_strings;
 	
 // send notification to all clients
@@ -1265,10 +1270,9 @@ void Host_PreSpawn_f (void)
 		return;
 	}
 	
-	SZ_Write (&host_client->message, sv.signon.data, sv.signon.cursize);
-	MSG_WriteByte (&host_client->message, svc_signonnum);
-	MSG_WriteByte (&host_client->message, 2);
-	host_client->sendsignon = true;
+	host_client->prespawning = true;
+	host_client->signonsent = 0;
+	SV_SendSignon (host_client);
 }
 
 /*
@@ -1308,6 +1312,7 @@ void Host_Spawn_f (void)
 		memset (&ent->v, 0, progs->entityfields * 4);
 		ent->v.colormap = NUM_FOR_EDICT(ent);
 		ent->v.team = (host_client->colors & 15) + 1;
+		ED_FieldWritten (ent, (int *)&ent->v.netname - (int *)&ent->v);
 		ent->v.netname = host_client->name - pr_strings;
 
 		// copy spawn parms out of the client_t
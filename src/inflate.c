@@ -0,0 +1,404 @@
+/*
+This file is an altered version of puff.c by Mark Adler, not the original.
+Names, types and layout were changed to fit the engine, and it decodes into
+a buffer that is already the final size.  The original notice follows.
+
+  Copyright (C) 2002-2013 Mark Adler, all rights reserved
+  version 2.3, 21 Jan 2013
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the author be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  Mark Adler    madler@alumni.caltech.edu
+*/
+/* inflate.c */
+
+#include "quakedef.h"
+#include "inflate.h"
+
+// a straightforward decoder for deflate streams (RFC 1951).  Everything is
+// decoded in one call into a buffer that is already the final size, so there
+// is no sliding window to manage: back references point into the output.
+
+#define	MAXBITS		15		// longest code
+#define	MAXLCODES	286		// literal/length codes
+#define	MAXDCODES	30		// distance codes
+#define	MAXCODES	(MAXLCODES+MAXDCODES)
+#define	FIXLCODES	288		// literal/length codes in the fixed block
+
+typedef struct
+{
+	byte	*in;
+	int		inlen, incount;
+
+	byte	*out;
+	int		outlen, outcount;
+
+	unsigned	bitbuf;
+	int		bitcount;
+
+	jmp_buf	abort;			// taken when the input runs out
+} inflatestate_t;
+
+// canonical huffman code: number of codes of each length, and the symbols
+// ordered by code
+typedef struct
+{
+	short	count[MAXBITS+1];
+	short	symbol[FIXLCODES];
+} huffman_t;
+
+static const short	lengthbase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const short	lengthextra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const short	distbase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577};
+static const short	distextra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// order the code length code lengths are sent in
+static const short	lengthorder[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+/*
+================
+Inflate_Bits
+
+Returns need bits from the input, least significant bit first
+================
+*/
+static int Inflate_Bits (inflatestate_t *s, int need)
+{
+	unsigned	val;
+
+	val = s->bitbuf;
+	while (s->bitcount < need)
+	{
+		if (s->incount == s->inlen)
+			longjmp (s->abort, 1);
+		val |= (unsigned)s->in[s->incount++] << s->bitcount;
+		s->bitcount += 8;
+	}
+
+	s->bitbuf = val >> need;
+	s->bitcount -= need;
+
+	return val & ((1 << need) - 1);
+}
+
+/*
+================
+Inflate_Decode
+
+Huffman codes are stored bit reversed, so they are read one bit at a time
+================
+*/
+static int Inflate_Decode (inflatestate_t *s, huffman_t *h)
+{
+	int		len, code, first, count, index;
+
+	code = first = index = 0;
+	for (len=1 ; len<=MAXBITS ; len++)
+	{
+		code |= Inflate_Bits (s, 1);
+		count = h->count[len];
+		if (code - count < first)
+			return h->symbol[index + (code - first)];
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+
+	return -1;		// ran out of codes
+}
+
+/*
+================
+Inflate_Construct
+
+Builds a decoding table from a list of code lengths.  Returns 0 for a
+complete code, a positive number for an incomplete one and a negative
+number for an over-subscribed one.
+================
+*/
+static int Inflate_Construct (huffman_t *h, short *length, int n)
+{
+	int		symbol, len, left;
+	short	offs[MAXBITS+1];
+
+	for (len=0 ; len<=MAXBITS ; len++)
+		h->count[len] = 0;
+	for (symbol=0 ; symbol<n ; symbol++)
+		h->count[length[symbol]]++;
+	if (h->count[0] == n)
+		return 0;		// no codes at all, complete but decodes nothing
+
+	left = 1;
+	for (len=1 ; len<=MAXBITS ; len++)
+	{
+		left <<= 1;
+		left -= h->count[len];
+		if (left < 0)
+			return left;
+	}
+
+	offs[1] = 0;
+	for (len=1 ; len<MAXBITS ; len++)
+		offs[len + 1] = offs[len] + h->count[len];
+
+	for (symbol=0 ; symbol<n ; symbol++)
+		if (length[symbol] != 0)
+			h->symbol[offs[length[symbol]]++] = symbol;
+
+	return left;
+}
+
+/*
+================
+Inflate_Stored
+================
+*/
+static qboolean Inflate_Stored (inflatestate_t *s)
+{
+	int		len;
+
+// stored blocks start on a byte boundary
+	s->bitbuf = 0;
+	s->bitcount = 0;
+
+	if (s->incount + 4 > s->inlen)
+		return false;
+	len = s->in[s->incount] | (s->in[s->incount+1] << 8);
+	if (s->in[s->incount+2] != (~len & 0xff)
+	|| s->in[s->incount+3] != ((~len >> 8) & 0xff))
+		return false;
+	s->incount += 4;
+
+	if (s->incount + len > s->inlen || s->outcount + len > s->outlen)
+		return false;
+
+	memcpy (s->out + s->outcount, s->in + s->incount, len);
+	s->incount += len;
+	s->outcount += len;
+
+	return true;
+}
+
+/*
+================
+Inflate_Codes
+
+Decodes literals and back references until the end of block code
+================
+*/
+static qboolean Inflate_Codes (inflatestate_t *s, huffman_t *lencode, huffman_t *distcode)
+{
+	int		symbol, len, dist;
+	byte	*from, *to;
+
+	while (1)
+	{
+		symbol = Inflate_Decode (s, lencode);
+		if (symbol < 0)
+			return false;
+
+		if (symbol < 256)
+		{
+			if (s->outcount == s->outlen)
+				return false;
+			s->out[s->outcount++] = symbol;
+			continue;
+		}
+
+		if (symbol == 256)
+			return true;		// end of block
+
+		symbol -= 257;
+		if (symbol >= 29)
+			return false;
+		len = lengthbase[symbol] + Inflate_Bits (s, lengthextra[symbol]);
+
+		symbol = Inflate_Decode (s, distcode);
+		if (symbol < 0 || symbol >= 30)
+			return false;
+		dist = distbase[symbol] + Inflate_Bits (s, distextra[symbol]);
+
+		if (dist > s->outcount || s->outcount + len > s->outlen)
+			return false;
+
+	// the copy can overlap itself, so it has to go a byte at a time
+		to = s->out + s->outcount;
+		from = to - dist;
+		s->outcount += len;
+		while (len--)
+			*to++ = *from++;
+	}
+}
+
+/*
+================
+Inflate_Fixed
+================
+*/
+static qboolean Inflate_Fixed (inflatestate_t *s)
+{
+	huffman_t	lencode, distcode;
+	short		lengths[FIXLCODES];
+	int			symbol;
+
+// cheap enough to build every time, and keeps this free of shared state
+	for (symbol=0 ; symbol<144 ; symbol++)
+		lengths[symbol] = 8;
+	for ( ; symbol<256 ; symbol++)
+		lengths[symbol] = 9;
+	for ( ; symbol<280 ; symbol++)
+		lengths[symbol] = 7;
+	for ( ; symbol<FIXLCODES ; symbol++)
+		lengths[symbol] = 8;
+	Inflate_Construct (&lencode, lengths, FIXLCODES);
+
+	for (symbol=0 ; symbol<MAXDCODES ; symbol++)
+		lengths[symbol] = 5;
+	Inflate_Construct (&distcode, lengths, MAXDCODES);
+
+	return Inflate_Codes (s, &lencode, &distcode);
+}
+
+/*
+================
+Inflate_Dynamic
+================
+*/
+static qboolean Inflate_Dynamic (inflatestate_t *s)
+{
+	int			nlen, ndist, ncode;
+	int			index, symbol, len, err;
+	short		lengths[MAXCODES];
+	huffman_t	lencode, distcode;
+
+	nlen = Inflate_Bits (s, 5) + 257;
+	ndist = Inflate_Bits (s, 5) + 1;
+	ncode = Inflate_Bits (s, 4) + 4;
+	if (nlen > MAXLCODES || ndist > MAXDCODES)
+		return false;
+
+// code lengths for the code length alphabet
+	for (index=0 ; index<ncode ; index++)
+		lengths[lengthorder[index]] = Inflate_Bits (s, 3);
+	for ( ; index<19 ; index++)
+		lengths[lengthorder[index]] = 0;
+
+	if (Inflate_Construct (&lencode, lengths, 19) != 0)
+		return false;		// must be complete
+
+// literal/length and distance code lengths
+	index = 0;
+	while (index < nlen + ndist)
+	{
+		symbol = Inflate_Decode (s, &lencode);
+		if (symbol < 0)
+			return false;
+
+		if (symbol < 16)
+		{
+			lengths[index++] = symbol;
+			continue;
+		}
+
+		len = 0;
+		if (symbol == 16)
+		{	// repeat last length 3 to 6 times
+			if (index == 0)
+				return false;
+			len = lengths[index - 1];
+			symbol = 3 + Inflate_Bits (s, 2);
+		}
+		else if (symbol == 17)
+			symbol = 3 + Inflate_Bits (s, 3);	// repeat zero 3..10 times
+		else
+			symbol = 11 + Inflate_Bits (s, 7);	// repeat zero 11..138 times
+
+		if (index + symbol > nlen + ndist)
+			return false;
+		while (symbol--)
+			lengths[index++] = len;
+	}
+
+	if (lengths[256] == 0)
+		return false;		// no end of block code
+
+// incomplete codes are only allowed when there is a single code
+	err = Inflate_Construct (&lencode, lengths, nlen);
+	if (err && (err < 0 || nlen != lencode.count[0] + lencode.count[1]))
+		return false;
+
+	err = Inflate_Construct (&distcode, lengths + nlen, ndist);
+	if (err && (err < 0 || ndist != distcode.count[0] + distcode.count[1]))
+		return false;
+
+	return Inflate_Codes (s, &lencode, &distcode);
+}
+
+/*
+================
+Inflate
+================
+*/
+qboolean Inflate (byte *dest, int outlen, byte *source, int inlen)
+{
+	inflatestate_t	s;
+	int				last, type;
+	qboolean		ok;
+
+	s.in = source;
+	s.inlen = inlen;
+	s.incount = 0;
+	s.out = dest;
+	s.outlen = outlen;
+	s.outcount = 0;
+	s.bitbuf = 0;
+	s.bitcount = 0;
+
+	if (setjmp (s.abort))
+		return false;		// ran out of input
+
+	do
+	{
+		last = Inflate_Bits (&s, 1);
+		type = Inflate_Bits (&s, 2);
+
+		if (type == 0)
+			ok = Inflate_Stored (&s);
+		else if (type == 1)
+			ok = Inflate_Fixed (&s);
+		else if (type == 2)
+			ok = Inflate_Dynamic (&s);
+		else
+			ok = false;
+
+		if (!ok)
+			return false;
+	} while (!last);
+
+	return s.outcount == outlen;
+}
@@ -0,0 +1,374 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pr_bench.c -- progs throughput on a map, with no one connected
+
+#include "quakedef.h"
+
+/*
+
+"progsbench <map> [frames]" spawns the map with no client, so it works the
+same on a dedicated server, and runs that many server frames for each way of
+running progs that is loaded: the classic loop, decoded statements, and
+native code with -progjit.  Each run starts from a fresh spawn with the same
+random seed, so they all do the same work and should count the same number
+of statements.
+
+The time charged to the progs is the time spent in calls made from the
+engine, builtins included.
+
+A last run with the classic loop reads the clock at every statement, to show
+where the time goes by kind of opcode.  What reading the clock costs is
+measured and taken off.
+
+*/
+
+#define	OPC_MATH		0
+#define	OPC_COMPARE		1
+#define	OPC_LOAD		2
+#define	OPC_STORE		3
+#define	OPC_BRANCH		4
+#define	OPC_CALL		5
+#define	OPC_RETURN		6
+#define	OPC_STATE		7
+#define	NUM_OPCLASSES	8
+#define	OPC_IDLE		NUM_OPCLASSES	// between calls from the engine
+
+static char *opclassnames[NUM_OPCLASSES] =
+{
+	"math",
+	"compare",
+	"load",
+	"store",
+	"branch",
+	"call",		// builtins included
+	"return",
+	"state"
+};
+
+#define	ENGINE_CLASSIC	0
+#define	ENGINE_DECODED	1
+#define	ENGINE_JIT		2
+#define	NUM_ENGINES		3
+
+static char *enginenames[NUM_ENGINES] = {"classic", "decoded", "native"};
+
+qboolean	pr_benchmarking;
+qboolean	pr_opclock;
+
+double		bench_time;			// in calls from the engine
+double		bench_last;			// clock at the last statement
+int			bench_lastclass;
+double		bench_classtime[NUM_OPCLASSES+1];
+int			bench_classcount[NUM_OPCLASSES+1];
+
+qboolean	bench_running;		// what PR_BenchRun changed, for PR_BenchAbort
+prcode_t	*bench_code;
+byte		**bench_jitcode;
+double		bench_frametime;
+
+/*
+============
+PR_OpClass
+============
+*/
+int PR_OpClass (int op)
+{
+	if (op >= OP_MUL_F && op <= OP_SUB_V)
+		return OPC_MATH;
+	if (op == OP_BITAND || op == OP_BITOR)
+		return OPC_MATH;
+	if (op >= OP_EQ_F && op <= OP_GT)
+		return OPC_COMPARE;
+	if (op >= OP_NOT_F && op <= OP_NOT_FNC)
+		return OPC_COMPARE;
+	if (op == OP_AND || op == OP_OR)
+		return OPC_COMPARE;
+	if (op >= OP_LOAD_F && op <= OP_ADDRESS)
+		return OPC_LOAD;
+	if (op >= OP_STORE_F && op <= OP_STOREP_FNC)
+		return OPC_STORE;
+	if (op == OP_IF || op == OP_IFNOT || op == OP_GOTO)
+		return OPC_BRANCH;
+	if (op >= OP_CALL0 && op <= OP_CALL8)
+		return OPC_CALL;
+	if (op == OP_STATE)
+		return OPC_STATE;
+	return OPC_RETURN;		// OP_DONE, OP_RETURN
+}
+
+/*
+============
+PR_ClockStatement
+
+Called by the classic loop before each statement while pr_opclock is set.
+The time since the last call goes to the statement before.  -1 ends a call
+from the engine.
+============
+*/
+void PR_ClockStatement (int op)
+{
+	double	now;
+
+	now = Sys_FloatTime ();
+	bench_classtime[bench_lastclass] += now - bench_last;
+	bench_classcount[bench_lastclass]++;
+	bench_last = now;
+	bench_lastclass = op < 0 ? OPC_IDLE : PR_OpClass (op);
+}
+
+/*
+============
+PR_BenchProgram
+
+PR_ExecuteProgram comes here for calls from the engine while benchmarking
+============
+*/
+void PR_BenchProgram (func_t fnum)
+{
+	double	start;
+
+	pr_benchmarking = false;
+
+	start = Sys_FloatTime ();
+	if (pr_opclock)
+	{
+		bench_last = start;
+		bench_lastclass = OPC_IDLE;
+	}
+	PR_ExecuteProgram (fnum);
+	if (pr_opclock)
+		PR_ClockStatement (-1);
+	bench_time += Sys_FloatTime () - start;
+
+	pr_benchmarking = true;
+}
+
+/*
+============
+PR_BenchAbort
+
+Called by Host_Error and PR_LoadProgs, in case an error left a run
+unfinished
+============
+*/
+void PR_BenchAbort (void)
+{
+	if (!bench_running)
+		return;
+
+	pr_benchmarking = false;
+	pr_opclock = false;
+	pr_code = bench_code;
+	pr_jitcode = bench_jitcode;
+	host_frametime = bench_frametime;
+	bench_running = false;
+}
+
+/*
+============
+PR_BenchStatements
+============
+*/
+double PR_BenchStatements (void)
+{
+	double	count;
+	int		i;
+
+	count = 0;
+	for (i=0 ; i<progs->numfunctions ; i++)
+		count += pr_functions[i].profile;
+	return count;
+}
+
+/*
+============
+PR_BenchRun
+
+Spawns map and runs frames server frames with engine, reading the clock at
+each statement if opclock is set.  Returns false if the map didn't load.
+============
+*/
+qboolean PR_BenchRun (char *map, int frames, int engine, qboolean opclock, double *statements, double *total)
+{
+	double		start;
+	int			i;
+
+#ifdef QUAKE2
+	SV_SpawnServer (map, NULL);
+#else
+	SV_SpawnServer (map);
+#endif
+	if (!sv.active)
+		return false;
+
+	bench_code = pr_code;
+	bench_jitcode = pr_jitcode;
+	bench_frametime = host_frametime;
+	bench_running = true;
+	if (engine < ENGINE_JIT)
+		pr_jitcode = NULL;
+	if (engine < ENGINE_DECODED)
+		pr_code = NULL;
+
+	for (i=0 ; i<progs->numfunctions ; i++)
+		pr_functions[i].profile = 0;
+	bench_time = 0;
+	srand (0);
+
+	host_frametime = 0.1;
+	pr_benchmarking = true;
+	pr_opclock = opclock;
+
+	start = Sys_FloatTime ();
+	for (i=0 ; i<frames ; i++)
+	{
+		SV_Physics ();
+
+	// no one to send them to
+		SZ_Clear (&sv.datagram);
+		SZ_Clear (&sv.reliable_datagram);
+	}
+	*total = Sys_FloatTime () - start;
+
+	pr_benchmarking = false;
+	pr_opclock = false;
+	host_frametime = bench_frametime;
+
+	pr_code = bench_code;
+	pr_jitcode = bench_jitcode;
+	bench_running = false;
+
+	*statements = PR_BenchStatements ();
+	return true;
+}
+
+/*
+============
+PR_BenchClockCost
+
+What a PR_ClockStatement costs, so it can be taken off each statement
+============
+*/
+double PR_BenchClockCost (void)
+{
+	double	start, saved[NUM_OPCLASSES+1];
+	int		count[NUM_OPCLASSES+1];
+	int		i;
+
+	memcpy (saved, bench_classtime, sizeof(saved));
+	memcpy (count, bench_classcount, sizeof(count));
+
+	bench_last = start = Sys_FloatTime ();
+	bench_lastclass = OPC_IDLE;
+	for (i=0 ; i<100000 ; i++)
+		PR_ClockStatement (OP_DONE);
+	start = Sys_FloatTime () - start;
+
+	memcpy (bench_classtime, saved, sizeof(saved));
+	memcpy (bench_classcount, count, sizeof(count));
+
+	return start / 100000;
+}
+
+/*
+============
+PR_Bench_f
+
+progsbench <map> [frames]
+============
+*/
+void PR_Bench_f (void)
+{
+	char		map[MAX_QPATH];
+	int			frames, engine, i;
+	double		statements, total, cost, time, all;
+	qboolean	have[NUM_ENGINES];
+
+	if (Cmd_Argc () < 2)
+	{
+		Con_Printf ("progsbench <map> [frames]\n");
+		return;
+	}
+	if (cmd_source != src_command)
+		return;
+
+	Q_strncpy (map, Cmd_Argv (1), sizeof(map)-1);
+	map[sizeof(map)-1] = 0;
+	frames = Cmd_Argc () > 2 ? Q_atoi (Cmd_Argv (2)) : 500;
+	if (frames < 1)
+		frames = 1;
+
+	CL_Disconnect ();
+	Host_ShutdownServer (false);
+	svs.serverflags = 0;
+
+	Con_Printf ("%i frames of %s\n", frames, map);
+	Con_Printf ("engine       statements  progs ms  frame ms  Mstatements/s\n");
+	for (engine=0 ; engine<NUM_ENGINES ; engine++)
+	{
+		if (!PR_BenchRun (map, frames, engine, false, &statements, &total))
+		{
+			Con_Printf ("Couldn't spawn %s\n", map);
+			return;
+		}
+		if (engine == ENGINE_CLASSIC)
+		{	// see what else the progs were loaded with
+			have[ENGINE_CLASSIC] = true;
+			have[ENGINE_DECODED] = pr_code != NULL;
+			have[ENGINE_JIT] = pr_jitcode != NULL;
+		}
+		else if (!have[engine])
+			continue;
+
+		Con_Printf ("%-10s %12.0f %9.1f %9.3f %14.2f\n", enginenames[engine],
+			statements, bench_time * 1000, total * 1000 / frames,
+			bench_time > 0 ? statements / bench_time / 1000000 : 0);
+	}
+	if (!have[ENGINE_JIT])
+		Con_Printf ("(start with -progjit to include native code)\n");
+
+// by kind of opcode, with the classic loop
+	memset (bench_classtime, 0, sizeof(bench_classtime));
+	memset (bench_classcount, 0, sizeof(bench_classcount));
+	cost = PR_BenchClockCost ();
+
+	PR_BenchRun (map, frames, ENGINE_CLASSIC, true, &statements, &total);
+
+	all = 0;
+	for (i=0 ; i<NUM_OPCLASSES ; i++)
+	{
+		time = bench_classtime[i] - bench_classcount[i] * cost;
+		if (time > 0)
+			all += time;
+	}
+
+	Con_Printf ("opcodes      statements  ns each  share\n");
+	for (i=0 ; i<NUM_OPCLASSES ; i++)
+	{
+		if (!bench_classcount[i])
+			continue;
+		time = bench_classtime[i] - bench_classcount[i] * cost;
+		if (time < 0)
+			time = 0;
+		Con_Printf ("%-10s %12i %8.1f %5.1f%%\n", opclassnames[i], bench_classcount[i],
+			time * 1000000000 / bench_classcount[i], all > 0 ? time * 100 / all : 0);
+	}
+	Con_Printf ("(%.1f ns a statement to read the clock taken off)\n", cost * 1000000000);
+}
@@ -250,9 +250,14 @@ void PF_setmodel (void)
 		PR_RunError ("no precache: %s\n", m);
 		
 
+	ED_FieldWritten (e, (int *)&e->v.model - (int *)&e->v);
 	e->v.model = m - pr_strings;
 	e->v.modelindex = i; //SV_ModelIndex (m);
 
+// precache_model only starts the file loading, the first setmodel finishes it
+	if (i && !sv.models[i])
+		sv.models[i] = Mod_ForName (m, true);
+
 	mod = sv.models[ (int)e->v.modelindex];  // Mod_ForName (m, true);
 	
 	if (mod)
@@ -529,14 +534,15 @@ void PF_ambientsound (void)
 
 // add an svc_spawnambient command to the level signon packet
 
-	MSG_WriteByte (&sv.signon,svc_spawnstaticsound);
+	SV_ReserveSignon (10);
+	MSG_WriteByte (sv.signon,svc_spawnstaticsound);
 	for (i=0 ; i<3 ; i++)
-		MSG_WriteCoord(&sv.signon, pos[i]);
+		MSG_WriteCoord(sv.signon, pos[i]);
 
-	MSG_WriteByte (&sv.signon, soundnum);
+	MSG_WriteByte (sv.signon, soundnum);
 
-	MSG_WriteByte (&sv.signon, vol*255);
-	MSG_WriteByte (&sv.signon, attenuation*64);
+	MSG_WriteByte (sv.signon, vol*255);
+	MSG_WriteByte (sv.signon, attenuation*64);
 
 }
 
@@ -879,34 +885,13 @@ findradius (origin, radius)
 */
 void PF_findradius (void)
 {
-	edict_t	*ent, *chain;
 	float	rad;
 	float	*org;
-	vec3_t	eorg;
-	int		i, j;
 
-	chain = (edict_t *)sv.edicts;
-	
 	org = G_VECTOR(OFS_PARM0);
 	rad = G_FLOAT(OFS_PARM1);
 
-	ent = NEXT_EDICT(sv.edicts);
-	for (i=1 ; i<sv.num_edicts ; i++, ent = NEXT_EDICT(ent))
-	{
-		if (ent->free)
-			continue;
-		if (ent->v.solid == SOLID_NOT)
-			continue;
-		for (j=0 ; j<3 ; j++)
-			eorg[j] = org[j] - (ent->v.origin[j] + (ent->v.mins[j] + ent->v.maxs[j])*0.5);			
-		if (Length(eorg) > rad)
-			continue;
-			
-		ent->v.chain = EDICT_TO_PROG(chain);
-		chain = ent;
-	}
-
-	RETURN_EDICT(chain);
+	RETURN_EDICT(SV_FindRadius (org, rad));
 }
 
 
@@ -920,18 +905,52 @@ void PF_dprint (void)
 	Con_DPrintf ("%s",PF_VarString(0));
 }
 
-char	pr_string_temp[128];
+// strings made at run time are handed out in turn from a small ring, so a
+// few can be used at once, and none of them need to be freed
+#define	MAX_TEMPSTRINGS	16		// power of two
+
+char	pr_string_temp[MAX_TEMPSTRINGS][128];
+int		pr_tempstring;
+
+/*
+=================
+PR_TempString
+
+The next temp string, which the progs can use until MAX_TEMPSTRINGS more
+have been made
+=================
+*/
+char *PR_TempString (void)
+{
+	pr_tempstring = (pr_tempstring + 1) & (MAX_TEMPSTRINGS-1);
+	return pr_string_temp[pr_tempstring];
+}
+
+/*
+=================
+PR_IsTempString
+
+True if s is in one of the temp strings, which change without a field
+being written
+=================
+*/
+qboolean PR_IsTempString (char *s)
+{
+	return s >= pr_string_temp[0] && s < pr_string_temp[MAX_TEMPSTRINGS];
+}
 
 void PF_ftos (void)
 {
 	float	v;
+	char	*s;
 	v = G_FLOAT(OFS_PARM0);
 	
+	s = PR_TempString ();
 	if (v == (int)v)
-		sprintf (pr_string_temp, "%d",(int)v);
+		sprintf (s, "%d",(int)v);
 	else
-		sprintf (pr_string_temp, "%5.1f",v);
-	G_INT(OFS_RETURN) = pr_string_temp - pr_strings;
+		sprintf (s, "%5.1f",v);
+	G_INT(OFS_RETURN) = s - pr_strings;
 }
 
 void PF_fabs (void)
@@ -943,15 +962,21 @@ void PF_fabs (void)
 
 void PF_vtos (void)
 {
-	sprintf (pr_string_temp, "'%5.1f %5.1f %5.1f'", G_VECTOR(OFS_PARM0)[0], G_VECTOR(OFS_PARM0)[1], G_VECTOR(OFS_PARM0)[2]);
-	G_INT(OFS_RETURN) = pr_string_temp - pr_strings;
+	char	*s;
+
+	s = PR_TempString ();
+	sprintf (s, "'%5.1f %5.1f %5.1f'", G_VECTOR(OFS_PARM0)[0], G_VECTOR(OFS_PARM0)[1], G_VECTOR(OFS_PARM0)[2]);
+	G_INT(OFS_RETURN) = s - pr_strings;
 }
 
 #ifdef QUAKE2
 void PF_etos (void)
 {
-	sprintf (pr_string_temp, "entity %i", G_EDICTNUM(OFS_PARM0));
-	G_INT(OFS_RETURN) = pr_string_temp - pr_strings;
+	char	*s;
+
+	s = PR_TempString ();
+	sprintf (s, "entity %i", G_EDICTNUM(OFS_PARM0));
+	G_INT(OFS_RETURN) = s - pr_strings;
 }
 #endif
 
@@ -977,7 +1002,7 @@ void PF_Find (void)
 {
 	int		e;	
 	int		f;
-	char	*s, *t;
+	char	*s;
 	edict_t	*ed;
 	edict_t	*first;
 	edict_t	*second;
@@ -990,23 +1015,14 @@ void PF_Find (void)
 	if (!s)
 		PR_RunError ("PF_Find: bad search string");
 		
-	for (e++ ; e < sv.num_edicts ; e++)
+	for (ed = ED_FindString (e, f, s) ; ed != sv.edicts ; ed = ED_FindString (NUM_FOR_EDICT(ed), f, s))
 	{
-		ed = EDICT_NUM(e);
-		if (ed->free)
-			continue;
-		t = E_STRING(ed,f);
-		if (!t)
-			continue;
-		if (!strcmp(t,s))
-		{
-			if (first == (edict_t *)sv.edicts)
-				first = ed;
-			else if (second == (edict_t *)sv.edicts)
-				second = ed;
-			ed->v.chain = EDICT_TO_PROG(last);
-			last = ed;
-		}
+		if (first == (edict_t *)sv.edicts)
+			first = ed;
+		else if (second == (edict_t *)sv.edicts)
+			second = ed;
+		ed->v.chain = EDICT_TO_PROG(last);
+		last = ed;
 	}
 
 	if (first != last)
@@ -1025,31 +1041,15 @@ void PF_Find (void)
 {
 	int		e;	
 	int		f;
-	char	*s, *t;
-	edict_t	*ed;
+	char	*s;
 
 	e = G_EDICTNUM(OFS_PARM0);
 	f = G_INT(OFS_PARM1);
 	s = G_STRING(OFS_PARM2);
 	if (!s)
 		PR_RunError ("PF_Find: bad search string");
-		
-	for (e++ ; e < sv.num_edicts ; e++)
-	{
-		ed = EDICT_NUM(e);
-		if (ed->free)
-			continue;
-		t = E_STRING(ed,f);
-		if (!t)
-			continue;
-		if (!strcmp(t,s))
-		{
-			RETURN_EDICT(ed);
-			return;
-		}
-	}
 
-	RETURN_EDICT(sv.edicts);
+	RETURN_EDICT(ED_FindString (e, f, s));
 }
 #endif
 
@@ -1106,7 +1106,7 @@ void PF_precache_model (void)
 		if (!sv.model_precache[i])
 		{
 			sv.model_precache[i] = s;
-			sv.models[i] = Mod_ForName (s, true);
+			Mod_Prefetch (s);	// loaded by setmodel, or when spawning is done
 			return;
 		}
 		if (!strcmp(sv.model_precache[i], s))
@@ -1526,7 +1526,7 @@ sizebuf_t *WriteDest (void)
 		return &sv.reliable_datagram;
 	
 	case MSG_INIT:
-		return &sv.signon;
+		return sv.signon;
 
 	default:
 		PR_RunError ("WriteDest: bad destination");
@@ -1588,17 +1588,18 @@ void PF_makestatic (void)
 	
 	ent = G_EDICT(OFS_PARM0);
 
-	MSG_WriteByte (&sv.signon,svc_spawnstatic);
+	SV_ReserveSignon (14);
+	MSG_WriteByte (sv.signon,svc_spawnstatic);
 
-	MSG_WriteByte (&sv.signon, SV_ModelIndex(pr_strings + ent->v.model));
+	MSG_WriteByte (sv.signon, SV_ModelIndex(pr_strings + ent->v.model));
 
-	MSG_WriteByte (&sv.signon, ent->v.frame);
-	MSG_WriteByte (&sv.signon, ent->v.colormap);
-	MSG_WriteByte (&sv.signon, ent->v.skin);
+	MSG_WriteByte (sv.signon, ent->v.frame);
+	MSG_WriteByte (sv.signon, ent->v.colormap);
+	MSG_WriteByte (sv.signon, ent->v.skin);
 	for (i=0 ; i<3 ; i++)
 	{
-		MSG_WriteCoord(&sv.signon, ent->v.origin[i]);
-		MSG_WriteAngle(&sv.signon, ent->v.angles[i]);
+		MSG_WriteCoord(sv.signon, ent->v.origin[i]);
+		MSG_WriteAngle(sv.signon, ent->v.angles[i]);
 	}
 
 // throw the entity away now
@@ -31,6 +31,8 @@ globalvars_t	*pr_global_struct;
 float			*pr_globals;			// same as pr_global_struct
 int				pr_edict_size;	// in bytes
 
+byte			*pr_fieldwatch;
+
 unsigned short		pr_crc;
 
 int		type_size[8] = {1,sizeof(string_t)/4,1,3,1,1,sizeof(func_t)/4,sizeof(void *)/4};
@@ -58,6 +60,49 @@ typedef struct {
 	char	field[MAX_FIELD_LEN];
 } gefv_cache;
 
+// name lookups for fields, globals and functions, built by PR_LoadProgs
+#define	PR_HASH_SIZE	1024
+
+typedef struct
+{
+	int		head[PR_HASH_SIZE];		// -1 for an empty chain
+	int		*next;					// one per name
+} prhash_t;
+
+prhash_t	pr_fieldhash;
+prhash_t	pr_globalhash;
+prhash_t	pr_functionhash;
+
+// string fields searched by find, see ED_FindString
+#define	MAX_FINDINDEXES	8
+
+typedef struct
+{
+	int			field;
+	qboolean	valid;
+	int			numedicts;				// sv.num_edicts when it was built
+	int			head[PR_HASH_SIZE];		// 0 for an empty chain
+	int			temphead;				// edicts with a temp string, tried by every find
+	int			*next;					// one per edict, 0 at the end of a chain
+	int			*chain;					// one per edict, the chain it is in
+} findindex_t;
+
+#define	FIND_TEMPCHAIN	PR_HASH_SIZE	// chain for the temphead list
+
+findindex_t	*pr_findindexes[MAX_FINDINDEXES];
+int			pr_numfindindexes;
+
+// every distinct string made by ED_NewString, along with the progs' own
+#define	INTERN_HASH_SIZE	4096
+
+typedef struct internstring_s
+{
+	struct internstring_s	*next;
+	char					*string;
+} internstring_t;
+
+internstring_t	*pr_internhash[INTERN_HASH_SIZE];
+
 static gefv_cache	gefvCache[GEFV_CACHESIZE] = {{NULL, ""}, {NULL, ""}};
 
 /*
@@ -101,8 +146,9 @@ edict_t *ED_Alloc (void)
 		}
 	}
 	
-	if (i == MAX_EDICTS)
+	if (i == sv.edict_limit)
 		Sys_Error ("ED_Alloc: no free edicts");
+	SV_GrowEdicts (i+1);
 		
 	sv.num_edicts++;
 	e = EDICT_NUM(i);
@@ -178,6 +224,40 @@ ddef_t *ED_FieldAtOfs (int ofs)
 	return NULL;
 }
 
+/*
+============
+PR_HashName
+============
+*/
+int PR_HashName (char *name)
+{
+	return COM_HashString (name) & (PR_HASH_SIZE-1);
+}
+
+/*
+============
+PR_HashNames
+
+Chains count names into hash.  Going backwards leaves each chain in progs
+order, so the first match is the one a search through the whole list finds.
+============
+*/
+void PR_HashNames (prhash_t *hash, int count, int *names, int stride)
+{
+	int		i, h;
+
+	hash->next = Hunk_AllocName (count * sizeof(int), "prhash");
+	for (i=0 ; i<PR_HASH_SIZE ; i++)
+		hash->head[i] = -1;
+
+	for (i=count-1 ; i>=0 ; i--)
+	{
+		h = PR_HashName (pr_strings + *(int *)((byte *)names + i*stride));
+		hash->next[i] = hash->head[h];
+		hash->head[h] = i;
+	}
+}
+
 /*
 ============
 ED_FindField
@@ -188,7 +268,7 @@ ddef_t *ED_FindField (char *name)
 	ddef_t		*def;
 	int			i;
 	
-	for (i=0 ; i<progs->numfielddefs ; i++)
+	for (i=pr_fieldhash.head[PR_HashName(name)] ; i != -1 ; i=pr_fieldhash.next[i])
 	{
 		def = &pr_fielddefs[i];
 		if (!strcmp(pr_strings + def->s_name,name) )
@@ -208,7 +288,7 @@ ddef_t *ED_FindGlobal (char *name)
 	ddef_t		*def;
 	int			i;
 	
-	for (i=0 ; i<progs->numglobaldefs ; i++)
+	for (i=pr_globalhash.head[PR_HashName(name)] ; i != -1 ; i=pr_globalhash.next[i])
 	{
 		def = &pr_globaldefs[i];
 		if (!strcmp(pr_strings + def->s_name,name) )
@@ -228,7 +308,7 @@ dfunction_t *ED_FindFunction (char *name)
 	dfunction_t		*func;
 	int				i;
 	
-	for (i=0 ; i<progs->numfunctions ; i++)
+	for (i=pr_functionhash.head[PR_HashName(name)] ; i != -1 ; i=pr_functionhash.next[i])
 	{
 		func = &pr_functions[i];
 		if (!strcmp(pr_strings + func->s_name,name) )
@@ -238,6 +318,237 @@ dfunction_t *ED_FindFunction (char *name)
 }
 
 
+/*
+============
+ED_WatchField
+
+Sets flag for every component of the named field, so writes to it reach
+ED_FieldWritten
+============
+*/
+void ED_WatchField (char *name, int flag)
+{
+	ddef_t		*def;
+	int			i;
+
+	def = ED_FindField (name);
+	if (!def)
+		Sys_Error ("ED_WatchField: no field %s", name);
+	for (i=0 ; i<type_size[def->type & ~DEF_SAVEGLOBAL] ; i++)
+		pr_fieldwatch[def->ofs + i] |= flag;
+}
+
+/*
+============
+ED_UnwatchField
+============
+*/
+void ED_UnwatchField (char *name, int flag)
+{
+	ddef_t		*def;
+	int			i;
+
+	def = ED_FindField (name);
+	if (!def)
+		Sys_Error ("ED_UnwatchField: no field %s", name);
+	for (i=0 ; i<type_size[def->type & ~DEF_SAVEGLOBAL] ; i++)
+		pr_fieldwatch[def->ofs + i] &= ~flag;
+}
+
+/*
+============
+ED_FieldWritten
+
+Called by the progs as they take the address of a watched field, and by
+ED_ParseEdict, before the new value is stored
+============
+*/
+void ED_FieldWritten (edict_t *ed, int ofs)
+{
+	int		i;
+
+	if (pr_fieldwatch[ofs] & FW_MOVED)
+		SV_EdictMoved (ed);
+	if (pr_fieldwatch[ofs] & FW_TRACE)
+		SV_TraceChanged (ed);
+	if (pr_fieldwatch[ofs] & FW_FIND)
+		for (i=0 ; i<pr_numfindindexes ; i++)
+			if (pr_findindexes[i]->field == ofs)
+				pr_findindexes[i]->valid = false;
+}
+
+/*
+=============================================================================
+
+FIND INDEXES
+
+A find on a string field is answered from a hash of the values the field
+had when it was last searched.  The index for a field is made the first
+time it is searched, and rebuilt on the next search after any write to it.
+Each hash chain is in edict order, and each edict knows which chain it is
+in, so a loop of finds picks up each time where the last one left off.
+
+A temp string, from ftos and the like, is rewritten without any write to the
+field that points at it, so its hash can't be trusted.  Edicts holding one
+are kept on a list of their own, and every find goes through it alongside
+the chain, in edict order.
+
+=============================================================================
+*/
+
+/*
+============
+ED_FindIndex
+
+The index for field, NULL if there is no room for another
+============
+*/
+findindex_t *ED_FindIndex (int field)
+{
+	findindex_t	*index;
+	int			i;
+
+	for (i=0 ; i<pr_numfindindexes ; i++)
+		if (pr_findindexes[i]->field == field)
+			return pr_findindexes[i];
+
+	if (pr_numfindindexes == MAX_FINDINDEXES)
+		return NULL;
+	if ((unsigned)field >= progs->entityfields)
+		return NULL;
+
+	index = Hunk_AllocName (sizeof(findindex_t), "findindex");
+	index->next = Hunk_AllocName (sv.edict_limit*sizeof(int), "findindex");
+	index->chain = Hunk_AllocName (sv.edict_limit*sizeof(int), "findindex");
+	index->field = field;
+	index->valid = false;
+	pr_findindexes[pr_numfindindexes++] = index;
+	pr_fieldwatch[field] |= FW_FIND;
+
+	return index;
+}
+
+/*
+============
+ED_BuildFindIndex
+
+Free edicts are hashed too, a find skips them as it goes
+============
+*/
+void ED_BuildFindIndex (findindex_t *index)
+{
+	int		i, h;
+	char	*s;
+
+	for (i=0 ; i<PR_HASH_SIZE ; i++)
+		index->head[i] = 0;
+	index->temphead = 0;
+
+	for (i=sv.num_edicts-1 ; i>0 ; i--)
+	{
+		s = E_STRING(EDICT_NUM(i), index->field);
+		if (PR_IsTempString (s))
+		{
+			index->chain[i] = FIND_TEMPCHAIN;
+			index->next[i] = index->temphead;
+			index->temphead = i;
+			continue;
+		}
+		h = PR_HashName (s);
+		index->chain[i] = h;
+		index->next[i] = index->head[h];
+		index->head[h] = i;
+	}
+
+	index->numedicts = sv.num_edicts;
+	index->valid = true;
+}
+
+/*
+============
+ED_FindString
+
+The first edict after start whose field matches s, or the world if none
+do.  An edict allocated since the index was built still has an empty
+string, until a write to the field throws the index away, so empty
+strings are searched for the old way.
+============
+*/
+edict_t *ED_FindString (int start, int field, char *s)
+{
+	findindex_t	*index;
+	edict_t		*ed;
+	int			e, t, h;
+
+	index = s[0] ? ED_FindIndex (field) : NULL;
+	if (!index)
+	{
+		for (e=start+1 ; e<sv.num_edicts ; e++)
+		{
+			ed = EDICT_NUM(e);
+			if (ed->free)
+				continue;
+			if (!strcmp(E_STRING(ed,field),s))
+				return ed;
+		}
+		return sv.edicts;
+	}
+
+	if (!index->valid)
+		ED_BuildFindIndex (index);
+
+	h = PR_HashName (s);
+	if (start > 0 && start < index->numedicts && index->chain[start] == h)
+		e = index->next[start];
+	else
+		for (e=index->head[h] ; e && e <= start ; e=index->next[e])
+			;
+
+	if (start > 0 && start < index->numedicts && index->chain[start] == FIND_TEMPCHAIN)
+		t = index->next[start];
+	else
+		for (t=index->temphead ; t && t <= start ; t=index->next[t])
+			;
+
+// the lower of the two each time
+	while (e || t)
+	{
+		if (e && (!t || e < t))
+		{
+			ed = EDICT_NUM(e);
+			e = index->next[e];
+		}
+		else
+		{
+			ed = EDICT_NUM(t);
+			t = index->next[t];
+		}
+		if (ed->free)
+			continue;
+		if (!strcmp(E_STRING(ed,field),s))
+			return ed;
+	}
+
+	return sv.edicts;
+}
+
+/*
+============
+ED_StringsChanged
+
+Called when a string the progs may point at is changed in place, like a
+client's name
+============
+*/
+void ED_StringsChanged (void)
+{
+	int		i;
+
+	for (i=0 ; i<pr_numfindindexes ; i++)
+		pr_findindexes[i]->valid = false;
+}
+
+
 eval_t *GetEdictFieldValue(edict_t *ed, char *field)
 {
 	ddef_t			*def = NULL;
@@ -685,18 +996,59 @@ void ED_ParseGlobals (char *data)
 //============================================================================
 
 
+/*
+=============
+ED_InternSeed
+
+Puts every string in the progs into the intern table, so entity strings
+that match one, like a classname and the spawn function named for it, cost
+nothing
+=============
+*/
+void ED_InternSeed (void)
+{
+	internstring_t	*nodes, *node;
+	int				i, count, h;
+
+	memset (pr_internhash, 0, sizeof(pr_internhash));
+
+	count = 0;
+	for (i=0 ; i<progs->numstrings ; i++)
+		if (!i || !pr_strings[i-1])
+			count++;
+	nodes = Hunk_AllocName (count*sizeof(internstring_t), "strings");
+
+	// backwards, so the first of any duplicates is found first
+	for (i=progs->numstrings-1 ; i>=0 ; i--)
+	{
+		if (i && pr_strings[i-1])
+			continue;
+		node = &nodes[--count];
+		node->string = pr_strings + i;
+		h = COM_HashString (node->string) & (INTERN_HASH_SIZE-1);
+		node->next = pr_internhash[h];
+		pr_internhash[h] = node;
+	}
+}
+
 /*
 =============
 ED_NewString
+
+Returns the string with its escapes turned into characters.  Identical
+strings are only stored once, and never change, so they can be shared.
 =============
 */
 char *ED_NewString (char *string)
 {
+	internstring_t	*node;
 	char	*new, *new_p;
-	int		i,l;
+	int		i, l, h, mark;
 	
 	l = strlen(string) + 1;
-	new = Hunk_Alloc (l);
+	mark = Hunk_LowMark ();
+	node = Hunk_AllocName (sizeof(internstring_t) + l, "strings");
+	new = (char *)(node + 1);
 	new_p = new;
 
 	for (i=0 ; i< l ; i++)
@@ -712,6 +1064,19 @@ char *ED_NewString (char *string)
 		else
 			*new_p++ = string[i];
 	}
+
+	h = COM_HashString (new) & (INTERN_HASH_SIZE-1);
+	for (node=pr_internhash[h] ; node ; node=node->next)
+		if (!strcmp(node->string, new))
+		{
+			Hunk_FreeToLowMark (mark);	// already have it
+			return node->string;
+		}
+
+	node = (internstring_t *)new - 1;
+	node->string = new;
+	node->next = pr_internhash[h];
+	pr_internhash[h] = node;
 	
 	return new;
 }
@@ -876,6 +1241,8 @@ strcpy (temp, com_token);
 sprintf (com_token, "0 %s 0", temp);
 }
 
+		if (pr_fieldwatch[key->ofs])
+			ED_FieldWritten (ent, key->ofs);
 		if (!ED_ParseEpair ((void *)&ent->v, key, com_token))
 			Host_Error ("ED_ParseEdict: parse error");
 	}
@@ -990,6 +1357,8 @@ void PR_LoadProgs (void)
 	for (i=0 ; i<GEFV_CACHESIZE ; i++)
 		gefvCache[i].field[0] = 0;
 
+	PR_BenchAbort ();
+
 	CRC_Init (&pr_crc);
 
 	progs = (dprograms_t *)COM_LoadHunkFile ("progs.dat");
@@ -1057,6 +1426,24 @@ void PR_LoadProgs (void)
 
 	for (i=0 ; i<progs->numglobals ; i++)
 		((int *)pr_globals)[i] = LittleLong (((int *)pr_globals)[i]);
+
+	PR_HashNames (&pr_fieldhash, progs->numfielddefs, &pr_fielddefs->s_name, sizeof(ddef_t));
+	PR_HashNames (&pr_globalhash, progs->numglobaldefs, &pr_globaldefs->s_name, sizeof(ddef_t));
+	PR_HashNames (&pr_functionhash, progs->numfunctions, &pr_functions->s_name, sizeof(dfunction_t));
+
+// writes to these need more than the store
+	pr_fieldwatch = Hunk_AllocName (progs->entityfields, "fieldwatch");
+	pr_numfindindexes = 0;
+
+	ED_InternSeed ();
+	ED_WatchField ("origin", FW_MOVED);
+	ED_WatchField ("mins", FW_MOVED);
+	ED_WatchField ("maxs", FW_MOVED);
+	ED_WatchField ("solid", FW_MOVED);
+
+	PR_ProfileLoad ();
+	PR_DecodeProgram ();
+	PR_JitProgram ();
 }
 
 
@@ -1071,6 +1458,9 @@ void PR_Init (void)
 	Cmd_AddCommand ("edicts", ED_PrintEdicts);
 	Cmd_AddCommand ("edictcount", ED_Count);
 	Cmd_AddCommand ("profile", PR_Profile_f);
+	Cmd_AddCommand ("progsbench", PR_Bench_f);
+	pr_nodecode = COM_CheckParm ("-noprogdecode") != 0;
+	pr_usejit = COM_CheckParm ("-progjit") != 0;
 	Cvar_RegisterVariable (&nomonsters);
 	Cvar_RegisterVariable (&gamecfg);
 	Cvar_RegisterVariable (&scratch1);
@@ -213,44 +213,6 @@ void PR_StackTrace (void)
 }
 
 
-/*
-============
-PR_Profile_f
-
-============
-*/
-void PR_Profile_f (void)
-{
-	dfunction_t	*f, *best;
-	int			max;
-	int			num;
-	int			i;
-	
-	num = 0;	
-	do
-	{
-		max = 0;
-		best = NULL;
-		for (i=0 ; i<progs->numfunctions ; i++)
-		{
-			f = &pr_functions[i];
-			if (f->profile > max)
-			{
-				max = f->profile;
-				best = f;
-			}
-		}
-		if (best)
-		{
-			if (num < 10)
-				Con_Printf ("%7i %s\n", best->profile, pr_strings+best->s_name);
-			num++;
-			best->profile = 0;
-		}
-	} while (best);
-}
-
-
 /*
 ============
 PR_RunError
@@ -295,6 +257,9 @@ int PR_EnterFunction (dfunction_t *f)
 {
 	int		i, j, c, o;
 
+	if (pr_profiling)
+		PR_ProfileEnter (f);
+
 	pr_stack[pr_depth].s = pr_xstatement;
 	pr_stack[pr_depth].f = pr_xfunction;	
 	pr_depth++;
@@ -337,6 +302,9 @@ int PR_LeaveFunction (void)
 	if (pr_depth <= 0)
 		Sys_Error ("prog stack underflow");
 
+	if (pr_profiling)
+		PR_ProfileLeave ();
+
 // restore locals from the stack
 	c = pr_xfunction->locals;
 	localstack_used -= c;
@@ -353,6 +321,618 @@ int PR_LeaveFunction (void)
 }
 
 
+/*
+============================================================================
+
+DECODED EXECUTION
+
+The statements are decoded once when the progs are loaded, so the loop that
+runs them doesn't have to look up operands, and tracing and statement
+counting are left to the classic loop.  A compare that only feeds the
+IFNOT after it, and an ADDRESS that only feeds the STOREP after it, are
+run as one statement.
+
+runaway and the profile counts are charged at branches, calls and returns,
+for the statements that ran straight into them, so they come out a little
+lower than in the classic loop.
+
+-noprogdecode runs everything through the classic loop.
+============================================================================
+*/
+
+// fused statements, which run their own op and then the one after it
+enum
+{
+	PRX_EQ_F_IFNOT = 256,
+	PRX_NE_F_IFNOT,
+	PRX_LE_IFNOT,
+	PRX_GE_IFNOT,
+	PRX_LT_IFNOT,
+	PRX_GT_IFNOT,
+	PRX_EQ_E_IFNOT,
+	PRX_NE_E_IFNOT,
+	PRX_NOT_F_IFNOT,
+	PRX_NOT_ENT_IFNOT,
+	PRX_NOT_FNC_IFNOT,
+	PRX_ADDRESS_STOREP,
+	PRX_ADDRESS_STOREP_V
+};
+
+prcode_t	*pr_code;		// one per statement, NULL when not decoding
+qboolean	pr_nodecode;
+
+/*
+====================
+PR_IsBranch
+====================
+*/
+qboolean PR_IsBranch (int op)
+{
+	return op == OP_IF || op == OP_IFNOT || op == OP_GOTO
+		|| (op >= OP_CALL0 && op <= OP_CALL8)
+		|| op == OP_RETURN || op == OP_DONE;
+}
+
+/*
+====================
+PR_FusedOp
+
+The fused version of st followed by next, or 0 if there isn't one
+====================
+*/
+int PR_FusedOp (dstatement_t *st, dstatement_t *next)
+{
+	if (next->op == OP_IFNOT && next->a == st->c)
+	{
+		switch (st->op)
+		{
+		case OP_EQ_F: return PRX_EQ_F_IFNOT;
+		case OP_NE_F: return PRX_NE_F_IFNOT;
+		case OP_LE: return PRX_LE_IFNOT;
+		case OP_GE: return PRX_GE_IFNOT;
+		case OP_LT: return PRX_LT_IFNOT;
+		case OP_GT: return PRX_GT_IFNOT;
+		case OP_EQ_E: return PRX_EQ_E_IFNOT;
+		case OP_NE_E: return PRX_NE_E_IFNOT;
+		case OP_NOT_F: return PRX_NOT_F_IFNOT;
+		case OP_NOT_ENT: return PRX_NOT_ENT_IFNOT;
+		case OP_NOT_FNC: return PRX_NOT_FNC_IFNOT;
+		}
+		return 0;
+	}
+
+	if (st->op == OP_ADDRESS && next->b == st->c)
+	{
+		switch (next->op)
+		{
+		case OP_STOREP_F:
+		case OP_STOREP_ENT:
+		case OP_STOREP_FLD:
+		case OP_STOREP_S:
+		case OP_STOREP_FNC:
+			return PRX_ADDRESS_STOREP;
+		case OP_STOREP_V:
+			return PRX_ADDRESS_STOREP_V;
+		}
+	}
+
+	return 0;
+}
+
+/*
+====================
+PR_DecodeProgram
+
+Called by PR_LoadProgs
+====================
+*/
+void PR_DecodeProgram (void)
+{
+	dstatement_t	*st;
+	prcode_t		*code;
+	byte			*leader;
+	int				i, n, run, fused;
+
+	pr_code = NULL;
+	if (pr_nodecode)
+		return;
+
+	n = progs->numstatements;
+	pr_code = Hunk_AllocName (n * sizeof(prcode_t), "progcode");
+
+// find where runs of statements can be entered other than from the top
+	leader = Hunk_TempAlloc (n + 1);
+	memset (leader, 0, n + 1);
+	for (i=0 ; i<progs->numfunctions ; i++)
+		if (pr_functions[i].first_statement > 0 && pr_functions[i].first_statement < n)
+			leader[pr_functions[i].first_statement] = 1;
+	for (i=0, st=pr_statements ; i<n ; i++, st++)
+	{
+		if (st->op == OP_IF || st->op == OP_IFNOT)
+		{
+			if (i + st->b >= 0 && i + st->b < n)
+				leader[i + st->b] = 1;
+		}
+		else if (st->op == OP_GOTO)
+		{
+			if (i + st->a >= 0 && i + st->a < n)
+				leader[i + st->a] = 1;
+		}
+	}
+
+	run = 0;
+	for (i=0, st=pr_statements, code=pr_code ; i<n ; i++, st++, code++)
+	{
+		if (leader[i])
+			run = 0;
+		run++;
+
+		code->op = st->op;
+		code->a = (eval_t *)&pr_globals[st->a];
+		code->b = (eval_t *)&pr_globals[st->b];
+		code->c = (eval_t *)&pr_globals[st->c];
+		code->jump = 0;
+		code->cost = 0;
+
+		switch (st->op)
+		{
+		case OP_IF:
+		case OP_IFNOT:
+			code->b = NULL;
+			code->jump = i + st->b;
+			break;
+		case OP_GOTO:
+			code->a = NULL;
+			code->jump = i + st->a;
+			break;
+		}
+
+		if (PR_IsBranch (st->op))
+		{
+			code->cost = run;
+			run = 0;
+		}
+
+		if (i + 1 < n && !leader[i+1])
+		{
+			fused = PR_FusedOp (st, st + 1);
+			if (fused)
+				code->op = fused;
+		}
+	}
+}
+
+#define	PR_CHARGE(st)										\
+	{														\
+		pr_xfunction->profile += (st)->cost;				\
+		runaway -= (st)->cost;								\
+		if (runaway <= 0)									\
+		{													\
+			pr_xstatement = (st) - pr_code;					\
+			PR_RunError ("runaway loop error");				\
+		}													\
+	}
+
+/*
+====================
+PR_ExecuteCode
+
+Runs decoded statements starting after s, until the function that was
+entered at exitdepth returns (-1), or tracing is turned on, in which case it
+returns the statement for the classic loop to go on after.  Either way what
+is left of the runaway count goes back in runawayleft.
+====================
+*/
+int PR_ExecuteCode (int s, int exitdepth, int *runawayleft)
+{
+	prcode_t	*st;
+	dfunction_t	*newf;
+	edict_t		*ed;
+	eval_t		*ptr;
+	int			runaway;
+	int			i;
+
+	runaway = *runawayleft;
+	st = pr_code + s + 1;
+
+while (1)
+{
+	switch (st->op)
+	{
+	case OP_ADD_F:
+		st->c->_float = st->a->_float + st->b->_float;
+		st++;
+		break;
+	case OP_ADD_V:
+		st->c->vector[0] = st->a->vector[0] + st->b->vector[0];
+		st->c->vector[1] = st->a->vector[1] + st->b->vector[1];
+		st->c->vector[2] = st->a->vector[2] + st->b->vector[2];
+		st++;
+		break;
+		
+	case OP_SUB_F:
+		st->c->_float = st->a->_float - st->b->_float;
+		st++;
+		break;
+	case OP_SUB_V:
+		st->c->vector[0] = st->a->vector[0] - st->b->vector[0];
+		st->c->vector[1] = st->a->vector[1] - st->b->vector[1];
+		st->c->vector[2] = st->a->vector[2] - st->b->vector[2];
+		st++;
+		break;
+
+	case OP_MUL_F:
+		st->c->_float = st->a->_float * st->b->_float;
+		st++;
+		break;
+	case OP_MUL_V:
+		st->c->_float = st->a->vector[0]*st->b->vector[0]
+				+ st->a->vector[1]*st->b->vector[1]
+				+ st->a->vector[2]*st->b->vector[2];
+		st++;
+		break;
+	case OP_MUL_FV:
+		st->c->vector[0] = st->a->_float * st->b->vector[0];
+		st->c->vector[1] = st->a->_float * st->b->vector[1];
+		st->c->vector[2] = st->a->_float * st->b->vector[2];
+		st++;
+		break;
+	case OP_MUL_VF:
+		st->c->vector[0] = st->b->_float * st->a->vector[0];
+		st->c->vector[1] = st->b->_float * st->a->vector[1];
+		st->c->vector[2] = st->b->_float * st->a->vector[2];
+		st++;
+		break;
+
+	case OP_DIV_F:
+		st->c->_float = st->a->_float / st->b->_float;
+		st++;
+		break;
+	
+	case OP_BITAND:
+		st->c->_float = (int)st->a->_float & (int)st->b->_float;
+		st++;
+		break;
+	
+	case OP_BITOR:
+		st->c->_float = (int)st->a->_float | (int)st->b->_float;
+		st++;
+		break;
+	
+		
+	case OP_GE:
+		st->c->_float = st->a->_float >= st->b->_float;
+		st++;
+		break;
+	case OP_LE:
+		st->c->_float = st->a->_float <= st->b->_float;
+		st++;
+		break;
+	case OP_GT:
+		st->c->_float = st->a->_float > st->b->_float;
+		st++;
+		break;
+	case OP_LT:
+		st->c->_float = st->a->_float < st->b->_float;
+		st++;
+		break;
+	case OP_AND:
+		st->c->_float = st->a->_float && st->b->_float;
+		st++;
+		break;
+	case OP_OR:
+		st->c->_float = st->a->_float || st->b->_float;
+		st++;
+		break;
+		
+	case OP_NOT_F:
+		st->c->_float = !st->a->_float;
+		st++;
+		break;
+	case OP_NOT_V:
+		st->c->_float = !st->a->vector[0] && !st->a->vector[1] && !st->a->vector[2];
+		st++;
+		break;
+	case OP_NOT_S:
+		st->c->_float = !st->a->string || !pr_strings[st->a->string];
+		st++;
+		break;
+	case OP_NOT_FNC:
+		st->c->_float = !st->a->function;
+		st++;
+		break;
+	case OP_NOT_ENT:
+		st->c->_float = (PROG_TO_EDICT(st->a->edict) == sv.edicts);
+		st++;
+		break;
+
+	case OP_EQ_F:
+		st->c->_float = st->a->_float == st->b->_float;
+		st++;
+		break;
+	case OP_EQ_V:
+		st->c->_float = (st->a->vector[0] == st->b->vector[0]) &&
+					(st->a->vector[1] == st->b->vector[1]) &&
+					(st->a->vector[2] == st->b->vector[2]);
+		st++;
+		break;
+	case OP_EQ_S:
+		st->c->_float = st->a->string == st->b->string
+			|| !strcmp(pr_strings+st->a->string,pr_strings+st->b->string);
+		st++;
+		break;
+	case OP_EQ_E:
+		st->c->_float = st->a->_int == st->b->_int;
+		st++;
+		break;
+	case OP_EQ_FNC:
+		st->c->_float = st->a->function == st->b->function;
+		st++;
+		break;
+
+
+	case OP_NE_F:
+		st->c->_float = st->a->_float != st->b->_float;
+		st++;
+		break;
+	case OP_NE_V:
+		st->c->_float = (st->a->vector[0] != st->b->vector[0]) ||
+					(st->a->vector[1] != st->b->vector[1]) ||
+					(st->a->vector[2] != st->b->vector[2]);
+		st++;
+		break;
+	case OP_NE_S:
+		st->c->_float = st->a->string == st->b->string ? 0
+			: strcmp(pr_strings+st->a->string,pr_strings+st->b->string);
+		st++;
+		break;
+	case OP_NE_E:
+		st->c->_float = st->a->_int != st->b->_int;
+		st++;
+		break;
+	case OP_NE_FNC:
+		st->c->_float = st->a->function != st->b->function;
+		st++;
+		break;
+
+//==================
+	case OP_STORE_F:
+	case OP_STORE_ENT:
+	case OP_STORE_FLD:		// integers
+	case OP_STORE_S:
+	case OP_STORE_FNC:		// pointers
+		st->b->_int = st->a->_int;
+		st++;
+		break;
+	case OP_STORE_V:
+		st->b->vector[0] = st->a->vector[0];
+		st->b->vector[1] = st->a->vector[1];
+		st->b->vector[2] = st->a->vector[2];
+		st++;
+		break;
+		
+	case OP_STOREP_F:
+	case OP_STOREP_ENT:
+	case OP_STOREP_FLD:		// integers
+	case OP_STOREP_S:
+	case OP_STOREP_FNC:		// pointers
+	storep:
+		ptr = (eval_t *)((byte *)sv.edicts + st->b->_int);
+		ptr->_int = st->a->_int;
+		st++;
+		break;
+	case OP_STOREP_V:
+	storep_v:
+		ptr = (eval_t *)((byte *)sv.edicts + st->b->_int);
+		ptr->vector[0] = st->a->vector[0];
+		ptr->vector[1] = st->a->vector[1];
+		ptr->vector[2] = st->a->vector[2];
+		st++;
+		break;
+		
+	case OP_ADDRESS:
+	case PRX_ADDRESS_STOREP:
+	case PRX_ADDRESS_STOREP_V:
+		ed = PROG_TO_EDICT(st->a->edict);
+#ifdef PARANOID
+		NUM_FOR_EDICT(ed);		// make sure it's in range
+#endif
+		if (ed == (edict_t *)sv.edicts && sv.state == ss_active)
+		{
+			pr_xstatement = st - pr_code;
+			PR_RunError ("assignment to world entity");
+		}
+		if ((unsigned)st->b->_int < progs->entityfields && pr_fieldwatch[st->b->_int])
+			ED_FieldWritten (ed, st->b->_int);
+		st->c->_int = (byte *)((int *)&ed->v + st->b->_int) - (byte *)sv.edicts;
+		if (st->op == PRX_ADDRESS_STOREP)
+		{
+			st++;
+			goto storep;
+		}
+		if (st->op == PRX_ADDRESS_STOREP_V)
+		{
+			st++;
+			goto storep_v;
+		}
+		st++;
+		break;
+		
+	case OP_LOAD_F:
+	case OP_LOAD_FLD:
+	case OP_LOAD_ENT:
+	case OP_LOAD_S:
+	case OP_LOAD_FNC:
+		ed = PROG_TO_EDICT(st->a->edict);
+#ifdef PARANOID
+		NUM_FOR_EDICT(ed);		// make sure it's in range
+#endif
+		st->c->_int = ((eval_t *)((int *)&ed->v + st->b->_int))->_int;
+		st++;
+		break;
+
+	case OP_LOAD_V:
+		ed = PROG_TO_EDICT(st->a->edict);
+#ifdef PARANOID
+		NUM_FOR_EDICT(ed);		// make sure it's in range
+#endif
+		ptr = (eval_t *)((int *)&ed->v + st->b->_int);
+		st->c->vector[0] = ptr->vector[0];
+		st->c->vector[1] = ptr->vector[1];
+		st->c->vector[2] = ptr->vector[2];
+		st++;
+		break;
+		
+//==================
+
+	case PRX_EQ_F_IFNOT:
+		st->c->_float = st->a->_float == st->b->_float;
+		st++;
+		goto ifnot;
+	case PRX_NE_F_IFNOT:
+		st->c->_float = st->a->_float != st->b->_float;
+		st++;
+		goto ifnot;
+	case PRX_LE_IFNOT:
+		st->c->_float = st->a->_float <= st->b->_float;
+		st++;
+		goto ifnot;
+	case PRX_GE_IFNOT:
+		st->c->_float = st->a->_float >= st->b->_float;
+		st++;
+		goto ifnot;
+	case PRX_LT_IFNOT:
+		st->c->_float = st->a->_float < st->b->_float;
+		st++;
+		goto ifnot;
+	case PRX_GT_IFNOT:
+		st->c->_float = st->a->_float > st->b->_float;
+		st++;
+		goto ifnot;
+	case PRX_EQ_E_IFNOT:
+		st->c->_float = st->a->_int == st->b->_int;
+		st++;
+		goto ifnot;
+	case PRX_NE_E_IFNOT:
+		st->c->_float = st->a->_int != st->b->_int;
+		st++;
+		goto ifnot;
+	case PRX_NOT_F_IFNOT:
+		st->c->_float = !st->a->_float;
+		st++;
+		goto ifnot;
+	case PRX_NOT_ENT_IFNOT:
+		st->c->_float = (PROG_TO_EDICT(st->a->edict) == sv.edicts);
+		st++;
+		goto ifnot;
+	case PRX_NOT_FNC_IFNOT:
+		st->c->_float = !st->a->function;
+		st++;
+		goto ifnot;
+
+	case OP_IFNOT:
+	ifnot:
+		PR_CHARGE (st);
+		if (!st->a->_int)
+			st = pr_code + st->jump;
+		else
+			st++;
+		break;
+		
+	case OP_IF:
+		PR_CHARGE (st);
+		if (st->a->_int)
+			st = pr_code + st->jump;
+		else
+			st++;
+		break;
+		
+	case OP_GOTO:
+		PR_CHARGE (st);
+		st = pr_code + st->jump;
+		break;
+		
+	case OP_CALL0:
+	case OP_CALL1:
+	case OP_CALL2:
+	case OP_CALL3:
+	case OP_CALL4:
+	case OP_CALL5:
+	case OP_CALL6:
+	case OP_CALL7:
+	case OP_CALL8:
+		pr_xstatement = st - pr_code;
+		PR_CHARGE (st);
+		pr_argc = st->op - OP_CALL0;
+		if (!st->a->function)
+			PR_RunError ("NULL function");
+
+		newf = &pr_functions[st->a->function];
+
+		if (newf->first_statement < 0)
+		{	// negative statements are built in functions
+			i = -newf->first_statement;
+			if (i >= pr_numbuiltins)
+				PR_RunError ("Bad builtin call number");
+			if (pr_profiling)
+			{
+				PR_ProfileEnter (newf);
+				pr_builtins[i] ();
+				PR_ProfileLeave ();
+			}
+			else
+				pr_builtins[i] ();
+			if (pr_trace)
+			{	// traceon, so the classic loop takes over
+				*runawayleft = runaway;
+				return st - pr_code;
+			}
+			st++;
+			break;
+		}
+
+		st = pr_code + PR_EnterFunction (newf) + 1;
+		break;
+
+	case OP_DONE:
+	case OP_RETURN:
+		PR_CHARGE (st);
+		pr_globals[OFS_RETURN] = st->a->vector[0];
+		pr_globals[OFS_RETURN+1] = st->a->vector[1];
+		pr_globals[OFS_RETURN+2] = st->a->vector[2];
+	
+		s = PR_LeaveFunction ();
+		if (pr_depth == exitdepth)
+		{
+			*runawayleft = runaway;
+			return -1;		// all done
+		}
+		st = pr_code + s + 1;
+		break;
+		
+	case OP_STATE:
+		ed = PROG_TO_EDICT(pr_global_struct->self);
+#ifdef FPS_20
+		ed->v.nextthink = pr_global_struct->time + 0.05;
+#else
+		ed->v.nextthink = pr_global_struct->time + 0.1;
+#endif
+		if (st->a->_float != ed->v.frame)
+		{
+			ed->v.frame = st->a->_float;
+		}
+		ed->v.think = st->b->function;
+		st++;
+		break;
+		
+	default:
+		pr_xstatement = st - pr_code;
+		PR_RunError ("Bad opcode %i", st->op);
+	}
+}
+
+}
+
 /*
 ====================
 PR_ExecuteProgram
@@ -370,6 +950,12 @@ void PR_ExecuteProgram (func_t fnum)
 	int		exitdepth;
 	eval_t	*ptr;
 
+	if (pr_benchmarking && !pr_depth)
+	{
+		PR_BenchProgram (fnum);
+		return;
+	}
+
 	if (!fnum || fnum >= progs->numfunctions)
 	{
 		if (pr_global_struct->self)
@@ -386,6 +972,16 @@ void PR_ExecuteProgram (func_t fnum)
 	exitdepth = pr_depth;
 
 	s = PR_EnterFunction (f);
+
+	if (pr_jitcode || pr_code)
+	{
+		if (pr_jitcode)
+			s = PR_ExecuteJit (s, exitdepth, &runaway);
+		else
+			s = PR_ExecuteCode (s, exitdepth, &runaway);
+		if (s == -1)
+			return;
+	}
 	
 while (1)
 {
@@ -404,6 +1000,8 @@ while (1)
 	
 	if (pr_trace)
 		PR_PrintStatement (st);
+	if (pr_opclock)
+		PR_ClockStatement (st->op);
 		
 	switch (st->op)
 	{
@@ -501,7 +1099,8 @@ while (1)
 					(a->vector[2] == b->vector[2]);
 		break;
 	case OP_EQ_S:
-		c->_float = !strcmp(pr_strings+a->string,pr_strings+b->string);
+		c->_float = a->string == b->string
+			|| !strcmp(pr_strings+a->string,pr_strings+b->string);
 		break;
 	case OP_EQ_E:
 		c->_float = a->_int == b->_int;
@@ -520,7 +1119,8 @@ while (1)
 					(a->vector[2] != b->vector[2]);
 		break;
 	case OP_NE_S:
-		c->_float = strcmp(pr_strings+a->string,pr_strings+b->string);
+		c->_float = a->string == b->string ? 0
+			: strcmp(pr_strings+a->string,pr_strings+b->string);
 		break;
 	case OP_NE_E:
 		c->_float = a->_int != b->_int;
@@ -565,6 +1165,8 @@ while (1)
 #endif
 		if (ed == (edict_t *)sv.edicts && sv.state == ss_active)
 			PR_RunError ("assignment to world entity");
+		if ((unsigned)b->_int < progs->entityfields && pr_fieldwatch[b->_int])
+			ED_FieldWritten (ed, b->_int);
 		c->_int = (byte *)((int *)&ed->v + b->_int) - (byte *)sv.edicts;
 		break;
 		
@@ -628,7 +1230,14 @@ while (1)
 			i = -newf->first_statement;
 			if (i >= pr_numbuiltins)
 				PR_RunError ("Bad builtin call number");
-			pr_builtins[i] ();
+			if (pr_profiling)
+			{
+				PR_ProfileEnter (newf);
+				pr_builtins[i] ();
+				PR_ProfileLeave ();
+			}
+			else
+				pr_builtins[i] ();
 			break;
 		}
 
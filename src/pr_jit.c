@@ -0,0 +1,1010 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pr_jit.c -- compiles progs to x86 or x86-64 code
+
+#include "quakedef.h"
+
+/*
+
+Every statement of a compiled function gets its own piece of native code,
+laid out in statement order so one falls through into the next.  The
+arithmetic, the field loads and stores and the branches run natively; calls,
+returns, string compares and anything else rare leave the native code with
+the number of the statement, which PR_ExecuteJit runs in C before going back
+in at the statement after it.  The VM stack is never touched by native code,
+so a call is just PR_EnterFunction and a jump to the callee's first statement.
+
+A function is only compiled if all its branches stay inside it.  Functions
+that aren't run through PR_ExecuteCode.
+
+While native code runs:
+	ebx		pr_globals
+	edi		pr_jit
+	esi		runaway
+
+Floats are done with SSE, one operation at a time.  Each result is rounded
+to a float as it is stored, which gives the same bits the C code does on
+either the x87 or SSE.  The dot product of OP_MUL_V is the exception: a
+32 bit build does the whole sum on the x87, in its wider precision, and
+rounds once at the end, so there native code uses the x87 for it too.  SSE
+there would round every product and sum, and could be off in the last bit.
+
+*/
+
+#if defined(_M_IX86) || defined(__i386__) || defined(_M_X64) || defined(__x86_64__)
+#define	JIT_SUPPORTED
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define	JIT_X64
+#endif
+
+#define	JIT_RUNAWAY		0x40000000	// or'd into the statement when runaway ran out
+#define	JIT_STATEMENT	0x3fffffff
+
+#define	JIT_MAX_STATEMENT	128		// most code any one statement compiles to
+
+#define	JIT_OFS(type, field)	((int)(size_t)&((type *)0)->field)
+
+// registers
+#define	EAX		0
+#define	ECX		1
+#define	EDX		2
+#define	EBX		3
+#define	ESI		6
+#define	EDI		7
+
+// condition codes, added to the short jump (0x70) and setcc (0x0f 0x90) opcodes
+#define	CC_P	0xa
+#define	CC_NP	0xb
+#define	CC_AE	0x3
+#define	CC_E	0x4
+#define	CC_NE	0x5
+#define	CC_A	0x7
+#define	CC_G	0xf
+
+typedef struct
+{
+	int			runaway;
+	byte		*target;	// where to go in
+	edict_t		*edicts;	// sv.edicts
+	byte		*fieldwatch;	// pr_fieldwatch
+} jitstate_t;
+
+typedef struct
+{
+	byte		*at;		// rel32 to patch
+	int			statement;
+} jitfixup_t;
+
+byte		**pr_jitcode;
+qboolean	pr_usejit;
+
+jitstate_t	pr_jit;
+int			(*pr_jitentry) (void);
+
+byte		*jit_buffer;
+byte		*jit_exit;			// common exit back to PR_ExecuteJit
+byte		*jit_p;
+
+jitfixup_t	*jit_fixups;
+int			jit_numfixups;
+
+#ifdef JIT_SUPPORTED
+
+/*
+============================================================================
+
+CODE EMISSION
+
+============================================================================
+*/
+
+void Jit_Byte (int b)
+{
+	*jit_p++ = b;
+}
+
+void Jit_Long (int l)
+{
+	Jit_Byte (l);
+	Jit_Byte (l >> 8);
+	Jit_Byte (l >> 16);
+	Jit_Byte (l >> 24);
+}
+
+// a REX.W prefix where pointers are 64 bits
+void Jit_RexW (void)
+{
+#ifdef JIT_X64
+	Jit_Byte (0x48);
+#endif
+}
+
+// mov reg, imm pointer
+void Jit_LoadPointer (int reg, void *ptr)
+{
+	size_t	p;
+	int		i;
+
+	Jit_RexW ();
+	Jit_Byte (0xb8 + reg);
+	p = (size_t)ptr;
+	for (i=0 ; i<sizeof(p) ; i++, p >>= 8)
+		Jit_Byte (p & 0xff);
+}
+
+// modrm for [ebx + ofs*4], the global at ofs
+void Jit_Global (int reg, int ofs)
+{
+	Jit_Byte (0x80 | (reg<<3) | EBX);
+	Jit_Long (ofs * 4);
+}
+
+// mov reg, global
+void Jit_LoadInt (int reg, int ofs)
+{
+	Jit_Byte (0x8b);
+	Jit_Global (reg, ofs);
+}
+
+// mov global, reg
+void Jit_StoreInt (int ofs, int reg)
+{
+	Jit_Byte (0x89);
+	Jit_Global (reg, ofs);
+}
+
+// movsxd reg, global, so it can be added to a pointer
+void Jit_LoadOffset (int reg, int ofs)
+{
+#ifdef JIT_X64
+	Jit_Byte (0x48);
+	Jit_Byte (0x63);
+#else
+	Jit_Byte (0x8b);
+#endif
+	Jit_Global (reg, ofs);
+}
+
+// movss/addss/etc xmm, global
+void Jit_SSE (int op, int xmm, int ofs)
+{
+	Jit_Byte (0xf3);
+	Jit_Byte (0x0f);
+	Jit_Byte (op);
+	Jit_Global (xmm, ofs);
+}
+
+#define	SSE_LOAD	0x10
+#define	SSE_STORE	0x11
+#define	SSE_ADD		0x58
+#define	SSE_MUL		0x59
+#define	SSE_SUB		0x5c
+#define	SSE_DIV		0x5e
+
+#ifndef JIT_X64
+// fld/fmul/fstp etc global
+void Jit_X87 (int op, int sub, int ofs)
+{
+	Jit_Byte (op);
+	Jit_Global (sub, ofs);
+}
+
+#define	X87_LOAD	0xd9, 0		// fld dword
+#define	X87_MUL		0xd8, 1		// fmul dword
+#define	X87_STORE	0xd9, 3		// fstp dword
+#endif
+
+// ucomiss xmm0, global
+void Jit_CompareFloat (int ofs)
+{
+	Jit_Byte (0x0f);
+	Jit_Byte (0x2e);
+	Jit_Global (0, ofs);
+}
+
+// setcc reg8
+void Jit_Set (int cc, int reg)
+{
+	Jit_Byte (0x0f);
+	Jit_Byte (0x90 + cc);
+	Jit_Byte (0xc0 + reg);
+}
+
+// or/and reg8, reg8
+void Jit_Or8 (int dest, int src)
+{
+	Jit_Byte (0x08);
+	Jit_Byte (0xc0 | (src<<3) | dest);
+}
+
+void Jit_And8 (int dest, int src)
+{
+	Jit_Byte (0x20);
+	Jit_Byte (0xc0 | (src<<3) | dest);
+}
+
+/*
+================
+Jit_StoreBool
+
+Turns al into 0 or 1.0 in the global at ofs
+================
+*/
+void Jit_StoreBool (int ofs)
+{
+	Jit_Byte (0x0f);		// movzx eax, al
+	Jit_Byte (0xb6);
+	Jit_Byte (0xc0);
+	Jit_Byte (0xf7);		// neg eax
+	Jit_Byte (0xd8);
+	Jit_Byte (0x25);		// and eax, 1.0
+	Jit_Long (0x3f800000);
+	Jit_StoreInt (ofs, EAX);
+}
+
+/*
+================
+Jit_NotZero
+
+Sets reg8 if the float global at ofs is not 0, which a NaN isn't
+================
+*/
+void Jit_NotZero (int reg, int ofs)
+{
+	Jit_SSE (SSE_LOAD, 0, ofs);
+	Jit_Byte (0x0f);		// xorps xmm1, xmm1
+	Jit_Byte (0x57);
+	Jit_Byte (0xc9);
+	Jit_Byte (0x0f);		// ucomiss xmm0, xmm1
+	Jit_Byte (0x2e);
+	Jit_Byte (0xc1);
+	Jit_Set (CC_NE, reg);
+	Jit_Set (CC_P, EDX);
+	Jit_Or8 (reg, EDX);
+}
+
+/*
+================
+Jit_Exit
+
+Leaves the native code with code in eax
+================
+*/
+void Jit_Exit (int code)
+{
+	Jit_Byte (0xb8);		// mov eax, code
+	Jit_Long (code);
+	Jit_Byte (0xe9);		// jmp jit_exit
+	Jit_Long (jit_exit - (jit_p + 4));
+}
+
+/*
+================
+Jit_Jump
+
+A jump to another statement of the function, cc -1 for always
+================
+*/
+void Jit_Jump (int cc, int statement)
+{
+	if (cc < 0)
+		Jit_Byte (0xe9);
+	else
+	{
+		Jit_Byte (0x0f);
+		Jit_Byte (0x80 + cc);
+	}
+
+	jit_fixups[jit_numfixups].at = jit_p;
+	jit_fixups[jit_numfixups].statement = statement;
+	jit_numfixups++;
+	Jit_Long (0);
+}
+
+/*
+================
+Jit_Charge
+
+Takes a run of statements off runaway and adds it to the profile, the way
+PR_ExecuteCode does at branches, calls and returns
+================
+*/
+void Jit_Charge (int statement, dfunction_t *f)
+{
+	int		cost;
+
+	cost = pr_code[statement].cost;
+	if (!cost)
+		return;
+
+	Jit_LoadPointer (EAX, &f->profile);
+	Jit_Byte (0x81);		// add dword [eax], cost
+	Jit_Byte (0x00);
+	Jit_Long (cost);
+
+	Jit_Byte (0x81);		// sub esi, cost
+	Jit_Byte (0xe8 + ESI);
+	Jit_Long (cost);
+
+	Jit_Byte (0x70 + CC_G);	// jg over the exit
+	Jit_Byte (10);
+	Jit_Exit (statement | JIT_RUNAWAY);
+}
+
+/*
+================
+Jit_EdictField
+
+Leaves the address of field b of edict a in eax/rax
+================
+*/
+void Jit_EdictField (int a, int b)
+{
+	Jit_RexW ();			// mov eax, [edi].edicts
+	Jit_Byte (0x8b);
+	Jit_Byte (0x47);
+	Jit_Byte (JIT_OFS(jitstate_t, edicts));
+	Jit_LoadOffset (ECX, a);
+	Jit_RexW ();			// add eax, ecx
+	Jit_Byte (0x01);
+	Jit_Byte (0xc8);
+	Jit_LoadOffset (ECX, b);
+	Jit_RexW ();			// lea eax, [eax + ecx*4 + v]
+	Jit_Byte (0x8d);
+	Jit_Byte (0x84);
+	Jit_Byte (0x88);
+	Jit_Long (JIT_OFS(edict_t, v));
+}
+
+/*
+============================================================================
+
+COMPILING
+
+============================================================================
+*/
+
+/*
+================
+Jit_Statement
+
+Compiles statement i of function f
+================
+*/
+void Jit_Statement (int i, dfunction_t *f)
+{
+	dstatement_t	*st;
+	int				a, b, c, k;
+	byte			*skip;
+
+	st = &pr_statements[i];
+	a = st->a;
+	b = st->b;
+	c = st->c;
+
+	switch (st->op)
+	{
+	case OP_ADD_F:
+	case OP_SUB_F:
+	case OP_MUL_F:
+	case OP_DIV_F:
+		Jit_SSE (SSE_LOAD, 0, a);
+		if (st->op == OP_ADD_F)
+			Jit_SSE (SSE_ADD, 0, b);
+		else if (st->op == OP_SUB_F)
+			Jit_SSE (SSE_SUB, 0, b);
+		else if (st->op == OP_MUL_F)
+			Jit_SSE (SSE_MUL, 0, b);
+		else
+			Jit_SSE (SSE_DIV, 0, b);
+		Jit_SSE (SSE_STORE, 0, c);
+		break;
+
+	case OP_ADD_V:
+	case OP_SUB_V:
+		for (k=0 ; k<3 ; k++)
+		{
+			Jit_SSE (SSE_LOAD, 0, a+k);
+			Jit_SSE (st->op == OP_ADD_V ? SSE_ADD : SSE_SUB, 0, b+k);
+			Jit_SSE (SSE_STORE, 0, c+k);
+		}
+		break;
+
+	case OP_MUL_V:
+#ifdef JIT_X64
+		Jit_SSE (SSE_LOAD, 0, a);
+		Jit_SSE (SSE_MUL, 0, b);
+		for (k=1 ; k<3 ; k++)
+		{
+			Jit_SSE (SSE_LOAD, 1, a+k);
+			Jit_SSE (SSE_MUL, 1, b+k);
+			Jit_Byte (0xf3);		// addss xmm0, xmm1
+			Jit_Byte (0x0f);
+			Jit_Byte (0x58);
+			Jit_Byte (0xc1);
+		}
+		Jit_SSE (SSE_STORE, 0, c);
+#else
+		Jit_X87 (X87_LOAD, a);
+		Jit_X87 (X87_MUL, b);
+		for (k=1 ; k<3 ; k++)
+		{
+			Jit_X87 (X87_LOAD, a+k);
+			Jit_X87 (X87_MUL, b+k);
+			Jit_Byte (0xde);		// faddp st(1), st
+			Jit_Byte (0xc1);
+		}
+		Jit_X87 (X87_STORE, c);
+#endif
+		break;
+
+	case OP_MUL_FV:
+	case OP_MUL_VF:
+		if (st->op == OP_MUL_VF)
+		{	// c = b * a
+			k = a;
+			a = b;
+			b = k;
+		}
+		for (k=0 ; k<3 ; k++)
+		{
+			Jit_SSE (SSE_LOAD, 0, a);
+			Jit_SSE (SSE_MUL, 0, b+k);
+			Jit_SSE (SSE_STORE, 0, c+k);
+		}
+		break;
+
+	case OP_BITAND:
+	case OP_BITOR:
+		Jit_SSE (0x2c, EAX, a);		// cvttss2si eax, a
+		Jit_SSE (0x2c, ECX, b);
+		Jit_Byte (st->op == OP_BITAND ? 0x21 : 0x09);	// and/or eax, ecx
+		Jit_Byte (0xc8);
+		Jit_Byte (0xf3);			// cvtsi2ss xmm0, eax
+		Jit_Byte (0x0f);
+		Jit_Byte (0x2a);
+		Jit_Byte (0xc0);
+		Jit_SSE (SSE_STORE, 0, c);
+		break;
+
+// unordered compares set every flag, so a NaN is never less, greater or equal
+	case OP_GE:
+	case OP_GT:
+		Jit_SSE (SSE_LOAD, 0, a);
+		Jit_CompareFloat (b);
+		Jit_Set (st->op == OP_GE ? CC_AE : CC_A, EAX);
+		Jit_StoreBool (c);
+		break;
+	case OP_LE:
+	case OP_LT:
+		Jit_SSE (SSE_LOAD, 0, b);
+		Jit_CompareFloat (a);
+		Jit_Set (st->op == OP_LE ? CC_AE : CC_A, EAX);
+		Jit_StoreBool (c);
+		break;
+	case OP_EQ_F:
+		Jit_SSE (SSE_LOAD, 0, a);
+		Jit_CompareFloat (b);
+		Jit_Set (CC_E, EAX);
+		Jit_Set (CC_NP, ECX);
+		Jit_And8 (EAX, ECX);
+		Jit_StoreBool (c);
+		break;
+	case OP_NE_F:
+		Jit_SSE (SSE_LOAD, 0, a);
+		Jit_CompareFloat (b);
+		Jit_Set (CC_NE, EAX);
+		Jit_Set (CC_P, ECX);
+		Jit_Or8 (EAX, ECX);
+		Jit_StoreBool (c);
+		break;
+
+	case OP_AND:
+	case OP_OR:
+		Jit_NotZero (EAX, a);
+		Jit_NotZero (ECX, b);
+		if (st->op == OP_AND)
+			Jit_And8 (EAX, ECX);
+		else
+			Jit_Or8 (EAX, ECX);
+		Jit_StoreBool (c);
+		break;
+	case OP_NOT_F:
+		Jit_NotZero (EAX, a);
+		Jit_Byte (0x34);		// xor al, 1
+		Jit_Byte (0x01);
+		Jit_StoreBool (c);
+		break;
+
+	case OP_EQ_E:
+	case OP_NE_E:
+	case OP_EQ_FNC:
+	case OP_NE_FNC:
+		Jit_LoadInt (EAX, a);
+		Jit_Byte (0x3b);		// cmp eax, b
+		Jit_Global (EAX, b);
+		Jit_Set ((st->op == OP_EQ_E || st->op == OP_EQ_FNC) ? CC_E : CC_NE, EAX);
+		Jit_StoreBool (c);
+		break;
+	case OP_NOT_ENT:		// the world is at offset 0
+	case OP_NOT_FNC:
+		Jit_Byte (0x83);		// cmp dword a, 0
+		Jit_Global (7, a);
+		Jit_Byte (0x00);
+		Jit_Set (CC_E, EAX);
+		Jit_StoreBool (c);
+		break;
+
+	case OP_STORE_F:
+	case OP_STORE_ENT:
+	case OP_STORE_FLD:
+	case OP_STORE_S:
+	case OP_STORE_FNC:
+		Jit_LoadInt (EAX, a);
+		Jit_StoreInt (b, EAX);
+		break;
+	case OP_STORE_V:
+		for (k=0 ; k<3 ; k++)
+		{
+			Jit_LoadInt (EAX, a+k);
+			Jit_StoreInt (b+k, EAX);
+		}
+		break;
+
+	case OP_STOREP_F:
+	case OP_STOREP_ENT:
+	case OP_STOREP_FLD:
+	case OP_STOREP_S:
+	case OP_STOREP_FNC:
+	case OP_STOREP_V:
+		Jit_RexW ();			// mov eax, [edi].edicts
+		Jit_Byte (0x8b);
+		Jit_Byte (0x47);
+		Jit_Byte (JIT_OFS(jitstate_t, edicts));
+		Jit_LoadOffset (ECX, b);
+		Jit_RexW ();			// add eax, ecx
+		Jit_Byte (0x01);
+		Jit_Byte (0xc8);
+		for (k=0 ; k<(st->op == OP_STOREP_V ? 3 : 1) ; k++)
+		{
+			Jit_LoadInt (EDX, a+k);
+			Jit_Byte (0x89);	// mov [eax+k*4], edx
+			Jit_Byte (0x50);
+			Jit_Byte (k*4);
+		}
+		break;
+
+	case OP_LOAD_F:
+	case OP_LOAD_FLD:
+	case OP_LOAD_ENT:
+	case OP_LOAD_S:
+	case OP_LOAD_FNC:
+	case OP_LOAD_V:
+		Jit_EdictField (a, b);
+		for (k=0 ; k<(st->op == OP_LOAD_V ? 3 : 1) ; k++)
+		{
+			Jit_Byte (0x8b);	// mov edx, [eax+k*4]
+			Jit_Byte (0x50);
+			Jit_Byte (k*4);
+			Jit_StoreInt (c+k, EDX);
+		}
+		break;
+
+	case OP_ADDRESS:
+	// the offset doesn't depend on where the edicts are, but the world
+	// can't be written to while the server is running, and watched fields
+	// need ED_FieldWritten, so those are left to C
+		Jit_LoadInt (EAX, a);
+		Jit_Byte (0x85);		// test eax, eax
+		Jit_Byte (0xc0);
+		Jit_Byte (0x70 + CC_NE);	// jnz over the exit
+		Jit_Byte (10);
+		Jit_Exit (i);
+		Jit_LoadInt (ECX, b);
+		Jit_Byte (0x81);		// cmp ecx, entityfields
+		Jit_Byte (0xf9);
+		Jit_Long (progs->entityfields);
+		Jit_Byte (0x70 + CC_AE);	// jae past the check
+		skip = jit_p;
+		Jit_Byte (0);
+		Jit_RexW ();			// mov edx, [edi].fieldwatch
+		Jit_Byte (0x8b);
+		Jit_Byte (0x57);
+		Jit_Byte (JIT_OFS(jitstate_t, fieldwatch));
+		Jit_Byte (0x80);		// cmp byte [edx + ecx], 0
+		Jit_Byte (0x3c);
+		Jit_Byte (0x0a);
+		Jit_Byte (0x00);
+		Jit_Byte (0x70 + CC_E);	// jz over the exit
+		Jit_Byte (10);
+		Jit_Exit (i);
+		*skip = jit_p - (skip + 1);
+		Jit_Byte (0x8d);		// lea eax, [eax + ecx*4 + v]
+		Jit_Byte (0x84);
+		Jit_Byte (0x88);
+		Jit_Long (JIT_OFS(edict_t, v));
+		Jit_StoreInt (c, EAX);
+		break;
+
+	case OP_IF:
+	case OP_IFNOT:
+		Jit_Charge (i, f);
+		Jit_Byte (0x83);		// cmp dword a, 0
+		Jit_Global (7, a);
+		Jit_Byte (0x00);
+		Jit_Jump (st->op == OP_IF ? CC_NE : CC_E, i + b);
+		break;
+
+	case OP_GOTO:
+		Jit_Charge (i, f);
+		Jit_Jump (-1, i + a);
+		break;
+
+	case OP_CALL0:
+	case OP_CALL1:
+	case OP_CALL2:
+	case OP_CALL3:
+	case OP_CALL4:
+	case OP_CALL5:
+	case OP_CALL6:
+	case OP_CALL7:
+	case OP_CALL8:
+	case OP_DONE:
+	case OP_RETURN:
+		Jit_Charge (i, f);
+		Jit_Exit (i);
+		break;
+
+	case OP_EQ_S:
+	case OP_NE_S:
+	// interned strings are usually the same string when they are equal,
+	// anything else is compared in C
+		Jit_LoadInt (EAX, a);
+		Jit_Byte (0x3b);		// cmp eax, b
+		Jit_Global (EAX, b);
+		Jit_Byte (0x70 + CC_E);	// je over the exit
+		Jit_Byte (10);
+		Jit_Exit (i);
+		Jit_Byte (0xc7);		// mov dword c, 1.0 or 0
+		Jit_Global (0, c);
+		Jit_Long (st->op == OP_EQ_S ? 0x3f800000 : 0);
+		break;
+
+	default:		// left to PR_ExecuteJit
+		Jit_Exit (i);
+		break;
+	}
+}
+
+/*
+================
+Jit_Function
+
+Compiles the statements from first to end, or returns false if it can't
+================
+*/
+qboolean Jit_Function (dfunction_t *f, int end, byte *limit)
+{
+	dstatement_t	*st;
+	int				i, target;
+	byte			*start, *finish;
+
+	if (limit - jit_p < (end - f->first_statement) * JIT_MAX_STATEMENT)
+		return false;
+
+	for (i=f->first_statement, st=&pr_statements[i] ; i<end ; i++, st++)
+	{
+		if (st->op == OP_IF || st->op == OP_IFNOT)
+			target = i + st->b;
+		else if (st->op == OP_GOTO)
+			target = i + st->a;
+		else
+			continue;
+		if (target < f->first_statement || target >= end)
+			return false;
+	}
+
+	jit_numfixups = 0;
+	for (i=f->first_statement ; i<end ; i++)
+	{
+		start = jit_p;
+		pr_jitcode[i] = jit_p;
+		Jit_Statement (i, f);
+		if (jit_p - start > JIT_MAX_STATEMENT)
+			Sys_Error ("Jit_Function: statement %i compiled too long", i);
+	}
+
+	finish = jit_p;
+	for (i=0 ; i<jit_numfixups ; i++)
+	{
+		start = pr_jitcode[jit_fixups[i].statement];
+		jit_p = jit_fixups[i].at;
+		Jit_Long (start - (jit_fixups[i].at + 4));
+	}
+	jit_p = finish;
+	return true;
+}
+
+/*
+================
+Jit_Entry
+
+The way in from PR_ExecuteJit and the way back out
+================
+*/
+void Jit_Entry (void)
+{
+	pr_jitentry = (int (*) (void))jit_p;
+
+	Jit_Byte (0x50 + EBX);		// push ebx
+	Jit_Byte (0x50 + ESI);
+	Jit_Byte (0x50 + EDI);
+	Jit_Byte (0x55);			// push ebp
+	Jit_LoadPointer (EBX, pr_globals);
+	Jit_LoadPointer (EDI, &pr_jit);
+	Jit_Byte (0x8b);			// mov esi, [edi].runaway
+	Jit_Byte (0x77);
+	Jit_Byte (JIT_OFS(jitstate_t, runaway));
+	Jit_Byte (0xff);			// jmp [edi].target
+	Jit_Byte (0x67);
+	Jit_Byte (JIT_OFS(jitstate_t, target));
+
+	jit_exit = jit_p;
+	Jit_Byte (0x89);			// mov [edi].runaway, esi
+	Jit_Byte (0x77);
+	Jit_Byte (JIT_OFS(jitstate_t, runaway));
+	Jit_Byte (0x5d);			// pop ebp
+	Jit_Byte (0x58 + EDI);
+	Jit_Byte (0x58 + ESI);
+	Jit_Byte (0x58 + EBX);
+	Jit_Byte (0xc3);			// ret
+}
+
+#endif	// JIT_SUPPORTED
+
+/*
+================
+PR_JitProgram
+
+Called by PR_LoadProgs after PR_DecodeProgram
+================
+*/
+void PR_JitProgram (void)
+{
+#ifdef JIT_SUPPORTED
+	dfunction_t	*f;
+	byte		*limit;
+	int			*end;
+	int			i, n, size, compiled;
+	int			first, next;
+
+	if (jit_buffer)
+	{
+		Sys_FreeCode (jit_buffer);
+		jit_buffer = NULL;
+	}
+	pr_jitcode = NULL;
+
+	if (!pr_usejit || !pr_code)
+		return;
+
+	n = progs->numstatements;
+	size = 64 + n * JIT_MAX_STATEMENT;
+	jit_buffer = Sys_AllocCode (size);
+	if (!jit_buffer)
+	{
+		Con_Printf ("Couldn't get memory to compile progs\n");
+		return;
+	}
+	limit = jit_buffer + size;
+
+	pr_jitcode = Hunk_AllocName (n * sizeof(byte *), "progjit");
+	memset (pr_jitcode, 0, n * sizeof(byte *));
+
+// a function runs up to the next one
+	end = Hunk_TempAlloc (n * (sizeof(int) + sizeof(jitfixup_t)));
+	jit_fixups = (jitfixup_t *)(end + n);
+	memset (end, 0, n * sizeof(int));
+	for (i=0, f=pr_functions ; i<progs->numfunctions ; i++, f++)
+		if (f->first_statement > 0 && f->first_statement < n)
+			end[f->first_statement] = 1;
+	for (i=n-1, next=n ; i>=0 ; i--)
+	{
+		first = end[i];
+		end[i] = next;
+		if (first)
+			next = i;
+	}
+
+	jit_p = jit_buffer;
+	Jit_Entry ();
+
+	compiled = 0;
+	for (i=0, f=pr_functions ; i<progs->numfunctions ; i++, f++)
+	{
+		if (f->first_statement <= 0 || f->first_statement >= n)
+			continue;
+		if (pr_jitcode[f->first_statement])
+		{	// two functions sharing code
+			compiled++;
+			continue;
+		}
+		if (Jit_Function (f, end[f->first_statement], limit))
+			compiled++;
+	}
+
+	Con_DPrintf ("Compiled %i of %i progs functions\n", compiled, progs->numfunctions);
+#endif
+}
+
+/*
+================
+PR_ExecuteJit
+
+Runs native code starting after s, until the function that was entered at
+exitdepth returns (-1), or tracing is turned on, in which case it returns
+the statement for the classic loop to go on after
+================
+*/
+int PR_ExecuteJit (int s, int exitdepth, int *runaway)
+{
+	dstatement_t	*st;
+	dfunction_t		*newf;
+	eval_t			*a, *b, *c;
+	edict_t			*ed;
+	int				i, r;
+
+	s++;
+	while (1)
+	{
+		if (!pr_jitcode[s])
+			return PR_ExecuteCode (s - 1, exitdepth, runaway);
+
+		pr_jit.runaway = *runaway;
+		pr_jit.edicts = sv.edicts;
+		pr_jit.fieldwatch = pr_fieldwatch;
+		pr_jit.target = pr_jitcode[s];
+		r = pr_jitentry ();
+		*runaway = pr_jit.runaway;
+
+		s = r & JIT_STATEMENT;
+		pr_xstatement = s;
+		if (r & JIT_RUNAWAY)
+			PR_RunError ("runaway loop error");
+
+		st = &pr_statements[s];
+		a = (eval_t *)&pr_globals[st->a];
+		b = (eval_t *)&pr_globals[st->b];
+		c = (eval_t *)&pr_globals[st->c];
+
+		switch (st->op)
+		{
+		case OP_NOT_V:
+			c->_float = !a->vector[0] && !a->vector[1] && !a->vector[2];
+			break;
+		case OP_NOT_S:
+			c->_float = !a->string || !pr_strings[a->string];
+			break;
+		case OP_EQ_V:
+			c->_float = (a->vector[0] == b->vector[0]) &&
+						(a->vector[1] == b->vector[1]) &&
+						(a->vector[2] == b->vector[2]);
+			break;
+		case OP_EQ_S:
+			c->_float = !strcmp(pr_strings+a->string,pr_strings+b->string);
+			break;
+		case OP_NE_V:
+			c->_float = (a->vector[0] != b->vector[0]) ||
+						(a->vector[1] != b->vector[1]) ||
+						(a->vector[2] != b->vector[2]);
+			break;
+		case OP_NE_S:
+			c->_float = strcmp(pr_strings+a->string,pr_strings+b->string);
+			break;
+
+		case OP_ADDRESS:
+			ed = PROG_TO_EDICT(a->edict);
+			if (ed == (edict_t *)sv.edicts && sv.state == ss_active)
+				PR_RunError ("assignment to world entity");
+			if ((unsigned)b->_int < progs->entityfields && pr_fieldwatch[b->_int])
+				ED_FieldWritten (ed, b->_int);
+			c->_int = (byte *)((int *)&ed->v + b->_int) - (byte *)sv.edicts;
+			break;
+
+		case OP_CALL0:
+		case OP_CALL1:
+		case OP_CALL2:
+		case OP_CALL3:
+		case OP_CALL4:
+		case OP_CALL5:
+		case OP_CALL6:
+		case OP_CALL7:
+		case OP_CALL8:
+			pr_argc = st->op - OP_CALL0;
+			if (!a->function)
+				PR_RunError ("NULL function");
+
+			newf = &pr_functions[a->function];
+
+			if (newf->first_statement < 0)
+			{	// negative statements are built in functions
+				i = -newf->first_statement;
+				if (i >= pr_numbuiltins)
+					PR_RunError ("Bad builtin call number");
+				if (pr_profiling)
+				{
+					PR_ProfileEnter (newf);
+					pr_builtins[i] ();
+					PR_ProfileLeave ();
+				}
+				else
+					pr_builtins[i] ();
+				if (pr_trace)
+					return s;	// traceon, so the classic loop takes over
+				break;
+			}
+
+			i = PR_EnterFunction (newf);
+			if (pr_jitcode[i+1])
+			{
+				s = i;
+				break;
+			}
+
+		// run it in the decoded loop, and come back here when it returns
+			i = PR_ExecuteCode (i, pr_depth - 1, runaway);
+			if (i != -1)
+				return i;
+			break;
+
+		case OP_DONE:
+		case OP_RETURN:
+			pr_globals[OFS_RETURN] = pr_globals[st->a];
+			pr_globals[OFS_RETURN+1] = pr_globals[st->a+1];
+			pr_globals[OFS_RETURN+2] = pr_globals[st->a+2];
+
+			s = PR_LeaveFunction ();
+			if (pr_depth == exitdepth)
+				return -1;		// all done
+			break;
+
+		case OP_STATE:
+			ed = PROG_TO_EDICT(pr_global_struct->self);
+#ifdef FPS_20
+			ed->v.nextthink = pr_global_struct->time + 0.05;
+#else
+			ed->v.nextthink = pr_global_struct->time + 0.1;
+#endif
+			if (a->_float != ed->v.frame)
+			{
+				ed->v.frame = a->_float;
+			}
+			ed->v.think = b->function;
+			break;
+
+		default:
+			PR_RunError ("Bad opcode %i", st->op);
+		}
+
+		s++;
+	}
+}
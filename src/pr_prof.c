@@ -0,0 +1,480 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pr_prof.c -- statement counts and call timing for progs
+
+#include "quakedef.h"
+
+/*
+
+Between "profile start" and "profile stop", every progs function and every
+builtin is timed on the way in and on the way out.  Builtins are functions
+too, with a negative first statement, so both are numbered by their place in
+pr_functions.
+
+Each distinct call stack gets a node in a tree, holding the calls made with
+that stack and the time spent in them outside of any further calls.  That is
+what "profile stacks" writes, one line per node, in the collapsed format that
+flame graph tools read.  Totals for each function are kept alongside; a
+function that recurses only has its outermost call counted in its inclusive
+time.
+
+The timings survive a map change as long as the same progs are loaded.
+
+*/
+
+#define	MAX_PROFNODES	32768
+#define	PROFNODE_HASH	65536		// power of two, larger than MAX_PROFNODES
+#define	MAX_PROFDEPTH	128
+
+typedef struct
+{
+	int			func;		// in pr_functions, -1 for the root
+	int			parent;
+	int			calls;
+	double		self;
+} profnode_t;
+
+typedef struct
+{
+	int			calls;
+	int			active;		// calls of it on the stack now
+	double		inclusive;
+	double		exclusive;
+} proftotal_t;
+
+typedef struct
+{
+	int			node;
+	int			func;
+	double		start;
+	double		children;	// time spent in the calls it made
+} profframe_t;
+
+qboolean	pr_profiling;
+
+profnode_t	prof_nodes[MAX_PROFNODES];
+int			prof_numnodes;
+int			prof_hash[PROFNODE_HASH];	// node for a parent and function, -1 if none
+
+proftotal_t	*prof_totals;
+int			prof_numfunctions;
+unsigned short	prof_crc;
+
+profframe_t	prof_stack[MAX_PROFDEPTH];
+int			prof_depth;
+int			prof_lost;			// calls that didn't fit on prof_stack
+
+double		prof_started;
+double		prof_elapsed;		// from earlier starts and stops
+
+/*
+============
+PR_ProfileClear
+============
+*/
+void PR_ProfileClear (void)
+{
+	int		i;
+
+	for (i=0 ; i<PROFNODE_HASH ; i++)
+		prof_hash[i] = -1;
+	prof_nodes[0].func = -1;
+	prof_nodes[0].parent = -1;
+	prof_nodes[0].calls = 0;
+	prof_nodes[0].self = 0;
+	prof_numnodes = 1;
+
+	if (prof_totals)
+		free (prof_totals);
+	prof_totals = calloc (progs->numfunctions, sizeof(proftotal_t));
+	if (!prof_totals)
+		Sys_Error ("PR_ProfileClear: couldn't allocate %i functions", progs->numfunctions);
+	prof_numfunctions = progs->numfunctions;
+	prof_crc = pr_crc;
+
+	prof_depth = 0;
+	prof_lost = 0;
+	prof_elapsed = 0;
+	prof_started = Sys_FloatTime ();
+}
+
+/*
+============
+PR_ProfileLoad
+
+Called by PR_LoadProgs.  Timings for a different progs don't mean anything.
+============
+*/
+void PR_ProfileLoad (void)
+{
+	if (!prof_totals)
+		return;
+	if (prof_numfunctions == progs->numfunctions && prof_crc == pr_crc)
+		return;
+
+	if (pr_profiling)
+		Con_Printf ("progs changed, profile cleared\n");
+	PR_ProfileClear ();
+}
+
+/*
+============
+PR_ProfileNode
+
+The node under parent for func, made if it isn't there yet
+============
+*/
+int PR_ProfileNode (int parent, int func)
+{
+	int			h, n;
+	profnode_t	*node;
+
+	h = (parent * 31 + func * 1031) & (PROFNODE_HASH-1);
+	while ((n = prof_hash[h]) != -1)
+	{
+		if (prof_nodes[n].parent == parent && prof_nodes[n].func == func)
+			return n;
+		h = (h + 1) & (PROFNODE_HASH-1);
+	}
+
+	if (prof_numnodes == MAX_PROFNODES)
+		return parent;		// charge it to the caller
+
+	n = prof_numnodes++;
+	node = &prof_nodes[n];
+	node->func = func;
+	node->parent = parent;
+	node->calls = 0;
+	node->self = 0;
+	prof_hash[h] = n;
+
+	return n;
+}
+
+/*
+============
+PR_ProfileUnwind
+
+Drops any calls still on the stack
+============
+*/
+void PR_ProfileUnwind (void)
+{
+	while (prof_depth)
+		prof_totals[prof_stack[--prof_depth].func].active--;
+	prof_lost = 0;
+}
+
+/*
+============
+PR_ProfileEnter
+
+Called as f is entered, by PR_EnterFunction for progs functions and before
+the call for builtins
+============
+*/
+void PR_ProfileEnter (dfunction_t *f)
+{
+	profframe_t	*frame;
+	int			func, parent;
+
+	if (!pr_depth)
+		PR_ProfileUnwind ();	// anything left was cut off by an error
+
+	if (prof_depth == MAX_PROFDEPTH)
+	{
+		prof_lost++;
+		return;
+	}
+
+	func = f - pr_functions;
+	parent = prof_depth ? prof_stack[prof_depth-1].node : 0;
+
+	frame = &prof_stack[prof_depth++];
+	frame->node = PR_ProfileNode (parent, func);
+	frame->func = func;
+	frame->children = 0;
+
+	prof_nodes[frame->node].calls++;
+	prof_totals[func].calls++;
+	prof_totals[func].active++;
+
+	frame->start = Sys_FloatTime ();
+}
+
+/*
+============
+PR_ProfileLeave
+
+Called by PR_LeaveFunction, and after a builtin returns
+============
+*/
+void PR_ProfileLeave (void)
+{
+	profframe_t	*frame;
+	proftotal_t	*total;
+	double		time, self;
+
+	if (prof_lost)
+	{
+		prof_lost--;
+		return;
+	}
+	if (!prof_depth)
+		return;		// started inside a call
+
+	frame = &prof_stack[--prof_depth];
+	time = Sys_FloatTime () - frame->start;
+	self = time - frame->children;
+
+	prof_nodes[frame->node].self += self;
+
+	total = &prof_totals[frame->func];
+	total->exclusive += self;
+	if (!--total->active)
+		total->inclusive += time;
+
+	if (prof_depth)
+		prof_stack[prof_depth-1].children += time;
+}
+
+/*
+============
+PR_ProfileStart
+============
+*/
+void PR_ProfileStart (void)
+{
+	if (!prof_totals)
+		PR_ProfileClear ();
+	if (pr_profiling)
+		return;
+
+	PR_ProfileUnwind ();
+	prof_started = Sys_FloatTime ();
+	pr_profiling = true;
+}
+
+/*
+============
+PR_ProfileStop
+============
+*/
+void PR_ProfileStop (void)
+{
+	if (!pr_profiling)
+		return;
+
+	prof_elapsed += Sys_FloatTime () - prof_started;
+	pr_profiling = false;
+}
+
+/*
+============
+PR_CompareTotals
+============
+*/
+int PR_CompareTotals (const void *a, const void *b)
+{
+	proftotal_t	*ta, *tb;
+
+	ta = &prof_totals[*(int *)a];
+	tb = &prof_totals[*(int *)b];
+	if (ta->exclusive > tb->exclusive)
+		return -1;
+	if (ta->exclusive < tb->exclusive)
+		return 1;
+	return 0;
+}
+
+/*
+============
+PR_CompareCounts
+============
+*/
+int PR_CompareCounts (const void *a, const void *b)
+{
+	return pr_functions[*(int *)b].profile - pr_functions[*(int *)a].profile;
+}
+
+/*
+============
+PR_ProfileReport
+
+Functions and builtins by the time spent in them
+============
+*/
+void PR_ProfileReport (int count)
+{
+	proftotal_t	*total;
+	dfunction_t	*f;
+	int			*order;
+	int			i, num;
+	double		elapsed;
+
+	if (!prof_totals)
+	{
+		Con_Printf ("no timings, use \"profile start\"\n");
+		return;
+	}
+
+	order = malloc (prof_numfunctions * sizeof(int));
+	if (!order)
+		return;
+	num = 0;
+	for (i=0 ; i<prof_numfunctions ; i++)
+		if (prof_totals[i].calls)
+			order[num++] = i;
+	qsort (order, num, sizeof(int), PR_CompareTotals);
+
+	elapsed = prof_elapsed;
+	if (pr_profiling)
+		elapsed += Sys_FloatTime () - prof_started;
+	Con_Printf ("%.1f seconds profiled, %i call stacks\n", elapsed, prof_numnodes - 1);
+
+	Con_Printf ("    calls   incl ms   excl ms statements name\n");
+	for (i=0 ; i<num && i<count ; i++)
+	{
+		total = &prof_totals[order[i]];
+		f = &pr_functions[order[i]];
+		Con_Printf ("%9i %9.1f %9.1f %10i %s%s\n", total->calls,
+			total->inclusive * 1000, total->exclusive * 1000,
+			f->profile, f->first_statement < 0 ? "#" : "",
+			pr_strings + f->s_name);
+	}
+
+	free (order);
+}
+
+/*
+============
+PR_ProfileStacks
+
+Writes a line for each call stack, the functions from the outermost in
+separated by ;, then the microseconds spent in the last one
+============
+*/
+void PR_ProfileStacks (char *name)
+{
+	FILE		*f;
+	char		path[MAX_OSPATH];
+	int			chain[MAX_PROFDEPTH];
+	dfunction_t	*func;
+	int			i, j, n, depth;
+
+	if (!prof_totals)
+	{
+		Con_Printf ("no timings, use \"profile start\"\n");
+		return;
+	}
+
+	sprintf (path, "%s/%s", com_gamedir, name);
+	f = fopen (path, "w");
+	if (!f)
+	{
+		Con_Printf ("Couldn't write %s\n", path);
+		return;
+	}
+	COM_AddCachedFile (path);
+
+	for (i=1 ; i<prof_numnodes ; i++)
+	{
+		if (prof_nodes[i].self < 0.0000005)
+			continue;
+
+		depth = 0;
+		for (n=i ; n>0 && depth<MAX_PROFDEPTH ; n=prof_nodes[n].parent)
+			chain[depth++] = n;
+
+		for (j=depth-1 ; j>=0 ; j--)
+		{
+			func = &pr_functions[prof_nodes[chain[j]].func];
+			fprintf (f, "%s%s%s", func->first_statement < 0 ? "#" : "",
+				pr_strings + func->s_name, j ? ";" : " ");
+		}
+		fprintf (f, "%.0f\n", prof_nodes[i].self * 1000000);
+	}
+
+	fclose (f);
+	Con_Printf ("Wrote %s\n", path);
+}
+
+/*
+============
+PR_Profile_f
+
+profile [start | stop | clear | report [count] | stacks [file]]
+
+On its own, lists the functions that ran the most statements.  Builtins
+are marked with a #.
+============
+*/
+void PR_Profile_f (void)
+{
+	dfunction_t	*f;
+	char		*cmd;
+	int			*order;
+	int			num;
+	int			i;
+
+	if (!sv.active)
+		return;
+
+	if (Cmd_Argc () >= 2)
+	{
+		cmd = Cmd_Argv (1);
+		if (!Q_strcasecmp (cmd, "start"))
+			PR_ProfileStart ();
+		else if (!Q_strcasecmp (cmd, "stop"))
+			PR_ProfileStop ();
+		else if (!Q_strcasecmp (cmd, "clear"))
+		{
+			for (i=0 ; i<progs->numfunctions ; i++)
+				pr_functions[i].profile = 0;
+			if (prof_totals)
+				PR_ProfileClear ();
+		}
+		else if (!Q_strcasecmp (cmd, "report"))
+			PR_ProfileReport (Cmd_Argc () > 2 ? Q_atoi (Cmd_Argv (2)) : 20);
+		else if (!Q_strcasecmp (cmd, "stacks"))
+			PR_ProfileStacks (Cmd_Argc () > 2 ? Cmd_Argv (2) : "profile.txt");
+		else
+			Con_Printf ("profile [start | stop | clear | report [count] | stacks [file]]\n");
+		return;
+	}
+
+// the functions that ran the most statements, without clearing the counts
+	order = malloc (progs->numfunctions * sizeof(int));
+	if (!order)
+		return;
+	num = 0;
+	for (i=0 ; i<progs->numfunctions ; i++)
+		if (pr_functions[i].profile > 0)
+			order[num++] = i;
+	qsort (order, num, sizeof(int), PR_CompareCounts);
+
+	for (i=0 ; i<num && i<10 ; i++)
+	{
+		f = &pr_functions[order[i]];
+		Con_Printf ("%7i %s\n", f->profile, pr_strings+f->s_name);
+	}
+
+	free (order);
+}
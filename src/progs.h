@@ -31,14 +31,21 @@ typedef union eval_s
 	int				edict;
 } eval_t;	
 
-#define	MAX_ENT_LEAFS	16
+#define	ENT_LEAFBYTES	16
 typedef struct edict_s
 {
 	qboolean	free;
 	link_t		area;				// linked to a division node or leaf
+	int			moved;				// place on the moved list + 1, see SV_EdictMoved
 	
-	int			num_leafs;
-	short		leafnums[MAX_ENT_LEAFS];
+// the PVS leafs touched, as the bytes of a leaf bitset, see SV_LinkLeafs
+	vec3_t		leafmins, leafmaxs;	// absmin and absmax they were found for
+	float		leafslack;			// how far those can move without crossing a plane
+	int			numleafbytes;		// -1 for in every leaf
+	int			leafrow;			// in sv_leafrows + 1, for more bytes than fit here
+	int			firstleafbyte;		// of the ones in the row
+	short		leafbyte[ENT_LEAFBYTES];
+	byte		leafbits[ENT_LEAFBYTES];
 
 	entity_state_t	baseline;
 	
@@ -61,6 +68,12 @@ extern	float			*pr_globals;			// same as pr_global_struct
 
 extern	int				pr_edict_size;	// in bytes
 
+#define	FW_MOVED		1		// origin, size or solid, see SV_EdictMoved
+#define	FW_FIND			2		// searched by find, see ED_FindString
+#define	FW_TRACE		4		// read by traces, see SV_TraceChanged
+
+extern	byte			*pr_fieldwatch;	// FW_* flags for each entity field
+
 //============================================================================
 
 void PR_Init (void);
@@ -68,7 +81,46 @@ void PR_Init (void);
 void PR_ExecuteProgram (func_t fnum);
 void PR_LoadProgs (void);
 
+qboolean PR_IsTempString (char *s);
+
+// a statement as decoded by PR_DecodeProgram
+typedef struct
+{
+	int			op;			// OP_* or PRX_*
+	eval_t		*a, *b, *c;
+	int			jump;		// statement a branch goes to
+	int			cost;		// statements charged when a branch, call or return runs
+} prcode_t;
+
+extern	prcode_t	*pr_code;		// one per statement, NULL when not decoding
+extern	qboolean	pr_nodecode;	// -noprogdecode, always use the classic loop
+
+void PR_DecodeProgram (void);
+int PR_ExecuteCode (int s, int exitdepth, int *runaway);
+int PR_EnterFunction (dfunction_t *f);
+int PR_LeaveFunction (void);
+
+extern	byte		**pr_jitcode;	// native code for each statement, NULL if not compiled
+extern	qboolean	pr_usejit;		// -progjit
+
+void PR_JitProgram (void);
+int PR_ExecuteJit (int s, int exitdepth, int *runaway);
+
 void PR_Profile_f (void);
+void PR_Bench_f (void);
+void PR_BenchAbort (void);
+
+extern	qboolean	pr_benchmarking;	// timing calls from the engine, see pr_bench.c
+extern	qboolean	pr_opclock;		// reading the clock at each classic loop statement
+
+void PR_BenchProgram (func_t fnum);
+void PR_ClockStatement (int op);
+
+extern	qboolean	pr_profiling;	// timing calls, see pr_prof.c
+
+void PR_ProfileLoad (void);
+void PR_ProfileEnter (dfunction_t *f);
+void PR_ProfileLeave (void);
 
 edict_t *ED_Alloc (void);
 void ED_Free (edict_t *ed);
@@ -85,6 +137,12 @@ void ED_ParseGlobals (char *data);
 
 void ED_LoadFromFile (char *data);
 
+void ED_WatchField (char *name, int flag);
+void ED_UnwatchField (char *name, int flag);
+void ED_FieldWritten (edict_t *ed, int ofs);
+edict_t *ED_FindString (int start, int field, char *s);
+void ED_StringsChanged (void);
+
 //define EDICT_NUM(n) ((edict_t *)(sv.edicts+ (n)*pr_edict_size))
 //define NUM_FOR_EDICT(e) (((byte *)(e) - sv.edicts)/pr_edict_size)
 
@@ -122,6 +180,7 @@ extern int		pr_argc;
 extern	qboolean	pr_trace;
 extern	dfunction_t	*pr_xfunction;
 extern	int			pr_xstatement;
+extern	int			pr_depth;
 
 extern	unsigned short		pr_crc;
 
@@ -61,6 +61,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define	SND_VOLUME		(1<<0)		// a byte
 #define	SND_ATTENUATION	(1<<1)		// a byte
 #define	SND_LOOPING		(1<<2)		// a long
+#define	SND_LARGEENTITY	(1<<3)		// entity a short, channel a byte
+
+// sounds from entities below this pack the entity and channel in a short
+#define	SND_MAXENTITY	4096
 
 
 // defaults for clientinfo messages
@@ -32,6 +32,11 @@ typedef struct
 
 typedef enum {ss_loading, ss_active} server_state_t;
 
+// the signon goes out in as many reliable messages as it takes
+#define	MAX_SIGNON_MSGS		256				// MAX_EDICTS_LIMIT baselines take about 80
+#define	SIGNON_SIZE			(MAX_MSGLEN-2)	// room for the svc_signonnum after the last
+#define	SIGNON_SPLIT		(SIGNON_SIZE-1024)	// the rest is for progs writes to MSG_INIT
+
 typedef struct
 {
 	qboolean	active;				// false if only a net client
@@ -55,10 +60,13 @@ typedef struct
 	char		*sound_precache[MAX_SOUNDS];	// NULL terminated
 	char		*lightstyles[MAX_LIGHTSTYLES];
 	int			num_edicts;
-	int			max_edicts;
+	int			max_edicts;			// room made so far, see SV_GrowEdicts
+	int			edict_limit;		// max_edicts can grow to this
 	edict_t		*edicts;			// can NOT be array indexed, because
 									// edict_t is variable sized, but can
 									// be used to reference the world ent
+	edict_t		**push_edicts;		// edict_limit long, for SV_PushMove
+	vec3_t		*push_from;
 	server_state_t	state;			// some actions are only valid during load
 
 	sizebuf_t	datagram;
@@ -67,8 +75,9 @@ typedef struct
 	sizebuf_t	reliable_datagram;	// copied to all clients at end of frame
 	byte		reliable_datagram_buf[MAX_DATAGRAM];
 
-	sizebuf_t	signon;
-	byte		signon_buf[8192];
+	sizebuf_t	*signon;			// the last of signon_msgs, see SV_ReserveSignon
+	sizebuf_t	signon_msgs[MAX_SIGNON_MSGS];
+	int			num_signon_msgs;
 } server_t;
 
 
@@ -82,6 +91,8 @@ typedef struct client_s
 	qboolean		dropasap;			// has been told to go to another level
 	qboolean		privileged;			// can execute any host command
 	qboolean		sendsignon;			// only valid before spawned
+	qboolean		prespawning;		// still sending the signon, see SV_SendSignon
+	int				signonsent;			// of sv.signon_msgs
 
 	double			last_message;		// reliable messages must be sent
 										// periodically
@@ -247,6 +258,14 @@ void SV_WriteClientdataToMessage (edict_t *ent, sizebuf_t *msg);
 
 void SV_MoveToGoal (void);
 
+void SV_GrowEdicts (int count);
+
+void SV_ReserveSignon (int size);
+void SV_SendSignon (client_t *client);
+
+void SV_TraceBench_f (void);
+void SV_TraceBenchAbort (void);
+
 void SV_CheckForNewClients (void);
 void SV_RunClients (void);
 void SV_SaveSpawnparms ();
@@ -297,6 +297,7 @@ sfx_t *S_FindName (char *name)
 	
 	sfx = &known_sfx[i];
 	strcpy (sfx->name, name);
+	sfx->cache.owner = CACHE_SOUND;
 
 	num_sfx++;
 	
@@ -321,6 +322,27 @@ void S_TouchSound (char *name)
 	Cache_Check (&sfx->cache);
 }
 
+/*
+==================
+S_PrefetchSound
+
+Lets the file system start on a sound that S_PrecacheSound will load
+==================
+*/
+void S_PrefetchSound (char *name)
+{
+	sfx_t	*sfx;
+
+	if (!sound_started || nosound.value || !precache.value)
+		return;
+
+	sfx = S_FindName (name);
+	if (Cache_Check (&sfx->cache))
+		return;
+
+	COM_PrefetchFile (va("sound/%s", name));
+}
+
 /*
 ==================
 S_PrecacheSound
@@ -103,6 +103,7 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	float	stepscale;
 	sfxcache_t	*sc;
 	byte	stackbuf[1*1024];		// avoid dirtying the cache heap
+	qboolean	mapped;
 
 // see if still in memory
 	sc = Cache_Check (&s->cache);
@@ -116,18 +117,21 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 
 //	Con_Printf ("loading %s\n",namebuffer);
 
-	data = COM_LoadStackFile(namebuffer, stackbuf, sizeof(stackbuf));
+	data = COM_MapStackFile(namebuffer, stackbuf, sizeof(stackbuf));
 
 	if (!data)
 	{
 		Con_Printf ("Couldn't load %s\n", namebuffer);
 		return NULL;
 	}
+	mapped = com_filemapped;
 
 	info = GetWavinfo (s->name, data, com_filesize);
 	if (info.channels != 1)
 	{
 		Con_Printf ("%s is a stereo sample\n",s->name);
+		if (mapped)
+			COM_UnmapFile (data);
 		return NULL;
 	}
 
@@ -138,7 +142,11 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 
 	sc = Cache_Alloc ( &s->cache, len + sizeof(sfxcache_t), s->name);
 	if (!sc)
+	{
+		if (mapped)
+			COM_UnmapFile (data);
 		return NULL;
+	}
 	
 	sc->length = info.samples;
 	sc->loopstart = info.loopstart;
@@ -148,6 +156,9 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 
 	ResampleSfx (s, sc->speed, sc->width, data + info.dataofs);
 
+	if (mapped)
+		COM_UnmapFile (data);
+
 	return sc;
 }
 
@@ -0,0 +1,428 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sv_bench.c -- trace speed on a map, with no one connected
+
+#include "quakedef.h"
+
+/*
+
+"tracebench <map> [traces] [edicts]" spawns the map with no client, so it
+works the same on a dedicated server.  It runs a few seconds of server frames
+to record the traces the game itself makes, then adds boxes in open
+space and times:
+
+world		the world hull alone, the part SV_RecursiveHullCheck does
+move		SV_Move, the world and the entities near the move
+batch		the same moves through SV_MoveBatch, 64 at a time
+recorded	the traces the frames made, played back with SV_Move
+
+each with a point, the player hull and the large hull, from the same table of
+random moves.  Everything starts from the same random seed, so the checksums
+of the traces only change when what the traces return does.  Batched moves
+have to come out the same as SV_Move's.
+
+It all runs once with the area nodes and once with the bvh.
+
+*/
+
+#define	BENCH_MOVES		4096		// random moves, used over and over
+#define	BENCH_BATCH		64
+#define	BENCH_FRAMES	100			// recorded at 10 a second
+#define	MAX_RECORDED	65536
+
+typedef struct
+{
+	vec3_t		start, mins, maxs, end;
+	int			type;
+	int			passedict;		// -1 for none
+} recordedtrace_t;
+
+typedef struct
+{
+	char		*name;
+	vec3_t		mins, maxs;
+} benchhull_t;
+
+static benchhull_t	benchhulls[3] =
+{
+	{"point",	{0, 0, 0},			{0, 0, 0}},
+	{"player",	{-16, -16, -24},	{16, 16, 32}},
+	{"large",	{-32, -32, -24},	{32, 32, 64}}
+};
+
+extern	cvar_t	sv_bvh;
+
+qboolean		sv_tracerecording;
+
+recordedtrace_t	*bench_recorded;
+int				bench_numrecorded;
+
+movetrace_t		*bench_moves;		// BENCH_MOVES long
+
+qboolean		bench_tracing;		// what tracebench changed, for SV_TraceBenchAbort
+char			bench_bvh[32];		// sv_bvh as it was
+double			bench_oldframetime;
+
+/*
+============
+SV_RecordTrace
+
+Called by SV_Move and SV_MoveBatch while sv_tracerecording is set
+============
+*/
+void SV_RecordTrace (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict)
+{
+	recordedtrace_t	*rec;
+
+	if (bench_numrecorded == MAX_RECORDED)
+		return;
+	rec = &bench_recorded[bench_numrecorded++];
+	VectorCopy (start, rec->start);
+	VectorCopy (mins, rec->mins);
+	VectorCopy (maxs, rec->maxs);
+	VectorCopy (end, rec->end);
+	rec->type = type;
+	rec->passedict = passedict ? NUM_FOR_EDICT(passedict) : -1;
+}
+
+/*
+============
+SV_TraceBenchAbort
+
+Called by Host_Error, in case an error left a run unfinished
+============
+*/
+void SV_TraceBenchAbort (void)
+{
+	if (!bench_tracing)
+		return;
+
+	sv_tracerecording = false;
+	Cvar_Set ("sv_bvh", bench_bvh);
+	host_frametime = bench_oldframetime;
+
+	free (bench_recorded);
+	free (bench_moves);
+	bench_recorded = NULL;
+	bench_moves = NULL;
+	bench_tracing = false;
+}
+
+/*
+============
+SV_BenchHash
+
+Adds what a trace came back with to hash
+============
+*/
+unsigned SV_BenchHash (unsigned hash, trace_t *trace)
+{
+	int		v[13];
+	byte	*b;
+	int		i;
+
+	v[0] = trace->allsolid;
+	v[1] = trace->startsolid;
+	v[2] = trace->inopen;
+	v[3] = trace->inwater;
+	memcpy (v+4, &trace->fraction, 4);
+	memcpy (v+5, trace->endpos, 12);
+	memcpy (v+8, trace->plane.normal, 12);
+	memcpy (v+11, &trace->plane.dist, 4);
+	v[12] = trace->ent ? NUM_FOR_EDICT(trace->ent) : -1;
+
+	b = (byte *)v;
+	for (i=0 ; i<(int)sizeof(v) ; i++)
+		hash = (hash ^ b[i]) * 16777619;
+
+	return hash;
+}
+
+/*
+============
+SV_BenchFloat
+============
+*/
+float SV_BenchFloat (float low, float high)
+{
+	return low + (high - low) * (rand () & 32767) / 32767.0;
+}
+
+/*
+============
+SV_BenchOpenPoint
+
+A random point in the world that isn't in solid.  Gives up after a while,
+as the bounds of a map can be mostly solid.
+============
+*/
+void SV_BenchOpenPoint (vec3_t p)
+{
+	int		i, tries;
+
+	for (tries=0 ; tries<1000 ; tries++)
+	{
+		for (i=0 ; i<3 ; i++)
+			p[i] = SV_BenchFloat (sv.worldmodel->mins[i], sv.worldmodel->maxs[i]);
+		if (SV_PointContents (p) != CONTENTS_SOLID)
+			return;
+	}
+}
+
+/*
+============
+SV_BenchSetup
+
+Records BENCH_FRAMES of the game, then adds edicts as boxes and makes the
+random moves
+============
+*/
+void SV_BenchSetup (int edicts)
+{
+	edict_t	*ent;
+	vec3_t	dir;
+	float	size;
+	int		i, j;
+
+	srand (0);
+
+// the traces the game makes
+	bench_numrecorded = 0;
+	host_frametime = 0.1;
+	sv_tracerecording = true;
+	for (i=0 ; i<BENCH_FRAMES ; i++)
+	{
+		SV_Physics ();
+
+	// no one to send them to
+		SZ_Clear (&sv.datagram);
+		SZ_Clear (&sv.reliable_datagram);
+	}
+	sv_tracerecording = false;
+	host_frametime = bench_oldframetime;
+
+// things to run into, leaving room for the progs
+	if (edicts > sv.edict_limit - sv.num_edicts - 64)
+		edicts = sv.edict_limit - sv.num_edicts - 64;
+	for (i=0 ; i<edicts ; i++)
+	{
+		ent = ED_Alloc ();
+		SV_BenchOpenPoint (ent->v.origin);
+		size = SV_BenchFloat (8, 64);
+		for (j=0 ; j<3 ; j++)
+		{
+			ent->v.mins[j] = -size * 0.5;
+			ent->v.maxs[j] = size * 0.5;
+		}
+		VectorSubtract (ent->v.maxs, ent->v.mins, ent->v.size);
+		ent->v.solid = (i & 1) ? SOLID_SLIDEBOX : SOLID_BBOX;
+		if (i % 3 == 0)
+			ent->v.flags = FL_MONSTER;
+		ent->v.movetype = MOVETYPE_NONE;
+		SV_LinkEdict (ent, false);
+	}
+
+// moves of up to 1024 units from open space
+	for (i=0 ; i<BENCH_MOVES ; i++)
+	{
+		SV_BenchOpenPoint (bench_moves[i].start);
+		for (j=0 ; j<3 ; j++)
+			dir[j] = SV_BenchFloat (-1, 1);
+		VectorNormalize (dir);
+		VectorMA (bench_moves[i].start, SV_BenchFloat (0, 1024), dir, bench_moves[i].end);
+	}
+}
+
+/*
+============
+SV_BenchRow
+============
+*/
+void SV_BenchRow (char *kind, char *hull, int count, double time, unsigned hash)
+{
+	Con_Printf ("%-9s %-7s %9i %11.1f   %08x\n", kind, hull, count,
+		time > 0 ? count / time / 1000 : 0, hash);
+}
+
+/*
+============
+SV_BenchRun
+
+Spawns map and times everything with the area structure it picks.  Returns
+false if the map didn't load.
+============
+*/
+qboolean SV_BenchRun (char *map, int traces, int edicts)
+{
+	movetrace_t		*move;
+	recordedtrace_t	*rec;
+	benchhull_t		*hull;
+	trace_t			trace;
+	double			start, time;
+	unsigned		hash, movehash;
+	int				h, i, j, n;
+
+#ifdef QUAKE2
+	SV_SpawnServer (map, NULL);
+#else
+	SV_SpawnServer (map);
+#endif
+	if (!sv.active)
+		return false;
+
+	SV_BenchSetup (edicts);
+
+	Con_Printf ("kind      hull       traces  ktraces/s   checksum\n");
+	for (h=0 ; h<3 ; h++)
+	{
+		hull = &benchhulls[h];
+		for (i=0 ; i<BENCH_MOVES ; i++)
+		{
+			VectorCopy (hull->mins, bench_moves[i].mins);
+			VectorCopy (hull->maxs, bench_moves[i].maxs);
+		}
+
+	// the world hull alone
+		hash = 2166136261u;
+		start = Sys_FloatTime ();
+		for (i=0 ; i<traces ; i++)
+		{
+			move = &bench_moves[i & (BENCH_MOVES-1)];
+			trace = SV_ClipMoveToEntity (sv.edicts, move->start, move->mins, move->maxs, move->end, false);
+			hash = SV_BenchHash (hash, &trace);
+		}
+		SV_BenchRow ("world", hull->name, traces, Sys_FloatTime () - start, hash);
+
+	// with the entities
+		hash = 2166136261u;
+		start = Sys_FloatTime ();
+		for (i=0 ; i<traces ; i++)
+		{
+			move = &bench_moves[i & (BENCH_MOVES-1)];
+			trace = SV_Move (move->start, move->mins, move->maxs, move->end, MOVE_NORMAL, NULL);
+			hash = SV_BenchHash (hash, &trace);
+		}
+		SV_BenchRow ("move", hull->name, traces, Sys_FloatTime () - start, hash);
+		movehash = hash;
+
+	// batched
+		hash = 2166136261u;
+		time = 0;
+		for (i=0 ; i<traces ; i+=n)
+		{
+			j = i & (BENCH_MOVES-1);
+			n = BENCH_MOVES - j;
+			if (n > BENCH_BATCH)
+				n = BENCH_BATCH;
+			if (n > traces - i)
+				n = traces - i;
+
+			start = Sys_FloatTime ();
+			SV_MoveBatch (bench_moves + j, n, MOVE_NORMAL, NULL);
+			time += Sys_FloatTime () - start;
+
+			for (j=0 ; j<n ; j++)
+				hash = SV_BenchHash (hash, &bench_moves[(i + j) & (BENCH_MOVES-1)].trace);
+		}
+		SV_BenchRow ("batch", hull->name, traces, time, hash);
+		if (hash != movehash)
+			Con_Printf ("batched traces came out differently!\n");
+	}
+
+	if (bench_numrecorded)
+	{
+		hash = 2166136261u;
+		start = Sys_FloatTime ();
+		for (i=0 ; i<traces ; i++)
+		{
+			rec = &bench_recorded[i % bench_numrecorded];
+			trace = SV_Move (rec->start, rec->mins, rec->maxs, rec->end, rec->type,
+				rec->passedict < 0 ? NULL : EDICT_NUM(rec->passedict));
+			hash = SV_BenchHash (hash, &trace);
+		}
+		SV_BenchRow ("recorded", "-", traces, Sys_FloatTime () - start, hash);
+	}
+
+	return true;
+}
+
+/*
+============
+SV_TraceBench_f
+
+tracebench <map> [traces] [edicts]
+============
+*/
+void SV_TraceBench_f (void)
+{
+	char	map[MAX_QPATH];
+	int		traces, edicts, bvh;
+
+	if (Cmd_Argc () < 2)
+	{
+		Con_Printf ("tracebench <map> [traces] [edicts]\n");
+		return;
+	}
+	if (cmd_source != src_command)
+		return;
+
+	Q_strncpy (map, Cmd_Argv (1), sizeof(map)-1);
+	map[sizeof(map)-1] = 0;
+	traces = Cmd_Argc () > 2 ? Q_atoi (Cmd_Argv (2)) : 1000000;
+	if (traces < 1)
+		traces = 1;
+	edicts = Cmd_Argc () > 3 ? Q_atoi (Cmd_Argv (3)) : 500;
+	if (edicts < 0)
+		edicts = 0;
+
+	bench_recorded = malloc (MAX_RECORDED * sizeof(recordedtrace_t));
+	bench_moves = malloc (BENCH_MOVES * sizeof(movetrace_t));
+	if (!bench_recorded || !bench_moves)
+	{
+		free (bench_recorded);
+		free (bench_moves);
+		bench_recorded = NULL;
+		bench_moves = NULL;
+		Con_Printf ("Couldn't allocate the traces\n");
+		return;
+	}
+
+	CL_Disconnect ();
+	Host_ShutdownServer (false);
+	svs.serverflags = 0;
+
+	Q_strncpy (bench_bvh, sv_bvh.string, sizeof(bench_bvh)-1);
+	bench_bvh[sizeof(bench_bvh)-1] = 0;
+	bench_oldframetime = host_frametime;
+	bench_tracing = true;
+	for (bvh=0 ; bvh<2 ; bvh++)
+	{
+		Cvar_SetValue ("sv_bvh", bvh);
+		Con_Printf ("%s with %s, %i edicts added\n", map,
+			bvh ? "the bvh" : "area nodes", edicts);
+		if (!SV_BenchRun (map, traces, edicts))
+		{
+			Con_Printf ("Couldn't spawn %s\n", map);
+			break;
+		}
+		Con_Printf ("(%i traces recorded in %i frames)\n", bench_numrecorded, BENCH_FRAMES);
+	}
+	SV_TraceBenchAbort ();	// puts everything back
+}
@@ -39,6 +39,8 @@ void SV_Init (void)
 	extern	cvar_t	sv_maxvelocity;
 	extern	cvar_t	sv_gravity;
 	extern	cvar_t	sv_nostep;
+	extern	cvar_t	sv_speculatetraces;
+	extern	cvar_t	sv_bvh;
 	extern	cvar_t	sv_friction;
 	extern	cvar_t	sv_edgefriction;
 	extern	cvar_t	sv_stopspeed;
@@ -57,6 +59,10 @@ void SV_Init (void)
 	Cvar_RegisterVariable (&sv_idealpitchscale);
 	Cvar_RegisterVariable (&sv_aim);
 	Cvar_RegisterVariable (&sv_nostep);
+	Cvar_RegisterVariable (&sv_speculatetraces);
+	Cvar_RegisterVariable (&sv_bvh);
+
+	Cmd_AddCommand ("tracebench", SV_TraceBench_f);
 
 	for (i=0 ; i<MAX_MODELS ; i++)
 		sprintf (localmodels[i], "*%i", i);
@@ -149,13 +155,13 @@ void SV_StartSound (edict_t *entity, int channel, char *sample, int volume,
     
 	ent = NUM_FOR_EDICT(entity);
 
-	channel = (ent<<3) | channel;
-
 	field_mask = 0;
 	if (volume != DEFAULT_SOUND_PACKET_VOLUME)
 		field_mask |= SND_VOLUME;
 	if (attenuation != DEFAULT_SOUND_PACKET_ATTENUATION)
 		field_mask |= SND_ATTENUATION;
+	if (ent >= SND_MAXENTITY)
+		field_mask |= SND_LARGEENTITY;
 
 // directed messages go only to the entity the are targeted on
 	MSG_WriteByte (&sv.datagram, svc_sound);
@@ -164,7 +170,13 @@ void SV_StartSound (edict_t *entity, int channel, char *sample, int volume,
 		MSG_WriteByte (&sv.datagram, volume);
 	if (field_mask & SND_ATTENUATION)
 		MSG_WriteByte (&sv.datagram, attenuation*64);
-	MSG_WriteShort (&sv.datagram, channel);
+	if (field_mask & SND_LARGEENTITY)
+	{
+		MSG_WriteShort (&sv.datagram, ent);
+		MSG_WriteByte (&sv.datagram, channel);
+	}
+	else
+		MSG_WriteShort (&sv.datagram, (ent<<3) | channel);
 	MSG_WriteByte (&sv.datagram, sound_num);
 	for (i=0 ; i<3 ; i++)
 		MSG_WriteCoord (&sv.datagram, entity->v.origin[i]+0.5*(entity->v.mins[i]+entity->v.maxs[i]));
@@ -266,6 +278,7 @@ void SV_ConnectClient (int clientnum)
 	client->netconnection = netconnection;
 
 	strcpy (client->name, "unconnected");
+	ED_StringsChanged ();
 	client->active = true;
 	client->spawned = false;
 	client->edict = ent;
@@ -454,11 +467,7 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 			if (!ent->v.modelindex || !pr_strings[ent->v.model])
 				continue;
 
-			for (i=0 ; i < ent->num_leafs ; i++)
-				if (pvs[ent->leafnums[i] >> 3] & (1 << (ent->leafnums[i]&7) ))
-					break;
-				
-			if (i == ent->num_leafs)
+			if (!SV_LeafsVisible (ent, pvs))
 				continue;		// not visible
 		}
 
@@ -841,6 +850,8 @@ void SV_SendClientMessages (void)
 		// send a full message when the next signon stage has been requested
 		// some other message data (name changes, etc) may accumulate 
 		// between signon stages
+			if (host_client->prespawning)
+				SV_SendSignon (host_client);
 			if (!host_client->sendsignon)
 			{
 				if (realtime - host_client->last_message > 5)
@@ -959,22 +970,80 @@ void SV_CreateBaseline (void)
 	//
 	// add to the message
 	//
-		MSG_WriteByte (&sv.signon,svc_spawnbaseline);		
-		MSG_WriteShort (&sv.signon,entnum);
-
-		MSG_WriteByte (&sv.signon, svent->baseline.modelindex);
-		MSG_WriteByte (&sv.signon, svent->baseline.frame);
-		MSG_WriteByte (&sv.signon, svent->baseline.colormap);
-		MSG_WriteByte (&sv.signon, svent->baseline.skin);
+		SV_ReserveSignon (16);
+		MSG_WriteByte (sv.signon,svc_spawnbaseline);		
+		MSG_WriteShort (sv.signon,entnum);
+
+		MSG_WriteByte (sv.signon, svent->baseline.modelindex);
+		MSG_WriteByte (sv.signon, svent->baseline.frame);
+		MSG_WriteByte (sv.signon, svent->baseline.colormap);
+		MSG_WriteByte (sv.signon, svent->baseline.skin);
 		for (i=0 ; i<3 ; i++)
 		{
-			MSG_WriteCoord(&sv.signon, svent->baseline.origin[i]);
-			MSG_WriteAngle(&sv.signon, svent->baseline.angles[i]);
+			MSG_WriteCoord(sv.signon, svent->baseline.origin[i]);
+			MSG_WriteAngle(sv.signon, svent->baseline.angles[i]);
 		}
 	}
 }
 
 
+/*
+================
+SV_ReserveSignon
+
+Starts the next signon message if the last one is past SIGNON_SPLIT.  Only
+the engine's own messages call this: what progs write to MSG_INIT can't be
+split, because where one of its messages ends isn't known.
+================
+*/
+void SV_ReserveSignon (int size)
+{
+	sizebuf_t	*msg;
+
+	if (sv.signon && sv.signon->cursize + size <= SIGNON_SPLIT)
+		return;
+	if (sv.num_signon_msgs == MAX_SIGNON_MSGS)
+		Host_Error ("SV_ReserveSignon: more than %i signon messages", MAX_SIGNON_MSGS);
+
+	msg = &sv.signon_msgs[sv.num_signon_msgs++];
+	msg->data = Hunk_AllocName (SIGNON_SIZE, "signon");
+	msg->maxsize = SIGNON_SIZE;
+	msg->cursize = 0;
+	sv.signon = msg;
+}
+
+/*
+================
+SV_SendSignon
+
+Adds as many of the signon messages as fit to the client's message, and
+svc_signonnum 2 after the last one.  Called by prespawn, then every frame
+until they are all out.
+================
+*/
+void SV_SendSignon (client_t *client)
+{
+	sizebuf_t	*msg;
+
+	while (client->signonsent < sv.num_signon_msgs)
+	{
+		msg = &sv.signon_msgs[client->signonsent];
+		if (client->message.cursize + msg->cursize > client->message.maxsize - 2)
+		{	// once what is already there has gone
+			client->sendsignon = true;
+			return;
+		}
+		SZ_Write (&client->message, msg->data, msg->cursize);
+		client->signonsent++;
+		client->sendsignon = true;
+	}
+
+	MSG_WriteByte (&client->message, svc_signonnum);
+	MSG_WriteByte (&client->message, 2);
+	client->sendsignon = true;
+	client->prespawning = false;
+}
+
 /*
 ================
 SV_SendReconnect
@@ -1032,6 +1101,68 @@ void SV_SaveSpawnparms (void)
 }
 
 
+/*
+================
+SV_GrowEdicts
+
+Makes room for at least count edicts.  The room is committed out of
+address space reserved for sv.edict_limit of them, so the edicts never
+move and EDICT_NUM stays a multiply.  A savegame can ask for more than the
+limit, which only drops the game.
+================
+*/
+void SV_GrowEdicts (int count)
+{
+	if (count <= sv.max_edicts)
+		return;
+	if (count > sv.edict_limit)
+		Host_Error ("SV_GrowEdicts: %i edicts, the limit is %i (-maxedicts)", count, sv.edict_limit);
+
+	count = (count + 255) & ~255;
+	if (count > sv.edict_limit)
+		count = sv.edict_limit;
+	Sys_CommitMemory (sv.edicts, count*pr_edict_size);
+
+	if (sv.max_edicts <= MAX_EDICTS && count > MAX_EDICTS)
+		Con_DPrintf ("more than %i edicts, original clients can't connect\n", MAX_EDICTS);
+	sv.max_edicts = count;
+}
+
+/*
+================
+SV_AllocEdicts
+
+Reserves room for the edicts of a new level, after the progs are loaded
+================
+*/
+void SV_AllocEdicts (void)
+{
+	static void	*reserved;
+	int			i;
+
+	sv.edict_limit = 8192;
+	i = COM_CheckParm ("-maxedicts");
+	if (i && i < com_argc-1)
+		sv.edict_limit = Q_atoi (com_argv[i+1]);
+	if (sv.edict_limit < MAX_EDICTS)
+		sv.edict_limit = MAX_EDICTS;
+	if (sv.edict_limit > MAX_EDICTS_LIMIT)
+		sv.edict_limit = MAX_EDICTS_LIMIT;
+
+	if (reserved)
+		Sys_ReleaseMemory (reserved);	// pr_edict_size can change with the progs
+	reserved = Sys_ReserveMemory (sv.edict_limit*pr_edict_size);
+	if (!reserved)
+		Sys_Error ("SV_AllocEdicts: couldn't reserve %i edicts", sv.edict_limit);
+
+	sv.edicts = reserved;
+	sv.max_edicts = 0;
+	SV_GrowEdicts (MAX_EDICTS);
+
+	sv.push_edicts = Hunk_AllocName (sv.edict_limit*sizeof(edict_t *), "push");
+	sv.push_from = Hunk_AllocName (sv.edict_limit*sizeof(vec3_t), "push");
+}
+
 /*
 ================
 SV_SpawnServer
@@ -1096,9 +1227,7 @@ void SV_SpawnServer (char *server)
 	PR_LoadProgs ();
 
 // allocate server memory
-	sv.max_edicts = MAX_EDICTS;
-	
-	sv.edicts = Hunk_AllocName (sv.max_edicts*pr_edict_size, "edicts");
+	SV_AllocEdicts ();
 
 	sv.datagram.maxsize = sizeof(sv.datagram_buf);
 	sv.datagram.cursize = 0;
@@ -1108,9 +1237,7 @@ void SV_SpawnServer (char *server)
 	sv.reliable_datagram.cursize = 0;
 	sv.reliable_datagram.data = sv.reliable_datagram_buf;
 	
-	sv.signon.maxsize = sizeof(sv.signon_buf);
-	sv.signon.cursize = 0;
-	sv.signon.data = sv.signon_buf;
+	SV_ReserveSignon (0);
 	
 // leave slots at start for clients only
 	sv.num_edicts = svs.maxclients+1;
@@ -1118,6 +1245,7 @@ void SV_SpawnServer (char *server)
 	{
 		ent = EDICT_NUM(i+1);
 		svs.clients[i].edict = ent;
+		svs.clients[i].prespawning = false;		// the old signon is gone
 	}
 	
 	sv.state = ss_loading;
@@ -1177,6 +1305,12 @@ void SV_SpawnServer (char *server)
 	
 	ED_LoadFromFile (sv.worldmodel->entities);
 
+// load the models that were precached but never set
+	for (i=2 ; i<MAX_MODELS && sv.model_precache[i] ; i++)
+		if (!sv.models[i])
+			sv.models[i] = Mod_ForName (sv.model_precache[i], true);
+	COM_FlushPrefetch ();
+
 	sv.active = true;
 
 // all setup is completed, any further precache statements are errors
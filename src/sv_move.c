@@ -36,9 +36,10 @@ int c_yes, c_no;
 
 qboolean SV_CheckBottom (edict_t *ent)
 {
-	vec3_t	mins, maxs, start, stop;
-	trace_t	trace;
-	int		x, y;
+	vec3_t	mins, maxs, start;
+	movetrace_t	moves[5];
+	trace_t	*trace;
+	int		x, y, i;
 	float	mid, bottom;
 	
 	VectorAdd (ent->v.origin, ent->v.mins, mins);
@@ -65,32 +66,46 @@ realcheck:
 //
 // check it for real...
 //
-	start[2] = mins[2];
+// the midpoint and the corners are all traced at once, which shares the
+// search for nearby entities.  Five moves stay on this thread, being too
+// few for SV_MoveBatch to wake the workers.
+	for (i=0 ; i<5 ; i++)
+	{
+		VectorCopy (vec3_origin, moves[i].mins);
+		VectorCopy (vec3_origin, moves[i].maxs);
+		moves[i].start[2] = mins[2];
+		moves[i].end[2] = moves[i].start[2] - 2*STEPSIZE;
+	}
 	
 // the midpoint must be within 16 of the bottom
-	start[0] = stop[0] = (mins[0] + maxs[0])*0.5;
-	start[1] = stop[1] = (mins[1] + maxs[1])*0.5;
-	stop[2] = start[2] - 2*STEPSIZE;
-	trace = SV_Move (start, vec3_origin, vec3_origin, stop, true, ent);
+	moves[0].start[0] = moves[0].end[0] = (mins[0] + maxs[0])*0.5;
+	moves[0].start[1] = moves[0].end[1] = (mins[1] + maxs[1])*0.5;
+
+	i = 1;
+	for	(x=0 ; x<=1 ; x++)
+		for	(y=0 ; y<=1 ; y++, i++)
+		{
+			moves[i].start[0] = moves[i].end[0] = x ? maxs[0] : mins[0];
+			moves[i].start[1] = moves[i].end[1] = y ? maxs[1] : mins[1];
+		}
 
-	if (trace.fraction == 1.0)
+	SV_MoveBatch (moves, 5, true, ent);
+
+	trace = &moves[0].trace;
+	if (trace->fraction == 1.0)
 		return false;
-	mid = bottom = trace.endpos[2];
+	mid = bottom = trace->endpos[2];
 	
 // the corners must be within 16 of the midpoint	
-	for	(x=0 ; x<=1 ; x++)
-		for	(y=0 ; y<=1 ; y++)
-		{
-			start[0] = stop[0] = x ? maxs[0] : mins[0];
-			start[1] = stop[1] = y ? maxs[1] : mins[1];
-			
-			trace = SV_Move (start, vec3_origin, vec3_origin, stop, true, ent);
+	for (i=1 ; i<5 ; i++)
+	{
+		trace = &moves[i].trace;
 			
-			if (trace.fraction != 1.0 && trace.endpos[2] > bottom)
-				bottom = trace.endpos[2];
-			if (trace.fraction == 1.0 || mid - trace.endpos[2] > STEPSIZE)
-				return false;
-		}
+		if (trace->fraction != 1.0 && trace->endpos[2] > bottom)
+			bottom = trace->endpos[2];
+		if (trace->fraction == 1.0 || mid - trace->endpos[2] > STEPSIZE)
+			return false;
+	}
 
 	c_yes++;
 	return true;
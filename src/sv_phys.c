@@ -44,6 +44,7 @@ cvar_t	sv_stopspeed = {"sv_stopspeed","100"};
 cvar_t	sv_gravity = {"sv_gravity","800",false,true};
 cvar_t	sv_maxvelocity = {"sv_maxvelocity","2000"};
 cvar_t	sv_nostep = {"sv_nostep","0"};
+cvar_t	sv_speculatetraces = {"sv_speculatetraces","0"};	// trace toss moves ahead on the workers, nothing else
 
 #ifdef QUAKE2
 static	vec3_t	vec_origin = {0.0, 0.0, 0.0};
@@ -268,6 +269,7 @@ int SV_FlyMove (edict_t *ent, float time, trace_t *steptrace)
 		if (trace.fraction > 0)
 		{	// actually covered some distance
 			VectorCopy (trace.endpos, ent->v.origin);
+			SV_EdictMoved (ent);
 			VectorCopy (ent->v.velocity, original_velocity);
 			numplanes = 0;
 		}
@@ -443,8 +445,8 @@ void SV_PushMove (edict_t *pusher, float movetime)
 	vec3_t		mins, maxs, move;
 	vec3_t		entorig, pushorig;
 	int			num_moved;
-	edict_t		*moved_edict[MAX_EDICTS];
-	vec3_t		moved_from[MAX_EDICTS];
+	edict_t		**moved_edict;
+	vec3_t		*moved_from;
 
 	if (!pusher->v.velocity[0] && !pusher->v.velocity[1] && !pusher->v.velocity[2])
 	{
@@ -452,6 +454,9 @@ void SV_PushMove (edict_t *pusher, float movetime)
 		return;
 	}
 
+	moved_edict = sv.push_edicts;	// too big for the stack with a high edict limit
+	moved_from = sv.push_from;
+
 	for (i=0 ; i<3 ; i++)
 	{
 		move[i] = pusher->v.velocity[i] * movetime;
@@ -524,6 +529,7 @@ void SV_PushMove (edict_t *pusher, float movetime)
 			{	// corpse
 				check->v.mins[0] = check->v.mins[1] = 0;
 				VectorCopy (check->v.mins, check->v.maxs);
+				SV_EdictMoved (check);
 				continue;
 			}
 			
@@ -570,8 +576,8 @@ void SV_PushRotate (edict_t *pusher, float movetime)
 	vec3_t		move, a, amove;
 	vec3_t		entorig, pushorig;
 	int			num_moved;
-	edict_t		*moved_edict[MAX_EDICTS];
-	vec3_t		moved_from[MAX_EDICTS];
+	edict_t		**moved_edict;
+	vec3_t		*moved_from;
 	vec3_t		org, org2;
 	vec3_t		forward, right, up;
 
@@ -581,6 +587,9 @@ void SV_PushRotate (edict_t *pusher, float movetime)
 		return;
 	}
 
+	moved_edict = sv.push_edicts;	// too big for the stack with a high edict limit
+	moved_from = sv.push_from;
+
 	for (i=0 ; i<3 ; i++)
 		amove[i] = pusher->v.avelocity[i] * movetime;
 
@@ -657,6 +666,7 @@ void SV_PushRotate (edict_t *pusher, float movetime)
 			{	// corpse
 				check->v.mins[0] = check->v.mins[1] = 0;
 				VectorCopy (check->v.mins, check->v.maxs);
+				SV_EdictMoved (check);
 				continue;
 			}
 			
@@ -941,6 +951,7 @@ int SV_TryUnstick (edict_t *ent, vec3_t oldvel)
 			
 // go back to the original pos and try again
 		VectorCopy (oldorg, ent->v.origin);
+		SV_EdictMoved (ent);
 	}
 	
 	VectorCopy (vec3_origin, ent->v.velocity);
@@ -1498,6 +1509,159 @@ void SV_Physics_Step (edict_t *ent)
 
 //============================================================================
 
+/*
+=============
+SV_SpeculateToss
+
+Queues the move SV_Physics_Toss is going to make for ent, worked out the
+same way.  If a think runs first or the numbers come out differently, the
+move just won't be asked for.
+=============
+*/
+void SV_SpeculateToss (edict_t *ent)
+{
+#ifndef QUAKE2
+	float	thinktime, ent_gravity;
+	vec3_t	velocity, move, end;
+	eval_t	*val;
+	int		i, type;
+
+	if ((int)ent->v.flags & FL_ONGROUND)
+		return;
+	thinktime = ent->v.nextthink;
+	if (thinktime > 0 && thinktime <= sv.time + host_frametime)
+		return;
+
+// SV_CheckVelocity
+	for (i=0 ; i<3 ; i++)
+	{
+		if (IS_NAN(ent->v.velocity[i]) || IS_NAN(ent->v.origin[i]))
+			return;
+		velocity[i] = ent->v.velocity[i];
+		if (velocity[i] > sv_maxvelocity.value)
+			velocity[i] = sv_maxvelocity.value;
+		else if (velocity[i] < -sv_maxvelocity.value)
+			velocity[i] = -sv_maxvelocity.value;
+	}
+
+// SV_AddGravity
+	if (ent->v.movetype != MOVETYPE_FLY
+	&& ent->v.movetype != MOVETYPE_FLYMISSILE)
+	{
+		val = GetEdictFieldValue(ent, "gravity");
+		if (val && val->_float)
+			ent_gravity = val->_float;
+		else
+			ent_gravity = 1.0;
+		velocity[2] -= ent_gravity * sv_gravity.value * host_frametime;
+	}
+
+// SV_PushEntity
+	VectorScale (velocity, host_frametime, move);
+	VectorAdd (ent->v.origin, move, end);
+
+	if (ent->v.movetype == MOVETYPE_FLYMISSILE)
+		type = MOVE_MISSILE;
+	else if (ent->v.solid == SOLID_TRIGGER || ent->v.solid == SOLID_NOT)
+		type = MOVE_NOMONSTERS;
+	else
+		type = MOVE_NORMAL;
+
+	SV_SpeculateMove (ent->v.origin, ent->v.mins, ent->v.maxs, end, type, ent);
+#endif
+}
+
+/*
+=============
+SV_SpeculateFall
+
+Queues the first move SV_FlyMove is going to make for a falling
+MOVETYPE_STEP entity in SV_Physics_Step.  The rest depend on what the first
+one hits.
+=============
+*/
+void SV_SpeculateFall (edict_t *ent)
+{
+#ifndef QUAKE2
+	float	ent_gravity, time;
+	vec3_t	velocity, end;
+	eval_t	*val;
+	int		i;
+
+	if ((int)ent->v.flags & (FL_ONGROUND | FL_FLY | FL_SWIM))
+		return;
+
+// SV_AddGravity
+	val = GetEdictFieldValue(ent, "gravity");
+	if (val && val->_float)
+		ent_gravity = val->_float;
+	else
+		ent_gravity = 1.0;
+	VectorCopy (ent->v.velocity, velocity);
+	velocity[2] -= ent_gravity * sv_gravity.value * host_frametime;
+
+// SV_CheckVelocity
+	for (i=0 ; i<3 ; i++)
+	{
+		if (IS_NAN(velocity[i]) || IS_NAN(ent->v.origin[i]))
+			return;
+		if (velocity[i] > sv_maxvelocity.value)
+			velocity[i] = sv_maxvelocity.value;
+		else if (velocity[i] < -sv_maxvelocity.value)
+			velocity[i] = -sv_maxvelocity.value;
+	}
+
+// SV_FlyMove
+	if (!velocity[0] && !velocity[1] && !velocity[2])
+		return;
+	time = host_frametime;
+	for (i=0 ; i<3 ; i++)
+		end[i] = ent->v.origin[i] + time * velocity[i];
+
+	SV_SpeculateMove (ent->v.origin, ent->v.mins, ent->v.maxs, end, MOVE_NORMAL, ent);
+#endif
+}
+
+/*
+=============
+SV_SpeculateTraces
+
+With sv_speculatetraces set, the moves of toss, bounce and fly entities,
+and the first move of falling monsters, are traced on the worker threads
+before the frame runs.  SV_Move only uses a trace made that way when it
+would have come out the same, so the frame does exactly what it would have
+otherwise.  Only these traces are speculated: think functions and physics
+still run in edict order on this thread, since the progs have one set of
+globals and one stack.
+=============
+*/
+void SV_SpeculateTraces (void)
+{
+	int		i;
+	edict_t	*ent;
+
+	if (!sv_speculatetraces.value || !Sys_NumWorkers ())
+		return;
+	if (pr_global_struct->force_retouch)
+		return;		// everything gets linked again
+
+	ent = EDICT_NUM(svs.maxclients+1);
+	for (i=svs.maxclients+1 ; i<sv.num_edicts ; i++, ent = NEXT_EDICT(ent))
+	{
+		if (ent->free)
+			continue;
+		if (ent->v.movetype == MOVETYPE_TOSS
+		|| ent->v.movetype == MOVETYPE_BOUNCE
+		|| ent->v.movetype == MOVETYPE_FLY
+		|| ent->v.movetype == MOVETYPE_FLYMISSILE)
+			SV_SpeculateToss (ent);
+		else if (ent->v.movetype == MOVETYPE_STEP)
+			SV_SpeculateFall (ent);
+	}
+
+	SV_RunSpeculation ();
+}
+
 /*
 ================
 SV_Physics
@@ -1517,6 +1681,8 @@ void SV_Physics (void)
 
 //SV_CheckAllEnts ();
 
+	SV_SpeculateTraces ();
+
 //
 // treat each object in turn
 //
@@ -1557,6 +1723,8 @@ void SV_Physics (void)
 			Sys_Error ("SV_Physics: bad movetype %i", (int)ent->v.movetype);			
 	}
 	
+	SV_EndSpeculation ();
+
 	if (pr_global_struct->force_retouch)
 		pr_global_struct->force_retouch--;	
 
@@ -36,11 +36,68 @@ int Sys_FileWrite (int handle, void *data, int count);
 int	Sys_FileTime (char *path);
 void Sys_mkdir (char *path);
 
+// calls func with every file below dir, named relative to dir with '/'
+// between the directory levels
+void Sys_ListFiles (char *dir, void (*func) (char *name));
+
+//
+// file mapping
+//
+
+// returns a mapping handle, or -1 if the file can't be mapped
+int Sys_FileMapOpen (char *path);
+
+// views are copy-on-write, so they can be modified in place
+void *Sys_FileMapView (int mapping, int position, int count);
+void Sys_FileUnmapView (void *view);
+
+//
+// worker threads
+//
+typedef struct sysjob_s
+{
+	void		(*func) (void *data);
+	void		*data;
+	volatile int	state;		// only touched by the job queue
+	struct sysjob_s	*next;
+} sysjob_t;
+
+void Sys_InitWorkers (void);
+int Sys_NumWorkers (void);
+
+// func will be called with data on some worker thread, or right away
+// on this one if there are no workers
+void Sys_QueueJob (sysjob_t *job, void (*func) (void *data), void *data);
+
+// the same for jobs that mostly wait on the disk.  They go to a single io
+// thread, so reads are issued one at a time in the order they were queued.
+void Sys_QueueIOJob (sysjob_t *job, void (*func) (void *data), void *data);
+
+// returns once the job has finished.  A job no worker has picked up yet
+// is run on the calling thread instead of waiting for one.
+void Sys_WaitJob (sysjob_t *job);
+
+// takes back a job no worker has picked up yet without running it, and
+// returns true.  One that has already started is waited for instead.
+qboolean Sys_CancelJob (sysjob_t *job);
+
 //
 // memory protection
 //
 void Sys_MakeCodeWriteable (unsigned long startaddr, unsigned long length);
 
+// readable, writeable and executable memory for generated code, NULL if
+// the system won't give any
+void *Sys_AllocCode (int size);
+void Sys_FreeCode (void *code);
+
+// address space for size bytes that nothing else will be put in, so a table
+// can grow in place.  Sys_CommitMemory makes the first size bytes usable,
+// zero filled the first time.  NULL if the system won't give any.
+void *Sys_ReserveMemory (int size);
+void Sys_CommitMemory (void *base, int size);
+void Sys_ReleaseMemory (void *base);
+
 //
 // system IO
 //
@@ -227,6 +227,378 @@ void Sys_mkdir (char *path)
 	_mkdir (path);
 }
 
+/*
+================
+Sys_ListFilesR
+================
+*/
+void Sys_ListFilesR (char *dir, char *prefix, void (*func) (char *name))
+{
+	WIN32_FIND_DATA	data;
+	HANDLE			find;
+	char			pattern[MAX_OSPATH];
+	char			name[MAX_OSPATH];
+
+	sprintf (pattern, "%s/%s*", dir, prefix);
+	find = FindFirstFile (pattern, &data);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+
+	do
+	{
+		if (!strcmp (data.cFileName, ".") || !strcmp (data.cFileName, ".."))
+			continue;
+		if (strlen (prefix) + strlen (data.cFileName) + 2 > MAX_QPATH)
+			continue;	// too long to be a game path
+
+		sprintf (name, "%s%s", prefix, data.cFileName);
+		if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			strcat (name, "/");
+			Sys_ListFilesR (dir, name, func);
+		}
+		else
+			func (name);
+	} while (FindNextFile (find, &data));
+
+	FindClose (find);
+}
+
+/*
+================
+Sys_ListFiles
+================
+*/
+void Sys_ListFiles (char *dir, void (*func) (char *name))
+{
+	Sys_ListFilesR (dir, "", func);
+}
+
+
+/*
+===============================================================================
+
+FILE MAPPING
+
+===============================================================================
+*/
+
+#define	MAX_MAPPINGS	64
+HANDLE	sys_mappings[MAX_MAPPINGS];
+
+/*
+================
+Sys_FileMapOpen
+
+Creates a read only mapping of the whole file, returns -1 on failure
+================
+*/
+int Sys_FileMapOpen (char *path)
+{
+	HANDLE	file, mapping;
+	int		i;
+
+	for (i=1 ; i<MAX_MAPPINGS ; i++)
+		if (!sys_mappings[i])
+			break;
+	if (i == MAX_MAPPINGS)
+		return -1;
+
+	file = CreateFile (path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return -1;
+
+// the mapping object keeps its own reference to the file
+	mapping = CreateFileMapping (file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	CloseHandle (file);
+	if (!mapping)
+		return -1;
+
+	sys_mappings[i] = mapping;
+	return i;
+}
+
+/*
+================
+Sys_FileMapView
+
+Returns a copy-on-write view of count bytes at position in the mapped file.
+Writes through the view only touch private pages, never the file.
+================
+*/
+void *Sys_FileMapView (int mapping, int position, int count)
+{
+	SYSTEM_INFO	info;
+	int			base;
+	byte		*view;
+
+	if (count <= 0)
+		return NULL;
+
+// views have to start on an allocation granularity boundary
+	GetSystemInfo (&info);
+	base = position - position % info.dwAllocationGranularity;
+
+	view = MapViewOfFile (sys_mappings[mapping], FILE_MAP_COPY, 0, base,
+		count + position - base);
+	if (!view)
+		return NULL;
+
+	return view + position - base;
+}
+
+/*
+================
+Sys_FileUnmapView
+================
+*/
+void Sys_FileUnmapView (void *view)
+{
+	SYSTEM_INFO	info;
+
+	GetSystemInfo (&info);
+	UnmapViewOfFile ((byte *)view - (size_t)view % info.dwAllocationGranularity);
+}
+
+
+/*
+===============================================================================
+
+WORKER THREADS
+
+===============================================================================
+*/
+
+#define	MAX_WORKERS		16
+
+#define	JOB_QUEUED		1
+#define	JOB_RUNNING		2
+#define	JOB_DONE		3
+
+typedef struct
+{
+	sysjob_t	*head, *tail;
+	SDL_cond	*queued;		// signalled when a job is added
+} sysqueue_t;
+
+int			sys_numworkers;
+qboolean	sys_iothread;
+SDL_mutex	*sys_jobmutex;		// guards both queues and every job state
+SDL_cond	*sys_jobdone;		// broadcast when any job finishes
+sysqueue_t	sys_workqueue;		// cpu work, spread over the workers
+sysqueue_t	sys_ioqueue;		// file reads, one at a time so the disk doesn't thrash
+
+/*
+================
+Sys_WorkerThread
+
+Serves one queue until the program exits
+================
+*/
+int Sys_WorkerThread (void *data)
+{
+	sysqueue_t	*queue;
+	sysjob_t	*job;
+
+	queue = (sysqueue_t *)data;
+	while (1)
+	{
+		SDL_mutexP (sys_jobmutex);
+		while (!queue->head)
+			SDL_CondWait (queue->queued, sys_jobmutex);
+		job = queue->head;
+		queue->head = job->next;
+		if (!queue->head)
+			queue->tail = NULL;
+		job->state = JOB_RUNNING;
+		SDL_mutexV (sys_jobmutex);
+
+		job->func (job->data);
+
+		SDL_mutexP (sys_jobmutex);
+		job->state = JOB_DONE;
+		SDL_CondBroadcast (sys_jobdone);
+		SDL_mutexV (sys_jobmutex);
+	}
+
+	return 0;
+}
+
+/*
+================
+Sys_InitWorkers
+
+One worker per extra processor unless -workers says otherwise.
+-workers 0 runs every job on the thread that queues it.  The io thread
+is there even on one processor, since it spends its time waiting on the
+disk; -noiothread does without it.
+================
+*/
+void Sys_InitWorkers (void)
+{
+	SYSTEM_INFO	info;
+	int			i;
+
+	GetSystemInfo (&info);
+	sys_numworkers = info.dwNumberOfProcessors - 1;
+
+	i = COM_CheckParm ("-workers");
+	if (i && i < com_argc-1)
+		sys_numworkers = Q_atoi (com_argv[i+1]);
+
+	if (sys_numworkers < 0)
+		sys_numworkers = 0;
+	if (sys_numworkers > MAX_WORKERS)
+		sys_numworkers = MAX_WORKERS;
+	sys_iothread = !COM_CheckParm ("-noiothread");
+	if (!sys_numworkers && !sys_iothread)
+		return;
+
+	sys_jobmutex = SDL_CreateMutex ();
+	sys_jobdone = SDL_CreateCond ();
+	sys_workqueue.queued = SDL_CreateCond ();
+	sys_ioqueue.queued = SDL_CreateCond ();
+	if (!sys_jobmutex || !sys_jobdone || !sys_workqueue.queued || !sys_ioqueue.queued)
+		Sys_Error ("Couldn't create worker thread locks");
+
+	for (i=0 ; i<sys_numworkers ; i++)
+		if (!SDL_CreateThread (Sys_WorkerThread, &sys_workqueue))
+			Sys_Error ("Couldn't create worker thread");
+
+	if (sys_iothread && !SDL_CreateThread (Sys_WorkerThread, &sys_ioqueue))
+		Sys_Error ("Couldn't create io thread");
+}
+
+int Sys_NumWorkers (void)
+{
+	return sys_numworkers;
+}
+
+/*
+================
+Sys_AddJob
+================
+*/
+void Sys_AddJob (sysqueue_t *queue, qboolean threaded, sysjob_t *job, void (*func) (void *data), void *data)
+{
+	job->func = func;
+	job->data = data;
+	job->next = NULL;
+
+	if (!threaded)
+	{
+		func (data);
+		job->state = JOB_DONE;
+		return;
+	}
+
+	SDL_mutexP (sys_jobmutex);
+	job->state = JOB_QUEUED;
+	if (queue->tail)
+		queue->tail->next = job;
+	else
+		queue->head = job;
+	queue->tail = job;
+	SDL_CondSignal (queue->queued);
+	SDL_mutexV (sys_jobmutex);
+}
+
+void Sys_QueueJob (sysjob_t *job, void (*func) (void *data), void *data)
+{
+	Sys_AddJob (&sys_workqueue, sys_numworkers > 0, job, func, data);
+}
+
+void Sys_QueueIOJob (sysjob_t *job, void (*func) (void *data), void *data)
+{
+	Sys_AddJob (&sys_ioqueue, sys_iothread, job, func, data);
+}
+
+/*
+================
+Sys_UnqueueJob
+
+Takes a job that hasn't been started off its queue.  The job lock must be held.
+================
+*/
+qboolean Sys_UnqueueJob (sysqueue_t *queue, sysjob_t *job)
+{
+	sysjob_t	**link, *prev;
+
+	prev = NULL;
+	for (link = &queue->head ; *link ; link = &(*link)->next)
+	{
+		if (*link == job)
+		{
+			*link = job->next;
+			if (queue->tail == job)
+				queue->tail = prev;
+			return true;
+		}
+		prev = *link;
+	}
+
+	return false;
+}
+
+/*
+================
+Sys_WaitJob
+================
+*/
+void Sys_WaitJob (sysjob_t *job)
+{
+	if (!sys_jobmutex)
+		return;		// already run by Sys_QueueJob
+
+	SDL_mutexP (sys_jobmutex);
+
+	if (job->state == JOB_QUEUED)
+	{	// nobody has started it, so take it back and do it here
+		if (!Sys_UnqueueJob (&sys_workqueue, job))
+			Sys_UnqueueJob (&sys_ioqueue, job);
+		job->state = JOB_RUNNING;
+		SDL_mutexV (sys_jobmutex);
+
+		job->func (job->data);
+		job->state = JOB_DONE;
+		return;
+	}
+
+	while (job->state != JOB_DONE)
+		SDL_CondWait (sys_jobdone, sys_jobmutex);
+
+	SDL_mutexV (sys_jobmutex);
+}
+
+/*
+================
+Sys_CancelJob
+================
+*/
+qboolean Sys_CancelJob (sysjob_t *job)
+{
+	if (!sys_jobmutex)
+		return false;		// already run by Sys_QueueJob
+
+	SDL_mutexP (sys_jobmutex);
+
+	if (job->state == JOB_QUEUED)
+	{
+		if (!Sys_UnqueueJob (&sys_workqueue, job))
+			Sys_UnqueueJob (&sys_ioqueue, job);
+		job->state = JOB_DONE;
+		SDL_mutexV (sys_jobmutex);
+		return true;
+	}
+
+	while (job->state != JOB_DONE)
+		SDL_CondWait (sys_jobdone, sys_jobmutex);
+
+	SDL_mutexV (sys_jobmutex);
+	return false;
+}
+
 
 /*
 ===============================================================================
@@ -249,6 +621,61 @@ void Sys_MakeCodeWriteable (unsigned long startaddr, unsigned long length)
    		Sys_Error("Protection change failed\n");
 }
 
+/*
+================
+Sys_AllocCode
+
+Memory that code can be generated into and run from
+================
+*/
+void *Sys_AllocCode (int size)
+{
+	return VirtualAlloc (NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+}
+
+/*
+================
+Sys_FreeCode
+================
+*/
+void Sys_FreeCode (void *code)
+{
+	VirtualFree (code, 0, MEM_RELEASE);
+}
+
+/*
+================
+Sys_ReserveMemory
+================
+*/
+void *Sys_ReserveMemory (int size)
+{
+	return VirtualAlloc (NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+/*
+================
+Sys_CommitMemory
+
+Pages that are already committed are left alone
+================
+*/
+void Sys_CommitMemory (void *base, int size)
+{
+	if (!VirtualAlloc (base, size, MEM_COMMIT, PAGE_READWRITE))
+		Sys_Error ("Sys_CommitMemory: couldn't commit %i bytes", size);
+}
+
+/*
+================
+Sys_ReleaseMemory
+================
+*/
+void Sys_ReleaseMemory (void *base)
+{
+	VirtualFree (base, 0, MEM_RELEASE);
+}
+
 
 /* #ifndef _M_IX86 */
 
@@ -320,6 +747,8 @@ void Sys_Init (void)
 		WinNT = true;
 	else
 		WinNT = false;
+
+	Sys_InitWorkers ();
 }
 
 
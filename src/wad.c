@@ -72,7 +72,8 @@ void W_LoadWadFile (char *filename)
 	unsigned		i;
 	int				infotableofs;
 	
-	wad_base = COM_LoadHunkFile (filename);
+// lumps are used in place, so a pak view saves a hunk copy of the whole wad
+	wad_base = COM_MapHunkFile (filename);
 	if (!wad_base)
 		Sys_Error ("W_LoadWadFile: couldn't load %s", filename);
 
@@ -39,8 +39,17 @@ typedef struct
 	trace_t		trace;
 	int			type;
 	edict_t		*passedict;
+	qboolean	speculative;	// on a worker, see SV_RunSpeculation
+	qboolean	failed;			// hit something only the main thread should see
 } moveclip_t;
 
+typedef struct
+{
+	hull_t		hull;
+	mplane_t	planes[6];
+	mclipnode_t	nodes[6];
+} boxhull_t;
+
 
 int SV_HullPointContents (hull_t *hull, int num, vec3_t p);
 
@@ -53,9 +62,10 @@ HULL BOXES
 */
 
 
-static	hull_t		box_hull;
+static	hull_t		box_hull;			// copied into a boxhull_t for each use
 static	dclipnode_t	box_clipnodes[6];
 static	mplane_t	box_planes[6];
+static	mclipnode_t	box_nodes[6];
 
 /*
 ===================
@@ -89,8 +99,13 @@ void SV_InitBoxHull (void)
 		
 		box_planes[i].type = i>>1;
 		box_planes[i].normal[i>>1] = 1;
+
+		box_nodes[i].type = i>>1;
+		box_nodes[i].normal[i>>1] = 1;
+		box_nodes[i].children[0] = box_clipnodes[i].children[0];
+		box_nodes[i].children[1] = box_clipnodes[i].children[1];
 	}
-	
+	box_hull.nodes = box_nodes;
 }
 
 
@@ -99,19 +114,31 @@ void SV_InitBoxHull (void)
 SV_HullForBox
 
 To keep everything totally uniform, bounding boxes are turned into small
-BSP trees instead of being compared directly.
+BSP trees instead of being compared directly.  The planes are filled in
+the caller's box, so traces can run on more than one thread at once.
 ===================
 */
-hull_t	*SV_HullForBox (vec3_t mins, vec3_t maxs)
+hull_t	*SV_HullForBox (boxhull_t *box, vec3_t mins, vec3_t maxs)
 {
-	box_planes[0].dist = maxs[0];
-	box_planes[1].dist = mins[0];
-	box_planes[2].dist = maxs[1];
-	box_planes[3].dist = mins[1];
-	box_planes[4].dist = maxs[2];
-	box_planes[5].dist = mins[2];
+	int		i;
+
+	box->hull = box_hull;
+	box->hull.planes = box->planes;
+	memcpy (box->planes, box_planes, sizeof(box_planes));
+
+	box->planes[0].dist = maxs[0];
+	box->planes[1].dist = mins[0];
+	box->planes[2].dist = maxs[1];
+	box->planes[3].dist = mins[1];
+	box->planes[4].dist = maxs[2];
+	box->planes[5].dist = mins[2];
 
-	return &box_hull;
+	box->hull.nodes = box->nodes;
+	memcpy (box->nodes, box_nodes, sizeof(box_nodes));
+	for (i=0 ; i<6 ; i++)
+		box->nodes[i].dist = box->planes[i].dist;
+
+	return &box->hull;
 }
 
 
@@ -124,9 +151,10 @@ Returns a hull that can be used for testing or clipping an object of mins/maxs
 size.
 Offset is filled in to contain the adjustment that must be added to the
 testing object's origin to get a point to use with the returned hull.
+Box holds the hull made for entities without a BSP model.
 ================
 */
-hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset)
+hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset, boxhull_t *box)
 {
 	model_t		*model;
 	vec3_t		size;
@@ -161,7 +189,7 @@ hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset)
 
 		VectorSubtract (ent->v.mins, maxs, hullmins);
 		VectorSubtract (ent->v.maxs, mins, hullmaxs);
-		hull = SV_HullForBox (hullmins, hullmaxs);
+		hull = SV_HullForBox (box, hullmins, hullmaxs);
 		
 		VectorCopy (ent->v.origin, offset);
 	}
@@ -173,6 +201,512 @@ hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset)
 /*
 ===============================================================================
 
+BOUNDING VOLUME HIERARCHY
+
+With sv_bvh set when a map is loaded, entities are linked into two trees of
+boxes instead of the area nodes, one for solids and one for triggers.  Each
+leaf holds an entity's box grown by BVH_MARGIN, so an entity that moves a
+little is linked again without touching the tree.  Inserting picks the
+sibling that adds the least surface area, and the nodes above are rotated on
+the way back up to keep the tree balanced.
+
+The area nodes are a fixed split of the world into 16 cells, and anything
+crossing one of the first splits sits near the top, where every trace and
+touch has to look at it.  The tree follows where the entities actually are.
+
+Traces and touches collect what the tree finds and go through it in edict
+order, so what they see doesn't depend on the shape of the tree.
+
+===============================================================================
+*/
+
+#define	BVH_SOLID		0
+#define	BVH_TRIGGER		1
+#define	BVH_MARGIN		8			// room to move before a leaf is put back in
+#define	BVH_SLACK		32			// a leaf this much too big is put back in too
+#define	BVH_HUGE		1e30		// a NaN box covers everything
+#define	BVH_STACK		256
+#define	BVH_LOCALLIST	256			// for a move traced on a worker
+
+typedef struct
+{
+	vec3_t		mins, maxs;
+	int			parent;			// or the next free node
+	int			children[2];	// -1 for a leaf
+	int			height;			// leaves are 0
+	int			tree;			// BVH_SOLID or BVH_TRIGGER, for a leaf
+	edict_t		*ent;
+} bvhnode_t;
+
+typedef struct
+{
+	edict_t		**ents;
+	int			count, max;
+	qboolean	overflow;		// and stopped
+} bvhlist_t;
+
+typedef qboolean (*bvhvisit_t) (edict_t *ent, void *data);
+
+cvar_t	sv_bvh = {"sv_bvh","0"};	// takes effect on the next map
+
+static	qboolean	sv_usebvh;			// sv_bvh when the map was loaded
+static	bvhnode_t	*sv_bvhnodes;		// two for each edict, which is all it takes
+static	int			sv_bvhroot[2];
+static	int			sv_bvhfree;
+static	int			*sv_bvhleaf;		// each edict's leaf, -1 if none
+static	link_t		sv_bvhlinked;		// area links go here, for ent->area.prev
+int SV_CompareEdicts (const void *a, const void *b);
+
+static	edict_t		**sv_bvhlist;		// for SV_SortBVH on the main thread
+static	int			sv_bvhlistsize;
+static	int			sv_numbvhlist;		// in use by the touches running now
+
+/*
+===============
+SV_ClearBVH
+===============
+*/
+void SV_ClearBVH (void)
+{
+	int		i, count;
+
+	sv_usebvh = sv_bvh.value != 0;
+	if (!sv_usebvh)
+		return;
+
+	count = 2 * sv.edict_limit;
+	sv_bvhnodes = Hunk_AllocName (count*sizeof(bvhnode_t), "bvh");
+	for (i=0 ; i<count-1 ; i++)
+		sv_bvhnodes[i].parent = i+1;
+	sv_bvhnodes[i].parent = -1;
+	sv_bvhfree = 0;
+	sv_bvhroot[BVH_SOLID] = sv_bvhroot[BVH_TRIGGER] = -1;
+
+	sv_bvhleaf = Hunk_AllocName (sv.edict_limit*sizeof(int), "bvhleaf");
+	for (i=0 ; i<sv.edict_limit ; i++)
+		sv_bvhleaf[i] = -1;
+
+// touches can nest, each one adding to the end of the list
+	sv_bvhlistsize = 2 * sv.edict_limit;
+	sv_bvhlist = Hunk_AllocName (sv_bvhlistsize*sizeof(edict_t *), "bvhlist");
+	sv_numbvhlist = 0;
+
+	ClearLink (&sv_bvhlinked);
+}
+
+/*
+===============
+SV_BVHUnion
+===============
+*/
+void SV_BVHUnion (bvhnode_t *node, bvhnode_t *a, bvhnode_t *b)
+{
+	int		i;
+
+	for (i=0 ; i<3 ; i++)
+	{
+		node->mins[i] = a->mins[i] < b->mins[i] ? a->mins[i] : b->mins[i];
+		node->maxs[i] = a->maxs[i] > b->maxs[i] ? a->maxs[i] : b->maxs[i];
+	}
+}
+
+/*
+===============
+SV_BVHArea
+
+Surface area of the union of a and b, or of a alone if b is NULL
+===============
+*/
+double SV_BVHArea (bvhnode_t *a, bvhnode_t *b)
+{
+	bvhnode_t	u;
+
+	if (b)
+	{
+		SV_BVHUnion (&u, a, b);
+		a = &u;
+	}
+	return 2.0 * ((double)(a->maxs[0] - a->mins[0]) * (a->maxs[1] - a->mins[1])
+		+ (double)(a->maxs[1] - a->mins[1]) * (a->maxs[2] - a->mins[2])
+		+ (double)(a->maxs[2] - a->mins[2]) * (a->maxs[0] - a->mins[0]));
+}
+
+/*
+===============
+SV_BVHFit
+
+Sets an inner node's box and height from its children
+===============
+*/
+void SV_BVHFit (int n)
+{
+	bvhnode_t	*node, *a, *b;
+
+	node = &sv_bvhnodes[n];
+	a = &sv_bvhnodes[node->children[0]];
+	b = &sv_bvhnodes[node->children[1]];
+	SV_BVHUnion (node, a, b);
+	node->height = 1 + (a->height > b->height ? a->height : b->height);
+}
+
+/*
+===============
+SV_BVHReplace
+
+Puts n where old was under parent
+===============
+*/
+void SV_BVHReplace (int tree, int parent, int old, int n)
+{
+	sv_bvhnodes[n].parent = parent;
+	if (parent == -1)
+		sv_bvhroot[tree] = n;
+	else if (sv_bvhnodes[parent].children[0] == old)
+		sv_bvhnodes[parent].children[0] = n;
+	else
+		sv_bvhnodes[parent].children[1] = n;
+}
+
+/*
+===============
+SV_BVHRotate
+
+If one side of node a is more than one taller than the other, the taller
+child takes a's place, and a takes the taller child's lower grandchild.
+Returns the node now in a's place.
+===============
+*/
+int SV_BVHRotate (int tree, int a)
+{
+	bvhnode_t	*node;
+	int			side, up, keep, move;
+
+	node = &sv_bvhnodes[a];
+	if (node->height < 2)
+		return a;
+
+	if (sv_bvhnodes[node->children[1]].height > sv_bvhnodes[node->children[0]].height + 1)
+		side = 1;
+	else if (sv_bvhnodes[node->children[0]].height > sv_bvhnodes[node->children[1]].height + 1)
+		side = 0;
+	else
+		return a;
+
+	up = node->children[side];
+	if (sv_bvhnodes[sv_bvhnodes[up].children[0]].height > sv_bvhnodes[sv_bvhnodes[up].children[1]].height)
+	{
+		keep = sv_bvhnodes[up].children[0];
+		move = sv_bvhnodes[up].children[1];
+	}
+	else
+	{
+		keep = sv_bvhnodes[up].children[1];
+		move = sv_bvhnodes[up].children[0];
+	}
+
+	SV_BVHReplace (tree, node->parent, a, up);
+	sv_bvhnodes[up].children[0] = a;
+	sv_bvhnodes[up].children[1] = keep;
+	node->parent = up;
+	node->children[side] = move;
+	sv_bvhnodes[move].parent = a;
+
+	SV_BVHFit (a);
+	SV_BVHFit (up);
+	return up;
+}
+
+/*
+===============
+SV_BVHRefit
+
+Rotates and refits from n up to the root
+===============
+*/
+void SV_BVHRefit (int tree, int n)
+{
+	while (n != -1)
+	{
+		n = SV_BVHRotate (tree, n);
+		SV_BVHFit (n);
+		n = sv_bvhnodes[n].parent;
+	}
+}
+
+/*
+===============
+SV_BVHInsert
+===============
+*/
+void SV_BVHInsert (int tree, int leaf)
+{
+	bvhnode_t	*node, *l;
+	int			n, i, child, best, parent;
+	double		area, cost, inherit, c[2];
+
+	l = &sv_bvhnodes[leaf];
+	l->tree = tree;
+	if (sv_bvhroot[tree] == -1)
+	{
+		sv_bvhroot[tree] = leaf;
+		l->parent = -1;
+		return;
+	}
+
+// go down while it is cheaper to put the leaf lower
+	n = sv_bvhroot[tree];
+	while (sv_bvhnodes[n].children[0] != -1)
+	{
+		node = &sv_bvhnodes[n];
+		area = SV_BVHArea (node, NULL);
+		cost = 2 * SV_BVHArea (node, l);
+		inherit = cost - 2 * area;		// what going lower adds to the nodes above
+
+		for (i=0 ; i<2 ; i++)
+		{
+			child = node->children[i];
+			c[i] = SV_BVHArea (&sv_bvhnodes[child], l) + inherit;
+			if (sv_bvhnodes[child].children[0] != -1)
+				c[i] -= SV_BVHArea (&sv_bvhnodes[child], NULL);
+		}
+		if (cost < c[0] && cost < c[1])
+			break;
+		n = node->children[c[1] < c[0]];
+	}
+
+// a new parent for the leaf and the node it goes next to
+	best = sv_bvhfree;
+	if (best == -1)
+		Sys_Error ("SV_BVHInsert: no free nodes");
+	sv_bvhfree = sv_bvhnodes[best].parent;
+
+	parent = sv_bvhnodes[n].parent;
+	SV_BVHReplace (tree, parent, n, best);
+	sv_bvhnodes[best].children[0] = n;
+	sv_bvhnodes[best].children[1] = leaf;
+	sv_bvhnodes[best].ent = NULL;
+	sv_bvhnodes[n].parent = best;
+	l->parent = best;
+
+	SV_BVHRefit (tree, best);
+}
+
+/*
+===============
+SV_BVHRemove
+
+Takes a leaf out of its tree, and its parent with it
+===============
+*/
+void SV_BVHRemove (int leaf)
+{
+	bvhnode_t	*l;
+	int			parent, sibling, tree;
+
+	l = &sv_bvhnodes[leaf];
+	tree = l->tree;
+	if (sv_bvhroot[tree] == leaf)
+	{
+		sv_bvhroot[tree] = -1;
+		return;
+	}
+
+	parent = l->parent;
+	sibling = sv_bvhnodes[parent].children[sv_bvhnodes[parent].children[0] == leaf];
+	SV_BVHReplace (tree, sv_bvhnodes[parent].parent, parent, sibling);
+
+	sv_bvhnodes[parent].parent = sv_bvhfree;
+	sv_bvhfree = parent;
+
+	SV_BVHRefit (tree, sv_bvhnodes[sibling].parent);
+}
+
+/*
+===============
+SV_BVHUnlink
+===============
+*/
+void SV_BVHUnlink (edict_t *ent)
+{
+	int		num, leaf;
+
+	if (!sv_usebvh)
+		return;
+
+	num = NUM_FOR_EDICT(ent);
+	leaf = sv_bvhleaf[num];
+	if (leaf == -1)
+		return;
+
+	SV_BVHRemove (leaf);
+	sv_bvhnodes[leaf].parent = sv_bvhfree;
+	sv_bvhfree = leaf;
+	sv_bvhleaf[num] = -1;
+}
+
+/*
+===============
+SV_BVHLink
+
+Puts ent's abs box in the tree for its solid, unless the leaf it has is
+already there and still holds it closely enough
+===============
+*/
+void SV_BVHLink (edict_t *ent)
+{
+	vec3_t		mins, maxs;
+	bvhnode_t	*l;
+	int			num, leaf, tree, i;
+
+	tree = ent->v.solid == SOLID_TRIGGER ? BVH_TRIGGER : BVH_SOLID;
+
+// an inside out box is anything that reaches across it
+	for (i=0 ; i<3 ; i++)
+	{
+		if (IS_NAN(ent->v.absmin[i]) || IS_NAN(ent->v.absmax[i]))
+			break;
+		mins[i] = ent->v.absmin[i] < ent->v.absmax[i] ? ent->v.absmin[i] : ent->v.absmax[i];
+		maxs[i] = ent->v.absmin[i] < ent->v.absmax[i] ? ent->v.absmax[i] : ent->v.absmin[i];
+	}
+	if (i < 3)
+	{
+		for (i=0 ; i<3 ; i++)
+		{
+			mins[i] = -BVH_HUGE;
+			maxs[i] = BVH_HUGE;
+		}
+	}
+
+	num = NUM_FOR_EDICT(ent);
+	leaf = sv_bvhleaf[num];
+	if (leaf != -1)
+	{
+		l = &sv_bvhnodes[leaf];
+		if (l->tree == tree)
+		{
+			for (i=0 ; i<3 ; i++)
+			{
+				if (mins[i] < l->mins[i] || maxs[i] > l->maxs[i])
+					break;
+				if (mins[i] - l->mins[i] > BVH_SLACK || l->maxs[i] - maxs[i] > BVH_SLACK)
+					break;
+			}
+			if (i == 3)
+				return;
+		}
+		SV_BVHUnlink (ent);
+	}
+
+	leaf = sv_bvhfree;
+	if (leaf == -1)
+		Sys_Error ("SV_BVHLink: no free nodes");
+	l = &sv_bvhnodes[leaf];
+	sv_bvhfree = l->parent;
+
+	for (i=0 ; i<3 ; i++)
+	{
+		l->mins[i] = mins[i] - BVH_MARGIN;
+		l->maxs[i] = maxs[i] + BVH_MARGIN;
+	}
+	l->children[0] = l->children[1] = -1;
+	l->height = 0;
+	l->ent = ent;
+	sv_bvhleaf[num] = leaf;
+
+	SV_BVHInsert (tree, leaf);
+}
+
+/*
+===============
+SV_WalkBVH
+
+Calls visit for every entity in tree whose leaf touches the box, until it
+returns false.  Safe on the worker threads, as long as nothing is linked.
+===============
+*/
+void SV_WalkBVH (int tree, vec3_t mins, vec3_t maxs, bvhvisit_t visit, void *data)
+{
+	int			stack[BVH_STACK];
+	int			depth;
+	bvhnode_t	*node;
+
+	if (sv_bvhroot[tree] == -1)
+		return;
+	stack[0] = sv_bvhroot[tree];
+	depth = 1;
+
+	while (depth)
+	{
+		node = &sv_bvhnodes[stack[--depth]];
+		if (mins[0] > node->maxs[0]
+		|| mins[1] > node->maxs[1]
+		|| mins[2] > node->maxs[2]
+		|| maxs[0] < node->mins[0]
+		|| maxs[1] < node->mins[1]
+		|| maxs[2] < node->mins[2] )
+			continue;
+
+		if (node->children[0] == -1)
+		{
+			if (!visit (node->ent, data))
+				return;
+			continue;
+		}
+
+		if (depth + 2 > BVH_STACK)
+			Sys_Error ("SV_WalkBVH: tree too deep");
+		stack[depth++] = node->children[1];
+		stack[depth++] = node->children[0];
+	}
+}
+
+/*
+===============
+SV_CollectBVH
+
+A bvhvisit_t that adds to a bvhlist_t until it is full
+===============
+*/
+qboolean SV_CollectBVH (edict_t *ent, void *data)
+{
+	bvhlist_t	*list;
+
+	list = (bvhlist_t *)data;
+	if (list->count == list->max)
+	{
+		list->overflow = true;
+		return false;
+	}
+	list->ents[list->count++] = ent;
+	return true;
+}
+
+/*
+===============
+SV_SortBVH
+
+Fills ents with the entities in tree whose leaves touch the box, in edict
+order, and returns how many there are, or -1 if there are more than max
+===============
+*/
+int SV_SortBVH (edict_t **ents, int max, int tree, vec3_t mins, vec3_t maxs)
+{
+	bvhlist_t	list;
+
+	list.ents = ents;
+	list.count = 0;
+	list.max = max;
+	list.overflow = false;
+	SV_WalkBVH (tree, mins, maxs, SV_CollectBVH, &list);
+	if (list.overflow)
+		return -1;
+
+	qsort (ents, list.count, sizeof(edict_t *), SV_CompareEdicts);
+	return list.count;
+}
+/*
+===============================================================================
+
 ENTITY AREA CHECKING
 
 ===============================================================================
@@ -193,6 +727,66 @@ typedef struct areanode_s
 static	areanode_t	sv_areanodes[AREA_NODES];
 static	int			sv_numareanodes;
 
+static	edict_t		**sv_movededicts;	// may be out of place in the area nodes
+static	int			sv_nummoved;
+static	edict_t		**sv_radiusedicts;	// found by SV_FindRadius
+static	int			sv_numradius;
+static	edict_t		**sv_batchents;		// near a batch of moves
+static	bvhnode_t	**sv_batchleafs;	// their leaves, with the bvh
+static	int			sv_numbatchents;
+
+#define	MAX_LEAFROWS	256
+#define	LEAF_EPSILON	0.03125		// covers BoxOnPlaneSide rounding differently
+
+static	int			sv_leafbytes;		// in a leaf bitset of the world
+static	byte		*sv_leafscratch;	// filled by SV_FindTouchedLeafs, left clear
+static	int			sv_firstleafbyte, sv_lastleafbyte;	// set in sv_leafscratch
+static	float		sv_leafslack;		// least slack of the planes the box met
+static	byte		*sv_leafrows;		// MAX_LEAFROWS leaf bitsets
+static	int			*sv_leafowner;		// edict number using each row, -1 if none
+
+void SV_ClearMoved (edict_t *ent);
+void SV_ClearLeafs (edict_t *ent);
+
+typedef struct
+{
+	vec3_t		start, mins, maxs, end;
+	int			type;
+	edict_t		*passedict;
+	int			owner;			// passedict's, which the trace also depends on
+	float		size;			// passedict->v.size[0]
+	vec3_t		boxmins, boxmaxs;
+	qboolean	ok;
+	trace_t		trace;
+} specmove_t;
+
+typedef struct
+{
+	edict_t		*ent;
+	vec3_t		absmin, absmax;
+} specchange_t;
+
+typedef struct
+{
+	sysjob_t	job;
+	int			first, count;
+} specjob_t;
+
+#define	MAX_SPECCHANGES	4096
+#define	MAX_SPECJOBS	16
+
+static	qboolean	sv_speculating;		// between SV_RunSpeculation and SV_EndSpeculation
+static	specmove_t	*sv_specmoves;		// edict_limit long, made when first used
+static	int			sv_numspecmoves;
+static	int			*sv_specmove;		// place of each edict's move in sv_specmoves + 1
+static	specchange_t	sv_specchanges[MAX_SPECCHANGES];
+static	int			sv_numspecchanges;
+static	int			*sv_specchange;		// each edict's last change + 1
+static	qboolean	sv_specoverflow;	// too much changed to keep track of
+static	specjob_t	sv_specjobs[MAX_SPECJOBS];
+
+trace_t *SV_SpeculatedMove (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict);
+
 /*
 ===============
 SV_CreateAreaNode
@@ -246,31 +840,68 @@ SV_ClearWorld
 */
 void SV_ClearWorld (void)
 {
+	int		i;
+
 	SV_InitBoxHull ();
 	
 	memset (sv_areanodes, 0, sizeof(sv_areanodes));
 	sv_numareanodes = 0;
 	SV_CreateAreaNode (0, sv.worldmodel->mins, sv.worldmodel->maxs);
+
+	sv_movededicts = Hunk_AllocName (sv.edict_limit*sizeof(edict_t *), "moved");
+	sv_nummoved = 0;
+	sv_radiusedicts = Hunk_AllocName (sv.edict_limit*sizeof(edict_t *), "radius");
+	sv_batchents = Hunk_AllocName (sv.edict_limit*sizeof(edict_t *), "batch");
+	sv_batchleafs = Hunk_AllocName (sv.edict_limit*sizeof(bvhnode_t *), "batch");
+
+	sv_leafbytes = (sv.worldmodel->numleafs+7)>>3;
+	sv_leafscratch = Hunk_AllocName (sv_leafbytes, "leafs");
+	sv_leafrows = Hunk_AllocName (MAX_LEAFROWS*sv_leafbytes, "leafs");
+	sv_leafowner = Hunk_AllocName (MAX_LEAFROWS*sizeof(int), "leafs");
+	for (i=0 ; i<MAX_LEAFROWS ; i++)
+		sv_leafowner[i] = -1;
+
+	SV_ClearBVH ();
+
+	sv_speculating = false;
+	sv_specmoves = NULL;
+	sv_numspecmoves = 0;
+	sv_numspecchanges = 0;
 }
 
 
 /*
 ===============
-SV_UnlinkEdict
+SV_UnlinkArea
 
+Leaves ent's leaf in the bvh, for SV_LinkEdict to keep if it can
 ===============
 */
-void SV_UnlinkEdict (edict_t *ent)
+void SV_UnlinkArea (edict_t *ent)
 {
 	if (!ent->area.prev)
 		return;		// not linked in anywhere
+	SV_TraceChanged (ent);
 	RemoveLink (&ent->area);
 	ent->area.prev = ent->area.next = NULL;
 }
 
-
 /*
-====================
+===============
+SV_UnlinkEdict
+
+===============
+*/
+void SV_UnlinkEdict (edict_t *ent)
+{
+	SV_UnlinkArea (ent);
+	SV_BVHUnlink (ent);
+	SV_ClearLeafs (ent);
+}
+
+
+/*
+====================
 SV_TouchLinks
 ====================
 */
@@ -318,11 +949,149 @@ void SV_TouchLinks ( edict_t *ent, areanode_t *node )
 		SV_TouchLinks ( ent, node->children[1] );
 }
 
+/*
+====================
+SV_TouchBVH
+
+SV_TouchLinks for the bvh.  The triggers are all found before any of them
+run, so each is checked again before it does.
+====================
+*/
+void SV_TouchBVH (edict_t *ent)
+{
+	edict_t		**list, *touch;
+	int			count, i;
+	int			old_self, old_other;
+
+	list = sv_bvhlist + sv_numbvhlist;
+	count = SV_SortBVH (list, sv_bvhlistsize - sv_numbvhlist, BVH_TRIGGER,
+		ent->v.absmin, ent->v.absmax);
+	if (count < 0)
+		Sys_Error ("SV_TouchBVH: too many touches");
+	sv_numbvhlist += count;		// touches they run go after them
+
+	for (i=0 ; i<count ; i++)
+	{
+		touch = list[i];
+		if (touch == ent || !touch->area.prev)
+			continue;
+		if (!touch->v.touch || touch->v.solid != SOLID_TRIGGER)
+			continue;
+		if (ent->v.absmin[0] > touch->v.absmax[0]
+		|| ent->v.absmin[1] > touch->v.absmax[1]
+		|| ent->v.absmin[2] > touch->v.absmax[2]
+		|| ent->v.absmax[0] < touch->v.absmin[0]
+		|| ent->v.absmax[1] < touch->v.absmin[1]
+		|| ent->v.absmax[2] < touch->v.absmin[2] )
+			continue;
+		old_self = pr_global_struct->self;
+		old_other = pr_global_struct->other;
+
+		pr_global_struct->self = EDICT_TO_PROG(touch);
+		pr_global_struct->other = EDICT_TO_PROG(ent);
+		pr_global_struct->time = sv.time;
+		PR_ExecuteProgram (touch->v.touch);
+
+		pr_global_struct->self = old_self;
+		pr_global_struct->other = old_other;
+	}
+
+	sv_numbvhlist -= count;
+}
+
+
+/*
+===============================================================================
+
+PVS LEAFS
+
+Each edict keeps the leafs it touches as the set bytes of a leaf bitset, so
+the send loop tests it against a PVS with an and for each byte.  Up to
+ENT_LEAFBYTES of them are kept in the edict with their place in the bitset.
+More than that, a large door or a lift shaft, take a row of sv_leafrows,
+from the first set byte to the last.  If the rows run out, the edict is in
+every leaf until one is free; sending it too often is better than not
+sending it at all.
+
+The leafs only depend on which side of each node plane the box is, so
+nothing is walked again until a side of the box moves as far as the nearest
+of the planes it met.
+
+===============================================================================
+*/
+
+/*
+===============
+SV_ClearLeafs
+
+Gives up ent's row, and forgets its leafs
+===============
+*/
+void SV_ClearLeafs (edict_t *ent)
+{
+	int		row;
+
+	row = ent->leafrow - 1;
+	if (row >= 0 && row < MAX_LEAFROWS && sv_leafowner[row] == NUM_FOR_EDICT(ent))
+		sv_leafowner[row] = -1;
+
+	ent->leafrow = 0;
+	ent->numleafbytes = 0;
+	ent->leafslack = -1;
+}
+
+/*
+===============
+SV_PlaneSlack
+
+How far the sides of the box can move before it reaches plane, and
+BOX_ON_PLANE_SIDE could say something else
+===============
+*/
+float SV_PlaneSlack (vec3_t mins, vec3_t maxs, mplane_t *plane)
+{
+	double	dist1, dist2, length;
+	int		i;
+
+	if (plane->type < 3)
+	{
+		dist1 = maxs[plane->type] - plane->dist;
+		dist2 = mins[plane->type] - plane->dist;
+		length = 1;
+	}
+	else
+	{	// the corners BoxOnPlaneSide uses
+		dist1 = dist2 = -plane->dist;
+		length = 0;
+		for (i=0 ; i<3 ; i++)
+		{
+			if (plane->normal[i] < 0)
+			{
+				dist1 += plane->normal[i] * mins[i];
+				dist2 += plane->normal[i] * maxs[i];
+			}
+			else
+			{
+				dist1 += plane->normal[i] * maxs[i];
+				dist2 += plane->normal[i] * mins[i];
+			}
+			length += fabs (plane->normal[i]);
+		}
+	}
+
+	dist1 = fabs (dist1);
+	dist2 = fabs (dist2);
+	if (dist2 < dist1)
+		dist1 = dist2;
+
+	return dist1 / length - LEAF_EPSILON;
+}
 
 /*
 ===============
 SV_FindTouchedLeafs
 
+Sets the leafs ent's box touches in sv_leafscratch
 ===============
 */
 void SV_FindTouchedLeafs (edict_t *ent, mnode_t *node)
@@ -331,6 +1100,7 @@ void SV_FindTouchedLeafs (edict_t *ent, mnode_t *node)
 	mleaf_t		*leaf;
 	int			sides;
 	int			leafnum;
+	float		slack;
 
 	if (node->contents == CONTENTS_SOLID)
 		return;
@@ -339,14 +1109,14 @@ void SV_FindTouchedLeafs (edict_t *ent, mnode_t *node)
 
 	if ( node->contents < 0)
 	{
-		if (ent->num_leafs == MAX_ENT_LEAFS)
-			return;
-
 		leaf = (mleaf_t *)node;
 		leafnum = leaf - sv.worldmodel->leafs - 1;
 
-		ent->leafnums[ent->num_leafs] = leafnum;
-		ent->num_leafs++;			
+		sv_leafscratch[leafnum>>3] |= 1<<(leafnum&7);
+		if ((leafnum>>3) < sv_firstleafbyte)
+			sv_firstleafbyte = leafnum>>3;
+		if ((leafnum>>3) > sv_lastleafbyte)
+			sv_lastleafbyte = leafnum>>3;
 		return;
 	}
 	
@@ -354,6 +1124,10 @@ void SV_FindTouchedLeafs (edict_t *ent, mnode_t *node)
 
 	splitplane = node->plane;
 	sides = BOX_ON_PLANE_SIDE(ent->v.absmin, ent->v.absmax, splitplane);
+
+	slack = SV_PlaneSlack (ent->v.absmin, ent->v.absmax, splitplane);
+	if (slack < sv_leafslack)
+		sv_leafslack = slack;
 	
 // recurse down the contacted sides
 	if (sides & 1)
@@ -363,6 +1137,125 @@ void SV_FindTouchedLeafs (edict_t *ent, mnode_t *node)
 		SV_FindTouchedLeafs (ent, node->children[1]);
 }
 
+/*
+===============
+SV_LinkLeafs
+
+Finds the leafs for ent's new absmin and absmax, if they could have changed
+===============
+*/
+void SV_LinkLeafs (edict_t *ent)
+{
+	byte	*bits;
+	int		i, count, row, num;
+
+	if (!ent->v.modelindex)
+	{
+		SV_ClearLeafs (ent);
+		return;
+	}
+
+// written so a NaN anywhere finds them again
+	for (i=0 ; i<3 ; i++)
+	{
+		if (!(fabs (ent->v.absmin[i] - ent->leafmins[i]) < ent->leafslack))
+			break;
+		if (!(fabs (ent->v.absmax[i] - ent->leafmaxs[i]) < ent->leafslack))
+			break;
+	}
+	if (i == 3)
+		return;		// still on the same side of every plane
+
+	sv_firstleafbyte = sv_leafbytes;
+	sv_lastleafbyte = -1;
+	sv_leafslack = BVH_HUGE;
+	SV_FindTouchedLeafs (ent, sv.worldmodel->nodes);
+
+	VectorCopy (ent->v.absmin, ent->leafmins);
+	VectorCopy (ent->v.absmax, ent->leafmaxs);
+	ent->leafslack = sv_leafslack;
+
+	count = 0;
+	for (i=sv_firstleafbyte ; i<=sv_lastleafbyte ; i++)
+		if (sv_leafscratch[i])
+			count++;
+
+	num = NUM_FOR_EDICT(ent);
+	row = ent->leafrow - 1;
+	if (row >= 0 && (row >= MAX_LEAFROWS || sv_leafowner[row] != num))
+		row = -1;		// not really its own
+
+	if (count <= ENT_LEAFBYTES)
+	{	// fits in the edict
+		if (row >= 0)
+			sv_leafowner[row] = -1;
+		ent->leafrow = 0;
+		ent->numleafbytes = 0;
+		for (i=sv_firstleafbyte ; i<=sv_lastleafbyte ; i++)
+		{
+			if (!sv_leafscratch[i])
+				continue;
+			ent->leafbyte[ent->numleafbytes] = i;
+			ent->leafbits[ent->numleafbytes] = sv_leafscratch[i];
+			ent->numleafbytes++;
+			sv_leafscratch[i] = 0;
+		}
+		return;
+	}
+
+	if (row < 0)
+	{
+		for (row=0 ; row<MAX_LEAFROWS ; row++)
+			if (sv_leafowner[row] == -1)
+				break;
+		if (row == MAX_LEAFROWS)
+		{	// try again next time
+			ent->leafrow = 0;
+			ent->numleafbytes = -1;
+			ent->leafslack = -1;
+			memset (sv_leafscratch + sv_firstleafbyte, 0, sv_lastleafbyte - sv_firstleafbyte + 1);
+			return;
+		}
+		sv_leafowner[row] = num;
+	}
+
+	ent->leafrow = row + 1;
+	ent->firstleafbyte = sv_firstleafbyte;
+	ent->numleafbytes = sv_lastleafbyte - sv_firstleafbyte + 1;
+	bits = sv_leafrows + row*sv_leafbytes;
+	memcpy (bits + ent->firstleafbyte, sv_leafscratch + ent->firstleafbyte, ent->numleafbytes);
+	memset (sv_leafscratch + ent->firstleafbyte, 0, ent->numleafbytes);
+}
+
+/*
+===============
+SV_LeafsVisible
+===============
+*/
+qboolean SV_LeafsVisible (edict_t *ent, byte *pvs)
+{
+	byte	*bits;
+	int		i;
+
+	if (ent->numleafbytes < 0)
+		return true;
+
+	if (ent->leafrow)
+	{
+		bits = sv_leafrows + (ent->leafrow-1)*sv_leafbytes + ent->firstleafbyte;
+		pvs += ent->firstleafbyte;
+		for (i=0 ; i<ent->numleafbytes ; i++)
+			if (bits[i] & pvs[i])
+				return true;
+		return false;
+	}
+
+	for (i=0 ; i<ent->numleafbytes ; i++)
+		if (pvs[ent->leafbyte[i]] & ent->leafbits[i])
+			return true;
+	return false;
+}
+
 /*
 ===============
 SV_LinkEdict
@@ -372,15 +1265,20 @@ SV_LinkEdict
 void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 {
 	areanode_t	*node;
+	float		center;
+	int			i;
 
 	if (ent->area.prev)
-		SV_UnlinkEdict (ent);	// unlink from old position
+		SV_UnlinkArea (ent);	// unlink from old position
 		
 	if (ent == sv.edicts)
 		return;		// don't add the world
 
 	if (ent->free)
+	{
+		SV_BVHUnlink (ent);
 		return;
+	}
 
 // set the abs box
 
@@ -437,275 +1335,548 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 	}
 	
 // link to PVS leafs
-	ent->num_leafs = 0;
-	if (ent->v.modelindex)
-		SV_FindTouchedLeafs (ent, sv.worldmodel->nodes);
+	SV_LinkLeafs (ent);
 
 	if (ent->v.solid == SOLID_NOT)
+	{
+		SV_BVHUnlink (ent);
+		SV_ClearMoved (ent);
 		return;
+	}
 
-// find the first node that the ent's box crosses
-	node = sv_areanodes;
-	while (1)
+	if (sv_usebvh)
 	{
-		if (node->axis == -1)
-			break;
-		if (ent->v.absmin[node->axis] > node->dist)
-			node = node->children[0];
-		else if (ent->v.absmax[node->axis] < node->dist)
-			node = node->children[1];
-		else
-			break;		// crosses the node
+		InsertLinkBefore (&ent->area, &sv_bvhlinked);
+		SV_BVHLink (ent);
 	}
+	else
+	{
+	// find the first node that the ent's box crosses
+		node = sv_areanodes;
+		while (1)
+		{
+			if (node->axis == -1)
+				break;
+			if (ent->v.absmin[node->axis] > node->dist)
+				node = node->children[0];
+			else if (ent->v.absmax[node->axis] < node->dist)
+				node = node->children[1];
+			else
+				break;		// crosses the node
+		}
 	
-// link it in	
+	// link it in	
 
-	if (ent->v.solid == SOLID_TRIGGER)
-		InsertLinkBefore (&ent->area, &node->trigger_edicts);
-	else
-		InsertLinkBefore (&ent->area, &node->solid_edicts);
+		if (ent->v.solid == SOLID_TRIGGER)
+			InsertLinkBefore (&ent->area, &node->trigger_edicts);
+		else
+			InsertLinkBefore (&ent->area, &node->solid_edicts);
+	}
+	SV_TraceChanged (ent);
+
+// SV_FindRadius looks for the center of the box, which is only where the
+// node says if the box isn't inside out
+	SV_ClearMoved (ent);
+	for (i=0 ; i<3 ; i++)
+	{
+		center = ent->v.origin[i] + (ent->v.mins[i] + ent->v.maxs[i])*0.5;
+		if (!(center >= ent->v.absmin[i] && center <= ent->v.absmax[i]))
+			SV_EdictMoved (ent);
+	}
 	
 // if touch_triggers, touch all entities at this node and decend for more
 	if (touch_triggers)
-		SV_TouchLinks ( ent, sv_areanodes );
+	{
+		if (sv_usebvh)
+			SV_TouchBVH (ent);
+		else
+			SV_TouchLinks ( ent, sv_areanodes );
+	}
 }
 
 
-
 /*
-===============================================================================
-
-POINT TESTING IN HULLS
+===============
+SV_EdictMoved
 
-===============================================================================
+ent's origin, size or solid has changed since it was last linked, so it may
+not be in the area node it is linked to.  Called for every progs write to
+those fields, and by the physics code where a touch or blocked function can
+run before the entity is linked again.
+===============
 */
+void SV_EdictMoved (edict_t *ent)
+{
+	SV_TraceChanged (ent);
 
-#if	!id386
+	if (ent->moved || ent == sv.edicts)
+		return;
+
+	sv_movededicts[sv_nummoved++] = ent;
+	ent->moved = sv_nummoved;
+}
 
 /*
-==================
-SV_HullPointContents
+===============
+SV_ClearMoved
 
-==================
+Takes ent off the moved list, filling its place with the last one
+===============
 */
-int SV_HullPointContents (hull_t *hull, int num, vec3_t p)
+void SV_ClearMoved (edict_t *ent)
 {
-	float		d;
-	dclipnode_t	*node;
-	mplane_t	*plane;
-
-	while (num >= 0)
-	{
-		if (num < hull->firstclipnode || num > hull->lastclipnode)
-			Sys_Error ("SV_HullPointContents: bad node number");
-	
-		node = hull->clipnodes + num;
-		plane = hull->planes + node->planenum;
-		
-		if (plane->type < 3)
-			d = p[plane->type] - plane->dist;
-		else
-			d = DotProduct (plane->normal, p) - plane->dist;
-		if (d < 0)
-			num = node->children[1];
-		else
-			num = node->children[0];
-	}
-	
-	return num;
-}
+	edict_t	*last;
 
-#endif	// !id386
+	if (!ent->moved)
+		return;
 
+	last = sv_movededicts[--sv_nummoved];
+	sv_movededicts[ent->moved - 1] = last;
+	last->moved = ent->moved;
+	ent->moved = 0;
+}
 
 /*
-==================
-SV_PointContents
+===============
+SV_RadiusCheck
 
-==================
+The findradius test, as the progs have always seen it
+===============
 */
-int SV_PointContents (vec3_t p)
+void SV_RadiusCheck (edict_t *ent, float *org, float rad)
 {
-	int		cont;
+	vec3_t	eorg;
+	int		j;
 
-	cont = SV_HullPointContents (&sv.worldmodel->hulls[0], 0, p);
-	if (cont <= CONTENTS_CURRENT_0 && cont >= CONTENTS_CURRENT_DOWN)
-		cont = CONTENTS_WATER;
-	return cont;
-}
+	if (ent->free)
+		return;
+	if (ent->v.solid == SOLID_NOT)
+		return;
+	for (j=0 ; j<3 ; j++)
+		eorg[j] = org[j] - (ent->v.origin[j] + (ent->v.mins[j] + ent->v.maxs[j])*0.5);
+	if (Length(eorg) > rad)
+		return;
 
-int SV_TruePointContents (vec3_t p)
-{
-	return SV_HullPointContents (&sv.worldmodel->hulls[0], 0, p);
+	sv_radiusedicts[sv_numradius++] = ent;
 }
 
-//===========================================================================
-
 /*
-============
-SV_TestEntityPosition
+===============
+SV_AreaRadius
 
-This could be a lot more efficient...
-============
+Checks the entities linked in every node the box crosses
+===============
 */
-edict_t	*SV_TestEntityPosition (edict_t *ent)
+void SV_AreaRadius (areanode_t *node, vec3_t mins, vec3_t maxs, float *org, float rad)
 {
-	trace_t	trace;
+	link_t		*l;
+	edict_t		*ent;
 
-	trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, ent->v.origin, 0, ent);
-	
-	if (trace.startsolid)
-		return sv.edicts;
-		
-	return NULL;
-}
+	for (l = node->solid_edicts.next ; l != &node->solid_edicts ; l = l->next)
+	{
+		ent = EDICT_FROM_AREA(l);
+		if (!ent->moved)
+			SV_RadiusCheck (ent, org, rad);
+	}
+	for (l = node->trigger_edicts.next ; l != &node->trigger_edicts ; l = l->next)
+	{
+		ent = EDICT_FROM_AREA(l);
+		if (!ent->moved)
+			SV_RadiusCheck (ent, org, rad);
+	}
+
+	if (node->axis == -1)
+		return;
 
+	if (maxs[node->axis] > node->dist)
+		SV_AreaRadius (node->children[0], mins, maxs, org, rad);
+	if (mins[node->axis] < node->dist)
+		SV_AreaRadius (node->children[1], mins, maxs, org, rad);
+}
 
 /*
-===============================================================================
-
-LINE TESTING IN HULLS
+===============
+SV_RadiusBVH
 
-===============================================================================
+A bvhvisit_t for SV_FindRadius, with the origin and radius in data
+===============
 */
+qboolean SV_RadiusBVH (edict_t *ent, void *data)
+{
+	float	*org;
 
-// 1/32 epsilon to keep floating point happy
-#define	DIST_EPSILON	(0.03125)
+	org = (float *)data;
+	if (!ent->moved)
+		SV_RadiusCheck (ent, org, org[3]);
+	return true;
+}
 
 /*
-==================
-SV_RecursiveHullCheck
-
-==================
+===============
+SV_CompareEdicts
+===============
 */
-qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace)
+int SV_CompareEdicts (const void *a, const void *b)
 {
-	dclipnode_t	*node;
-	mplane_t	*plane;
-	float		t1, t2;
-	float		frac;
-	int			i;
-	vec3_t		mid;
-	int			side;
-	float		midf;
+	edict_t	*ea, *eb;
+
+	ea = *(edict_t **)a;
+	eb = *(edict_t **)b;
+	if (ea < eb)
+		return -1;
+	if (ea > eb)
+		return 1;
+	return 0;
+}
+
+/*
+===============
+SV_FindRadius
+
+Returns the chain of entities whose centers are within rad of org, the
+highest numbered first, for PF_findradius.  Only the area nodes or bvh
+leaves near org are searched, along with the entities that have moved since they were
+linked.
+===============
+*/
+edict_t *SV_FindRadius (float *org, float rad)
+{
+	edict_t	*ent, *chain;
+	vec3_t	mins, maxs;
+	float	orgrad[4];
+	float	r;
+	int		i;
+
+	sv_numradius = 0;
 
-// check for empty
-	if (num < 0)
+	if (IS_NAN(rad) || IS_NAN(org[0]) || IS_NAN(org[1]) || IS_NAN(org[2])
+	|| rad > 1e30)
+	{	// everything passes a NaN test, and a huge radius can make a NaN box
+		ent = NEXT_EDICT(sv.edicts);
+		for (i=1 ; i<sv.num_edicts ; i++, ent = NEXT_EDICT(ent))
+			SV_RadiusCheck (ent, org, rad);
+	}
+	else
 	{
-		if (num != CONTENTS_SOLID)
+	// a little extra for rounding in the distance test
+		r = rad + 1 + rad*(1.0/4096);
+		for (i=0 ; i<3 ; i++)
 		{
-			trace->allsolid = false;
-			if (num == CONTENTS_EMPTY)
-				trace->inopen = true;
-			else
-				trace->inwater = true;
+			mins[i] = org[i] - r;
+			maxs[i] = org[i] + r;
+		}
+		if (sv_usebvh)
+		{
+			VectorCopy (org, orgrad);
+			orgrad[3] = rad;
+			SV_WalkBVH (BVH_SOLID, mins, maxs, SV_RadiusBVH, orgrad);
+			SV_WalkBVH (BVH_TRIGGER, mins, maxs, SV_RadiusBVH, orgrad);
 		}
 		else
-			trace->startsolid = true;
-		return true;		// empty
-	}
+			SV_AreaRadius (sv_areanodes, mins, maxs, org, rad);
 
-	if (num < hull->firstclipnode || num > hull->lastclipnode)
-		Sys_Error ("SV_RecursiveHullCheck: bad node number");
+	// backwards, so the ones cleared are replaced by ones already checked
+		for (i=sv_nummoved-1 ; i>=0 ; i--)
+		{
+			ent = sv_movededicts[i];
+			if (ent->free || ent->v.solid == SOLID_NOT)
+				SV_ClearMoved (ent);	// anything bringing it back marks it again
+			else
+				SV_RadiusCheck (ent, org, rad);
+		}
 
-//
-// find the point distances
-//
-	node = hull->clipnodes + num;
-	plane = hull->planes + node->planenum;
+		qsort (sv_radiusedicts, sv_numradius, sizeof(edict_t *), SV_CompareEdicts);
+	}
 
-	if (plane->type < 3)
+	chain = (edict_t *)sv.edicts;
+	for (i=0 ; i<sv_numradius ; i++)
 	{
-		t1 = p1[plane->type] - plane->dist;
-		t2 = p2[plane->type] - plane->dist;
+		ent = sv_radiusedicts[i];
+		ent->v.chain = EDICT_TO_PROG(chain);
+		chain = ent;
 	}
-	else
+
+	return chain;
+}
+
+
+/*
+===============================================================================
+
+POINT TESTING IN HULLS
+
+===============================================================================
+*/
+
+#if	!id386
+
+/*
+==================
+SV_HullPointContents
+
+==================
+*/
+int SV_HullPointContents (hull_t *hull, int num, vec3_t p)
+{
+	float		d;
+	mclipnode_t	*node;
+
+	while (num >= 0)
 	{
-		t1 = DotProduct (plane->normal, p1) - plane->dist;
-		t2 = DotProduct (plane->normal, p2) - plane->dist;
+		if (num < hull->firstclipnode || num > hull->lastclipnode)
+			Sys_Error ("SV_HullPointContents: bad node number");
+	
+		node = hull->nodes + num;
+		
+		if (node->type < 3)
+			d = p[node->type] - node->dist;
+		else
+			d = DotProduct (node->normal, p) - node->dist;
+		if (d < 0)
+			num = node->children[1];
+		else
+			num = node->children[0];
 	}
 	
-#if 1
-	if (t1 >= 0 && t2 >= 0)
-		return SV_RecursiveHullCheck (hull, node->children[0], p1f, p2f, p1, p2, trace);
-	if (t1 < 0 && t2 < 0)
-		return SV_RecursiveHullCheck (hull, node->children[1], p1f, p2f, p1, p2, trace);
-#else
-	if ( (t1 >= DIST_EPSILON && t2 >= DIST_EPSILON) || (t2 > t1 && t1 >= 0) )
-		return SV_RecursiveHullCheck (hull, node->children[0], p1f, p2f, p1, p2, trace);
-	if ( (t1 <= -DIST_EPSILON && t2 <= -DIST_EPSILON) || (t2 < t1 && t1 <= 0) )
-		return SV_RecursiveHullCheck (hull, node->children[1], p1f, p2f, p1, p2, trace);
-#endif
+	return num;
+}
 
-// put the crosspoint DIST_EPSILON pixels on the near side
-	if (t1 < 0)
-		frac = (t1 + DIST_EPSILON)/(t1-t2);
-	else
-		frac = (t1 - DIST_EPSILON)/(t1-t2);
-	if (frac < 0)
-		frac = 0;
-	if (frac > 1)
-		frac = 1;
+#endif	// !id386
+
+
+/*
+==================
+SV_PointContents
+
+==================
+*/
+int SV_PointContents (vec3_t p)
+{
+	int		cont;
+
+	cont = SV_HullPointContents (&sv.worldmodel->hulls[0], 0, p);
+	if (cont <= CONTENTS_CURRENT_0 && cont >= CONTENTS_CURRENT_DOWN)
+		cont = CONTENTS_WATER;
+	return cont;
+}
+
+int SV_TruePointContents (vec3_t p)
+{
+	return SV_HullPointContents (&sv.worldmodel->hulls[0], 0, p);
+}
+
+//===========================================================================
+
+/*
+============
+SV_TestEntityPosition
+
+This could be a lot more efficient...
+============
+*/
+edict_t	*SV_TestEntityPosition (edict_t *ent)
+{
+	trace_t	trace;
+
+	trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, ent->v.origin, 0, ent);
+	
+	if (trace.startsolid)
+		return sv.edicts;
 		
-	midf = p1f + (p2f - p1f)*frac;
-	for (i=0 ; i<3 ; i++)
-		mid[i] = p1[i] + frac*(p2[i] - p1[i]);
+	return NULL;
+}
 
-	side = (t1 < 0);
 
-// move up to the node
-	if (!SV_RecursiveHullCheck (hull, node->children[side], p1f, midf, p1, mid, trace) )
-		return false;
+/*
+===============================================================================
 
-#ifdef PARANOID
-	if (SV_HullPointContents (sv_hullmodel, mid, node->children[side])
-	== CONTENTS_SOLID)
+LINE TESTING IN HULLS
+
+===============================================================================
+*/
+
+// 1/32 epsilon to keep floating point happy
+#define	DIST_EPSILON	(0.03125)
+
+/*
+==================
+SV_RecursiveHullCheck
+
+No longer recursive: the nodes the move crosses are kept on a stack, and
+only a tree deeper than the stack recurses.  Each crossing is handled the
+way the recursive version did it, so the trace comes out the same.
+==================
+*/
+typedef struct
+{
+	int			num;			// the node crossed
+	int			side;			// of the node p1 is on
+	float		frac;
+	float		midf;
+	vec3_t		mid;			// where the move crosses the node
+	float		p1f, p2f;
+	vec3_t		p1, p2;
+} hullstep_t;
+
+#define	MAX_HULLSTEPS	64
+
+qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace)
+{
+	hullstep_t	steps[MAX_HULLSTEPS];
+	hullstep_t	deep;
+	hullstep_t	*step;
+	int			depth;
+	mclipnode_t	*node;
+	float		t1, t2;
+	vec3_t		start, end;
+	int			i;
+
+	VectorCopy (p1, start);
+	VectorCopy (p2, end);
+	depth = 0;
+	step = NULL;
+
+	while (1)
 	{
-		Con_Printf ("mid PointInHullSolid\n");
-		return false;
+		if (step)
+		{	// back from the near side of the node step crosses
+			num = hull->nodes[step->num].children[step->side^1];
+			if (SV_HullPointContents (hull, num, step->mid) != CONTENTS_SOLID)
+			{	// go past the node
+				p1f = step->midf;
+				p2f = step->p2f;
+				VectorCopy (step->mid, start);
+				VectorCopy (step->p2, end);
+				step = NULL;
+				continue;
+			}
+			break;
+		}
+
+	// check for empty
+		if (num < 0)
+		{
+			if (num != CONTENTS_SOLID)
+			{
+				trace->allsolid = false;
+				if (num == CONTENTS_EMPTY)
+					trace->inopen = true;
+				else
+					trace->inwater = true;
+			}
+			else
+				trace->startsolid = true;
+
+			if (!depth)
+				return true;		// empty
+			step = &steps[--depth];
+			continue;
+		}
+
+		if (num < hull->firstclipnode || num > hull->lastclipnode)
+			Sys_Error ("SV_RecursiveHullCheck: bad node number");
+
+	//
+	// find the point distances
+	//
+		node = hull->nodes + num;
+
+		if (node->type < 3)
+		{
+			t1 = start[node->type] - node->dist;
+			t2 = end[node->type] - node->dist;
+		}
+		else
+		{
+			t1 = DotProduct (node->normal, start) - node->dist;
+			t2 = DotProduct (node->normal, end) - node->dist;
+		}
+
+		if (t1 >= 0 && t2 >= 0)
+		{
+			num = node->children[0];
+			continue;
+		}
+		if (t1 < 0 && t2 < 0)
+		{
+			num = node->children[1];
+			continue;
+		}
+
+		if (depth == MAX_HULLSTEPS)
+			step = &deep;
+		else
+			step = &steps[depth++];
+		step->num = num;
+		step->p1f = p1f;
+		step->p2f = p2f;
+		VectorCopy (start, step->p1);
+		VectorCopy (end, step->p2);
+
+	// put the crosspoint DIST_EPSILON pixels on the near side
+		if (t1 < 0)
+			step->frac = (t1 + DIST_EPSILON)/(t1-t2);
+		else
+			step->frac = (t1 - DIST_EPSILON)/(t1-t2);
+		if (step->frac < 0)
+			step->frac = 0;
+		if (step->frac > 1)
+			step->frac = 1;
+		
+		step->midf = p1f + (p2f - p1f)*step->frac;
+		for (i=0 ; i<3 ; i++)
+			step->mid[i] = start[i] + step->frac*(end[i] - start[i]);
+
+		step->side = (t1 < 0);
+
+	// move up to the node
+		num = node->children[step->side];
+		if (step == &deep)
+		{	// out of steps, so the near side gets a stack of its own
+			if (!SV_RecursiveHullCheck (hull, num, p1f, step->midf, start, step->mid, trace))
+				return false;
+			continue;
+		}
+		p2f = step->midf;
+		VectorCopy (step->mid, end);
+		step = NULL;
 	}
-#endif
-	
-	if (SV_HullPointContents (hull, node->children[side^1], mid)
-	!= CONTENTS_SOLID)
-// go past the node
-		return SV_RecursiveHullCheck (hull, node->children[side^1], midf, p2f, mid, p2, trace);
-	
+
+// the other side of the node is solid, this is the impact point
 	if (trace->allsolid)
 		return false;		// never got out of the solid area
-		
-//==================
-// the other side of the node is solid, this is the impact point
-//==================
-	if (!side)
+
+	node = hull->nodes + step->num;
+	if (!step->side)
 	{
-		VectorCopy (plane->normal, trace->plane.normal);
-		trace->plane.dist = plane->dist;
+		VectorCopy (node->normal, trace->plane.normal);
+		trace->plane.dist = node->dist;
 	}
 	else
 	{
-		VectorSubtract (vec3_origin, plane->normal, trace->plane.normal);
-		trace->plane.dist = -plane->dist;
+		VectorSubtract (vec3_origin, node->normal, trace->plane.normal);
+		trace->plane.dist = -node->dist;
 	}
 
-	while (SV_HullPointContents (hull, hull->firstclipnode, mid)
+	while (SV_HullPointContents (hull, hull->firstclipnode, step->mid)
 	== CONTENTS_SOLID)
 	{ // shouldn't really happen, but does occasionally
-		frac -= 0.1f;
-		if (frac < 0)
+		step->frac -= 0.1f;
+		if (step->frac < 0)
 		{
-			trace->fraction = midf;
-			VectorCopy (mid, trace->endpos);
-			Con_DPrintf ("backup past 0\n");
+			trace->fraction = step->midf;
+			VectorCopy (step->mid, trace->endpos);
+			if (!trace->quiet)
+				Con_DPrintf ("backup past 0\n");
 			return false;
 		}
-		midf = p1f + (p2f - p1f)*frac;
+		step->midf = step->p1f + (step->p2f - step->p1f)*step->frac;
 		for (i=0 ; i<3 ; i++)
-			mid[i] = p1[i] + frac*(p2[i] - p1[i]);
+			step->mid[i] = step->p1[i] + step->frac*(step->p2[i] - step->p1[i]);
 	}
 
-	trace->fraction = midf;
-	VectorCopy (mid, trace->endpos);
+	trace->fraction = step->midf;
+	VectorCopy (step->mid, trace->endpos);
 
 	return false;
 }
@@ -716,24 +1887,27 @@ qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec
 SV_ClipMoveToEntity
 
 Handles selection or creation of a clipping hull, and offseting (and
-eventually rotation) of the end points
+eventually rotation) of the end points.  Quiet traces run on the workers,
+where the console can't be touched.
 ==================
 */
-trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end)
+trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, qboolean quiet)
 {
 	trace_t		trace;
 	vec3_t		offset;
 	vec3_t		start_l, end_l;
 	hull_t		*hull;
+	boxhull_t	box;
 
 // fill in a default trace
 	memset (&trace, 0, sizeof(trace_t));
 	trace.fraction = 1;
 	trace.allsolid = true;
+	trace.quiet = quiet;
 	VectorCopy (end, trace.endpos);
 
 // get the clipping hull
-	hull = SV_HullForEntity (ent, mins, maxs, offset);
+	hull = SV_HullForEntity (ent, mins, maxs, offset, &box);
 
 	VectorSubtract (start, offset, start_l);
 	VectorSubtract (end, offset, end_l);
@@ -763,6 +1937,7 @@ trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t max
 
 // trace a line through the apropriate clipping hull
 	SV_RecursiveHullCheck (hull, hull->firstclipnode, 0, 1, start_l, end_l, &trace);
+	trace.quiet = false;	// so it matches the same trace made anywhere else
 
 #ifdef QUAKE2
 	// rotate endpos back to world frame of reference
@@ -802,95 +1977,192 @@ trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t max
 	return trace;
 }
 
+/*
+==================
+SV_CanClip
+
+False if clipping against ent would stop with an error
+==================
+*/
+qboolean SV_CanClip (edict_t *ent)
+{
+	int		modelindex;
+	model_t	*model;
+
+	if (ent->v.solid == SOLID_TRIGGER)
+		return false;
+	if (ent->v.solid != SOLID_BSP)
+		return true;
+	if (ent->v.movetype != MOVETYPE_PUSH)
+		return false;
+
+	modelindex = (int)ent->v.modelindex;
+	if (modelindex < 0 || modelindex >= MAX_MODELS)
+		return false;
+	model = sv.models[modelindex];
+	return model && model->type == mod_brush;
+}
+
 //===========================================================================
 
 /*
 ====================
-SV_ClipToLinks
+SV_ClipToEdict
 
-Mins and maxs enclose the entire area swept by the move
+Returns false once nothing else needs to be clipped against
 ====================
 */
-void SV_ClipToLinks ( areanode_t *node, moveclip_t *clip )
+qboolean SV_ClipToEdict (edict_t *touch, moveclip_t *clip)
 {
-	link_t		*l, *next;
-	edict_t		*touch;
 	trace_t		trace;
 
-// touch linked edicts
-	for (l = node->solid_edicts.next ; l != &node->solid_edicts ; l = next)
+	if (touch->v.solid == SOLID_NOT)
+		return true;
+	if (touch == clip->passedict)
+		return true;
+	if (clip->speculative && !SV_CanClip (touch))
 	{
-		next = l->next;
-		touch = EDICT_FROM_AREA(l);
-		if (touch->v.solid == SOLID_NOT)
-			continue;
-		if (touch == clip->passedict)
-			continue;
-		if (touch->v.solid == SOLID_TRIGGER)
-			Sys_Error ("Trigger in clipping list");
+		clip->failed = true;	// leave the error to the main thread
+		return false;
+	}
+	if (touch->v.solid == SOLID_TRIGGER)
+		Sys_Error ("Trigger in clipping list");
 
-		if (clip->type == MOVE_NOMONSTERS && touch->v.solid != SOLID_BSP)
-			continue;
+	if (clip->type == MOVE_NOMONSTERS && touch->v.solid != SOLID_BSP)
+		return true;
 
-		if (clip->boxmins[0] > touch->v.absmax[0]
-		|| clip->boxmins[1] > touch->v.absmax[1]
-		|| clip->boxmins[2] > touch->v.absmax[2]
-		|| clip->boxmaxs[0] < touch->v.absmin[0]
-		|| clip->boxmaxs[1] < touch->v.absmin[1]
-		|| clip->boxmaxs[2] < touch->v.absmin[2] )
-			continue;
+	if (clip->boxmins[0] > touch->v.absmax[0]
+	|| clip->boxmins[1] > touch->v.absmax[1]
+	|| clip->boxmins[2] > touch->v.absmax[2]
+	|| clip->boxmaxs[0] < touch->v.absmin[0]
+	|| clip->boxmaxs[1] < touch->v.absmin[1]
+	|| clip->boxmaxs[2] < touch->v.absmin[2] )
+		return true;
 
-		if (clip->passedict && clip->passedict->v.size[0] && !touch->v.size[0])
-			continue;	// points never interact
+	if (clip->passedict && clip->passedict->v.size[0] && !touch->v.size[0])
+		return true;	// points never interact
 
-	// might intersect, so do an exact clip
-		if (clip->trace.allsolid)
-			return;
-		if (clip->passedict)
-		{
-		 	if (PROG_TO_EDICT(touch->v.owner) == clip->passedict)
-				continue;	// don't clip against own missiles
-			if (PROG_TO_EDICT(clip->passedict->v.owner) == touch)
-				continue;	// don't clip against owner
-		}
+// might intersect, so do an exact clip
+	if (clip->trace.allsolid)
+		return false;
+	if (clip->passedict)
+	{
+	 	if (PROG_TO_EDICT(touch->v.owner) == clip->passedict)
+			return true;	// don't clip against own missiles
+		if (PROG_TO_EDICT(clip->passedict->v.owner) == touch)
+			return true;	// don't clip against owner
+	}
 
-		if ((int)touch->v.flags & FL_MONSTER)
-			trace = SV_ClipMoveToEntity (touch, clip->start, clip->mins2, clip->maxs2, clip->end);
-		else
-			trace = SV_ClipMoveToEntity (touch, clip->start, clip->mins, clip->maxs, clip->end);
-		if (trace.allsolid || trace.startsolid ||
-		trace.fraction < clip->trace.fraction)
+	if ((int)touch->v.flags & FL_MONSTER)
+		trace = SV_ClipMoveToEntity (touch, clip->start, clip->mins2, clip->maxs2, clip->end, clip->speculative);
+	else
+		trace = SV_ClipMoveToEntity (touch, clip->start, clip->mins, clip->maxs, clip->end, clip->speculative);
+	if (trace.allsolid || trace.startsolid ||
+	trace.fraction < clip->trace.fraction)
+	{
+		trace.ent = touch;
+	 	if (clip->trace.startsolid)
 		{
-			trace.ent = touch;
-		 	if (clip->trace.startsolid)
-			{
-				clip->trace = trace;
-				clip->trace.startsolid = true;
-			}
-			else
-				clip->trace = trace;
-		}
-		else if (trace.startsolid)
+			clip->trace = trace;
 			clip->trace.startsolid = true;
+		}
+		else
+			clip->trace = trace;
 	}
-	
-// recurse down both sides
-	if (node->axis == -1)
-		return;
+	else if (trace.startsolid)
+		clip->trace.startsolid = true;
 
-	if ( clip->boxmaxs[node->axis] > node->dist )
-		SV_ClipToLinks ( node->children[0], clip );
-	if ( clip->boxmins[node->axis] < node->dist )
-		SV_ClipToLinks ( node->children[1], clip );
+	return true;
 }
 
-
 /*
-==================
-SV_MoveBounds
-==================
+====================
+SV_ClipToLinks
+
+Mins and maxs enclose the entire area swept by the move
+====================
 */
-void SV_MoveBounds (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, vec3_t boxmins, vec3_t boxmaxs)
+void SV_ClipToLinks ( areanode_t *node, moveclip_t *clip )
+{
+	link_t		*l, *next;
+
+// touch linked edicts
+	for (l = node->solid_edicts.next ; l != &node->solid_edicts ; l = next)
+	{
+		next = l->next;
+		if (!SV_ClipToEdict (EDICT_FROM_AREA(l), clip))
+			return;
+	}
+	
+// recurse down both sides
+	if (node->axis == -1)
+		return;
+
+	if ( clip->boxmaxs[node->axis] > node->dist )
+		SV_ClipToLinks ( node->children[0], clip );
+	if ( clip->boxmins[node->axis] < node->dist )
+		SV_ClipToLinks ( node->children[1], clip );
+}
+
+/*
+====================
+SV_ClipToBVH
+
+SV_ClipToLinks for the bvh.  A speculative move has a list of its own, and
+gives up if it isn't long enough.
+====================
+*/
+void SV_ClipToBVH (moveclip_t *clip)
+{
+	edict_t		*local[BVH_LOCALLIST];
+	edict_t		**list;
+	int			count, max, i;
+
+	if (clip->speculative)
+	{
+		list = local;
+		max = BVH_LOCALLIST;
+	}
+	else
+	{
+		list = sv_bvhlist + sv_numbvhlist;
+		max = sv_bvhlistsize - sv_numbvhlist;
+	}
+	count = SV_SortBVH (list, max, BVH_SOLID, clip->boxmins, clip->boxmaxs);
+
+	if (count < 0)
+	{
+		if (!clip->speculative)
+			Sys_Error ("SV_ClipToBVH: too many entities");
+		clip->failed = true;
+		return;
+	}
+
+	for (i=0 ; i<count ; i++)
+		if (!SV_ClipToEdict (list[i], clip))
+			return;
+}
+
+/*
+====================
+SV_ClipToWorldLinks
+====================
+*/
+void SV_ClipToWorldLinks (moveclip_t *clip)
+{
+	if (sv_usebvh)
+		SV_ClipToBVH (clip);
+	else
+		SV_ClipToLinks (sv_areanodes, clip);
+}
+
+
+/*
+==================
+SV_MoveBounds
+==================
+*/
+void SV_MoveBounds (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, vec3_t boxmins, vec3_t boxmaxs)
 {
 #if 0
 // debug to test against everything
@@ -917,46 +2189,627 @@ boxmaxs[0] = boxmaxs[1] = boxmaxs[2] = 9999;
 
 /*
 ==================
-SV_Move
+SV_InitMoveClip
 ==================
 */
-trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict)
+void SV_InitMoveClip (moveclip_t *clip, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict)
 {
-	moveclip_t	clip;
 	int			i;
 
-	memset ( &clip, 0, sizeof ( moveclip_t ) );
-
-// clip to world
-	clip.trace = SV_ClipMoveToEntity ( sv.edicts, start, mins, maxs, end );
+	memset ( clip, 0, sizeof ( moveclip_t ) );
 
-	clip.start = start;
-	clip.end = end;
-	clip.mins = mins;
-	clip.maxs = maxs;
-	clip.type = type;
-	clip.passedict = passedict;
+	clip->start = start;
+	clip->end = end;
+	clip->mins = mins;
+	clip->maxs = maxs;
+	clip->type = type;
+	clip->passedict = passedict;
 
 	if (type == MOVE_MISSILE)
 	{
 		for (i=0 ; i<3 ; i++)
 		{
-			clip.mins2[i] = -15;
-			clip.maxs2[i] = 15;
+			clip->mins2[i] = -15;
+			clip->maxs2[i] = 15;
 		}
 	}
 	else
 	{
-		VectorCopy (mins, clip.mins2);
-		VectorCopy (maxs, clip.maxs2);
+		VectorCopy (mins, clip->mins2);
+		VectorCopy (maxs, clip->maxs2);
 	}
 	
 // create the bounding box of the entire move
-	SV_MoveBounds ( start, clip.mins2, clip.maxs2, end, clip.boxmins, clip.boxmaxs );
+	SV_MoveBounds ( start, clip->mins2, clip->maxs2, end, clip->boxmins, clip->boxmaxs );
+}
+
+/*
+==================
+SV_Move
+==================
+*/
+trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict)
+{
+	moveclip_t	clip;
+	trace_t		*trace;
+
+	if (sv_tracerecording)
+		SV_RecordTrace (start, mins, maxs, end, type, passedict);
+
+	if (sv_speculating && passedict)
+	{
+		trace = SV_SpeculatedMove (start, mins, maxs, end, type, passedict);
+		if (trace)
+			return *trace;
+	}
+
+	SV_InitMoveClip (&clip, start, mins, maxs, end, type, passedict);
+
+// clip to world
+	clip.trace = SV_ClipMoveToEntity ( sv.edicts, start, mins, maxs, end, false );
 
 // clip to entities
-	SV_ClipToLinks ( sv_areanodes, &clip );
+	SV_ClipToWorldLinks (&clip);
 
 	return clip.trace;
 }
 
+
+/*
+===============================================================================
+
+BATCHED MOVES
+
+SV_MoveBatch traces moves that are made together, with nothing changing
+between them.  The entities near all of them are found once, and each move
+then goes through them in the order its own search would have found them,
+skipping the ones that search wouldn't have reached, so every trace comes out
+the same as from SV_Move.  Clipping against the world doesn't depend on any
+entity, so a batch of at least MIN_BATCHJOBS moves has the workers do that
+part; a smaller one, like SV_CheckBottom's, is traced on the main thread.
+
+===============================================================================
+*/
+
+#define	MAX_BATCHMOVES	64		// traced together, the rest go in the next lot
+#define	MIN_BATCHJOBS	16		// moves before the workers are worth waking
+#define	MAX_BATCHJOBS	16
+
+typedef struct
+{
+	areanode_t	*node;
+	int			parent;			// group, -1 for the top node
+	int			side;			// of the parent's split
+	int			first, count;	// in sv_batchents
+} batchgroup_t;
+
+typedef struct
+{
+	sysjob_t	job;
+	moveclip_t	*clips;
+	qboolean	*skip;
+	int			count;
+	qboolean	quiet;			// on a worker
+} batchjob_t;
+
+static	batchgroup_t	sv_batchgroups[AREA_NODES];
+static	int			sv_numbatchgroups;
+static	batchjob_t	sv_batchjobs[MAX_BATCHJOBS];
+
+/*
+====================
+SV_BatchLinks
+
+Groups the solid entities in every node the box reaches, in the order
+SV_ClipToLinks goes through them
+====================
+*/
+void SV_BatchLinks (areanode_t *node, int parent, int side, vec3_t mins, vec3_t maxs)
+{
+	batchgroup_t	*group;
+	link_t			*l;
+	int				num;
+
+	num = sv_numbatchgroups++;
+	group = &sv_batchgroups[num];
+	group->node = node;
+	group->parent = parent;
+	group->side = side;
+	group->first = sv_numbatchents;
+	for (l = node->solid_edicts.next ; l != &node->solid_edicts ; l = l->next)
+		sv_batchents[sv_numbatchents++] = EDICT_FROM_AREA(l);
+	group->count = sv_numbatchents - group->first;
+
+	if (node->axis == -1)
+		return;
+
+	if (maxs[node->axis] > node->dist)
+		SV_BatchLinks (node->children[0], num, 0, mins, maxs);
+	if (mins[node->axis] < node->dist)
+		SV_BatchLinks (node->children[1], num, 1, mins, maxs);
+}
+
+/*
+====================
+SV_ClipToBatchLinks
+
+SV_ClipToLinks, on the groups.  A node is only reached if its parent was,
+its parent wasn't cut short, and the move reaches its side of the split.
+====================
+*/
+void SV_ClipToBatchLinks (moveclip_t *clip)
+{
+	batchgroup_t	*group;
+	areanode_t		*split;
+	qboolean		reached[AREA_NODES], cut[AREA_NODES];
+	int				g, i;
+
+	for (g=0 ; g<sv_numbatchgroups ; g++)
+	{
+		group = &sv_batchgroups[g];
+		cut[g] = false;
+		if (group->parent == -1)
+			reached[g] = true;
+		else if (!reached[group->parent] || cut[group->parent])
+			reached[g] = false;
+		else
+		{
+			split = sv_batchgroups[group->parent].node;
+			if (group->side == 0)
+				reached[g] = clip->boxmaxs[split->axis] > split->dist;
+			else
+				reached[g] = clip->boxmins[split->axis] < split->dist;
+		}
+		if (!reached[g])
+			continue;
+
+		for (i=0 ; i<group->count ; i++)
+			if (!SV_ClipToEdict (sv_batchents[group->first + i], clip))
+			{
+				cut[g] = true;
+				break;
+			}
+	}
+}
+
+/*
+====================
+SV_ClipToBatchBVH
+
+SV_ClipToBVH, on entities found for the whole batch.  Only the ones whose
+leaves the move reaches are its own.
+====================
+*/
+void SV_ClipToBatchBVH (moveclip_t *clip)
+{
+	bvhnode_t	*leaf;
+	int			i;
+
+	for (i=0 ; i<sv_numbatchents ; i++)
+	{
+		leaf = sv_batchleafs[i];
+		if (clip->boxmins[0] > leaf->maxs[0]
+		|| clip->boxmins[1] > leaf->maxs[1]
+		|| clip->boxmins[2] > leaf->maxs[2]
+		|| clip->boxmaxs[0] < leaf->mins[0]
+		|| clip->boxmaxs[1] < leaf->mins[1]
+		|| clip->boxmaxs[2] < leaf->mins[2] )
+			continue;
+		if (!SV_ClipToEdict (sv_batchents[i], clip))
+			return;
+	}
+}
+
+/*
+====================
+SV_BatchJob
+
+Clips a share of the batch against the world
+====================
+*/
+void SV_BatchJob (void *data)
+{
+	batchjob_t	*job;
+	moveclip_t	*clip;
+	int			i;
+
+	job = data;
+	for (i=0 ; i<job->count ; i++)
+	{
+		if (job->skip[i])
+			continue;
+		clip = &job->clips[i];
+		clip->trace = SV_ClipMoveToEntity (sv.edicts, clip->start, clip->mins, clip->maxs, clip->end, job->quiet);
+	}
+}
+
+/*
+====================
+SV_MoveBatch
+====================
+*/
+void SV_MoveBatch (movetrace_t *moves, int count, int type, edict_t *passedict)
+{
+	moveclip_t	clips[MAX_BATCHMOVES];
+	qboolean	skip[MAX_BATCHMOVES];
+	movetrace_t	*move;
+	moveclip_t	*clip;
+	batchjob_t	*job;
+	trace_t		*trace;
+	vec3_t		mins, maxs;
+	int			i, j, num, first, numjobs, left;
+
+	for ( ; count > 0 ; count -= num, moves += num)
+	{
+		num = count < MAX_BATCHMOVES ? count : MAX_BATCHMOVES;
+
+	// set up the moves, and the box around them all
+		for (j=0 ; j<3 ; j++)
+		{
+			mins[j] = 1e30;
+			maxs[j] = -1e30;
+		}
+		left = 0;
+		for (i=0 ; i<num ; i++)
+		{
+			move = &moves[i];
+			clip = &clips[i];
+			skip[i] = true;
+
+			if (sv_speculating && passedict)
+			{
+				trace = SV_SpeculatedMove (move->start, move->mins, move->maxs, move->end, type, passedict);
+				if (trace)
+				{
+					if (sv_tracerecording)
+						SV_RecordTrace (move->start, move->mins, move->maxs, move->end, type, passedict);
+					move->trace = *trace;
+					continue;
+				}
+			}
+
+			SV_InitMoveClip (clip, move->start, move->mins, move->maxs, move->end, type, passedict);
+			for (j=0 ; j<3 ; j++)
+				if (IS_NAN(clip->boxmins[j]) || IS_NAN(clip->boxmaxs[j]))
+					break;
+			if (j < 3)
+			{	// reaches nodes no box would, so it goes on its own
+				move->trace = SV_Move (move->start, move->mins, move->maxs, move->end, type, passedict);
+				continue;
+			}
+			if (sv_tracerecording)
+				SV_RecordTrace (move->start, move->mins, move->maxs, move->end, type, passedict);
+
+			for (j=0 ; j<3 ; j++)
+			{
+				if (clip->boxmins[j] < mins[j])
+					mins[j] = clip->boxmins[j];
+				if (clip->boxmaxs[j] > maxs[j])
+					maxs[j] = clip->boxmaxs[j];
+			}
+			skip[i] = false;
+			left++;
+		}
+		if (!left)
+			continue;
+
+	// clip to world
+		numjobs = 1;
+		if (left >= MIN_BATCHJOBS)
+			numjobs += Sys_NumWorkers ();
+		if (numjobs > MAX_BATCHJOBS)
+			numjobs = MAX_BATCHJOBS;
+
+		first = 0;
+		for (i=0 ; i<numjobs ; i++)
+		{
+			job = &sv_batchjobs[i];
+			job->clips = clips + first;
+			job->skip = skip + first;
+			job->count = (num - first) / (numjobs - i);
+			job->quiet = numjobs > 1;
+			first += job->count;
+			if (numjobs == 1)
+				SV_BatchJob (job);
+			else
+				Sys_QueueJob (&job->job, SV_BatchJob, job);
+		}
+		if (numjobs > 1)
+		{
+			for (i=0 ; i<numjobs ; i++)
+				Sys_WaitJob (&sv_batchjobs[i].job);
+		}
+
+	// clip to entities
+		sv_numbatchents = 0;
+		if (sv_usebvh)
+		{
+			sv_numbatchents = SV_SortBVH (sv_batchents, sv.edict_limit, BVH_SOLID, mins, maxs);
+			for (i=0 ; i<sv_numbatchents ; i++)
+				sv_batchleafs[i] = &sv_bvhnodes[sv_bvhleaf[NUM_FOR_EDICT(sv_batchents[i])]];
+		}
+		else
+		{
+			sv_numbatchgroups = 0;
+			SV_BatchLinks (sv_areanodes, -1, 0, mins, maxs);
+		}
+
+		for (i=0 ; i<num ; i++)
+		{
+			if (skip[i])
+				continue;
+			if (sv_usebvh)
+				SV_ClipToBatchBVH (&clips[i]);
+			else
+				SV_ClipToBatchLinks (&clips[i]);
+			moves[i].trace = clips[i].trace;
+		}
+	}
+}
+
+/*
+===============================================================================
+
+SPECULATIVE MOVES
+
+SV_Physics can have the moves it is about to make traced ahead of time on the
+worker threads.  Those traces see the world as it was before the frame ran,
+so while it runs, anything that could change what a trace sees records the
+box of the entity it happened to: linking and unlinking, and progs writes to
+the fields SV_ClipToLinks reads.  SV_Move only hands back a speculative trace
+if it is asked for exactly the same move and nothing has changed inside the
+bounds of it, which is when tracing it again would come out the same.
+
+===============================================================================
+*/
+
+static char	*sv_tracefields[] = {"owner", "flags", "modelindex", "movetype",
+	"size", "absmin", "absmax", NULL};	// origin, mins, maxs and solid are FW_MOVED
+
+/*
+==================
+SV_SpeculateMove
+
+Queues a move for SV_RunSpeculation.  Only the first one for each passedict
+is kept.
+==================
+*/
+void SV_SpeculateMove (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict)
+{
+	specmove_t	*spec;
+	int			num;
+
+	if (!sv_specmoves)
+	{
+		sv_specmoves = Hunk_AllocName (sv.edict_limit*sizeof(specmove_t), "specmove");
+		sv_specmove = Hunk_AllocName (sv.edict_limit*sizeof(int), "specmove");
+		sv_specchange = Hunk_AllocName (sv.edict_limit*sizeof(int), "specmove");
+	}
+
+	num = NUM_FOR_EDICT(passedict);
+	if (sv_speculating || sv_specmove[num])
+		return;
+
+	spec = &sv_specmoves[sv_numspecmoves++];
+	VectorCopy (start, spec->start);
+	VectorCopy (mins, spec->mins);
+	VectorCopy (maxs, spec->maxs);
+	VectorCopy (end, spec->end);
+	spec->type = type;
+	spec->passedict = passedict;
+	spec->owner = passedict->v.owner;
+	spec->size = passedict->v.size[0];
+	spec->ok = false;
+	sv_specmove[num] = sv_numspecmoves;
+}
+
+/*
+==================
+SV_SpeculateJob
+
+Runs on a worker while the main thread waits, so the world holds still
+==================
+*/
+void SV_SpeculateJob (void *data)
+{
+	specjob_t	*job;
+	specmove_t	*spec;
+	moveclip_t	clip;
+	int			i;
+
+	job = data;
+	for (i=0 ; i<job->count ; i++)
+	{
+		spec = &sv_specmoves[job->first + i];
+
+		SV_InitMoveClip (&clip, spec->start, spec->mins, spec->maxs, spec->end, spec->type, spec->passedict);
+		clip.speculative = true;
+		VectorCopy (clip.boxmins, spec->boxmins);
+		VectorCopy (clip.boxmaxs, spec->boxmaxs);
+
+		if (!SV_CanClip (sv.edicts))
+			continue;
+		clip.trace = SV_ClipMoveToEntity (sv.edicts, spec->start, spec->mins, spec->maxs, spec->end, true);
+		SV_ClipToWorldLinks (&clip);
+
+		spec->trace = clip.trace;
+		spec->ok = !clip.failed;
+	}
+}
+
+/*
+==================
+SV_RunSpeculation
+
+Traces the queued moves on the workers, and starts keeping track of changes
+==================
+*/
+void SV_RunSpeculation (void)
+{
+	specjob_t	*job;
+	int			i, numjobs, first;
+	char		**name;
+
+	if (!sv_numspecmoves || sv_speculating)
+		return;
+
+	numjobs = Sys_NumWorkers () + 1;
+	if (numjobs > MAX_SPECJOBS)
+		numjobs = MAX_SPECJOBS;
+	if (numjobs > sv_numspecmoves)
+		numjobs = sv_numspecmoves;
+
+	first = 0;
+	for (i=0 ; i<numjobs ; i++)
+	{
+		job = &sv_specjobs[i];
+		job->first = first;
+		job->count = (sv_numspecmoves - first) / (numjobs - i);
+		first += job->count;
+		Sys_QueueJob (&job->job, SV_SpeculateJob, job);
+	}
+	for (i=0 ; i<numjobs ; i++)
+		Sys_WaitJob (&sv_specjobs[i].job);
+
+	for (name=sv_tracefields ; *name ; name++)
+		ED_WatchField (*name, FW_TRACE);
+
+	sv_numspecchanges = 0;
+	sv_specoverflow = false;
+	sv_speculating = true;
+}
+
+/*
+==================
+SV_EndSpeculation
+
+Drops the speculative moves, used or not
+==================
+*/
+void SV_EndSpeculation (void)
+{
+	char	**name;
+	int		i;
+
+	if (sv_speculating)
+	{
+		for (name=sv_tracefields ; *name ; name++)
+			ED_UnwatchField (*name, FW_TRACE);
+		sv_speculating = false;
+	}
+
+	for (i=0 ; i<sv_numspecmoves ; i++)
+		sv_specmove[NUM_FOR_EDICT(sv_specmoves[i].passedict)] = 0;
+	sv_numspecmoves = 0;
+
+	for (i=0 ; i<sv_numspecchanges ; i++)
+		sv_specchange[NUM_FOR_EDICT(sv_specchanges[i].ent)] = 0;
+	sv_numspecchanges = 0;
+}
+
+/*
+==================
+SV_TraceChanged
+
+Something about ent that traces depend on is about to change, or just has
+==================
+*/
+void SV_TraceChanged (edict_t *ent)
+{
+	specchange_t	*change;
+	int				num;
+
+	if (!sv_speculating)
+		return;
+	if (ent == sv.edicts)
+	{
+		sv_specoverflow = true;		// every trace clips against the world
+		return;
+	}
+	if (!ent->area.prev)
+		return;		// no trace can see it
+
+	num = NUM_FOR_EDICT(ent);
+	if (sv_specchange[num])
+	{
+		change = &sv_specchanges[sv_specchange[num] - 1];
+		if (VectorCompare (change->absmin, ent->v.absmin)
+		&& VectorCompare (change->absmax, ent->v.absmax))
+			return;		// already covered
+	}
+
+	if (sv_numspecchanges == MAX_SPECCHANGES)
+	{
+		sv_specoverflow = true;
+		return;
+	}
+	change = &sv_specchanges[sv_numspecchanges++];
+	change->ent = ent;
+	VectorCopy (ent->v.absmin, change->absmin);
+	VectorCopy (ent->v.absmax, change->absmax);
+	sv_specchange[num] = sv_numspecchanges;
+}
+
+/*
+==================
+SV_BoxesTouch
+
+The same test SV_ClipToLinks makes, so a NaN counts as touching
+==================
+*/
+qboolean SV_BoxesTouch (vec3_t mins, vec3_t maxs, vec3_t absmin, vec3_t absmax)
+{
+	if (mins[0] > absmax[0]
+	|| mins[1] > absmax[1]
+	|| mins[2] > absmax[2]
+	|| maxs[0] < absmin[0]
+	|| maxs[1] < absmin[1]
+	|| maxs[2] < absmin[2] )
+		return false;
+	return true;
+}
+
+/*
+==================
+SV_SpeculatedMove
+
+The speculative trace for this move, or NULL if it has to be traced again.
+A change records the box the entity was in at the time; the box it is in
+now is checked as well, which covers a progs write to absmin or absmax.
+==================
+*/
+trace_t *SV_SpeculatedMove (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict)
+{
+	specmove_t		*spec;
+	specchange_t	*change;
+	int				i, num;
+
+	num = NUM_FOR_EDICT(passedict);
+	if (!sv_specmove[num] || sv_specoverflow)
+		return NULL;
+	spec = &sv_specmoves[sv_specmove[num] - 1];
+	if (!spec->ok)
+		return NULL;
+
+// the same bits, not just equal values
+	if (type != spec->type
+	|| memcmp (start, spec->start, sizeof(vec3_t))
+	|| memcmp (mins, spec->mins, sizeof(vec3_t))
+	|| memcmp (maxs, spec->maxs, sizeof(vec3_t))
+	|| memcmp (end, spec->end, sizeof(vec3_t))
+	|| passedict->v.owner != spec->owner
+	|| memcmp (&passedict->v.size[0], &spec->size, sizeof(float)))
+		return NULL;
+
+	for (i=0 ; i<sv_numspecchanges ; i++)
+	{
+		change = &sv_specchanges[i];
+		if (change->ent == passedict)
+			continue;	// never clipped against
+		if (SV_BoxesTouch (spec->boxmins, spec->boxmaxs, change->absmin, change->absmax)
+		|| SV_BoxesTouch (spec->boxmins, spec->boxmaxs, change->ent->v.absmin, change->ent->v.absmax))
+			return NULL;
+	}
+
+	return &spec->trace;
+}
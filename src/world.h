@@ -34,6 +34,7 @@ typedef struct
 	vec3_t	endpos;			// final position
 	plane_t	plane;			// surface normal at impact
 	edict_t	*ent;			// entity the surface is on
+	qboolean	quiet;		// set before tracing on a worker, so nothing is printed
 } trace_t;
 
 
@@ -56,6 +57,28 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers);
 // sets ent->v.absmin and ent->v.absmax
 // if touchtriggers, calls prog functions for the intersected triggers
 
+qboolean SV_LeafsVisible (edict_t *ent, byte *pvs);
+// true if any of the leafs ent was last linked into are set in pvs
+
+void SV_EdictMoved (edict_t *ent);
+// call when an entity's origin, mins, maxs, or solid changes and progs can
+// run before it is linked again
+
+void SV_SpeculateMove (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict);
+void SV_RunSpeculation (void);
+void SV_EndSpeculation (void);
+// moves queued with SV_SpeculateMove are traced on the worker threads by
+// SV_RunSpeculation, and SV_Move returns them until SV_EndSpeculation if
+// nothing has changed that would make them come out differently
+
+void SV_TraceChanged (edict_t *ent);
+// call when something a trace reads about ent is about to change, or has,
+// other than by linking it or through SV_EdictMoved
+
+edict_t *SV_FindRadius (float *org, float rad);
+// returns the chain of entities within rad of org, the same as scanning
+// every edict would
+
 int SV_PointContents (vec3_t p);
 int SV_TruePointContents (vec3_t p);
 // returns the CONTENTS_* value from the world at the given point.
@@ -77,4 +100,23 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 
 // passedict is explicitly excluded from clipping checks (normally NULL)
 
+typedef struct
+{
+	vec3_t	start, mins, maxs, end;
+	trace_t	trace;
+} movetrace_t;
+
+void SV_MoveBatch (movetrace_t *moves, int count, int type, edict_t *passedict);
+// traces each move the same as SV_Move would, sharing the search for the
+// entities near them.  Only for moves made together, with nothing changing
+// between them.
+
+trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, qboolean quiet);
+// the move against ent alone, sv.edicts for the world
+
+extern	qboolean	sv_tracerecording;
+void SV_RecordTrace (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict);
+// SV_Move and SV_MoveBatch keep what they are asked for while tracebench
+// runs the game
+
 qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace);
\ No newline at end of file
@@ -26,12 +26,20 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define	ZONEID	0x1d4a11
 #define MINFRAGMENT	64
 
+// free blocks are kept on lists by size.  Blocks under ZONE_SMALL_LIMIT get a
+// list for every size, so any block on one fits; bigger ones share a list per
+// power of two and are searched first fit.
+#define	ZONE_SMALL_LIMIT	512
+#define	ZONE_SMALL_BINS		(ZONE_SMALL_LIMIT/8)
+#define	ZONE_BINS			(ZONE_SMALL_BINS+24)
+
 typedef struct memblock_s
 {
 	int		size;           // including the header and possibly tiny fragments
 	int     tag;            // a tag of 0 is a free block
 	int     id;        		// should be ZONEID
 	struct memblock_s       *next, *prev;
+	struct memblock_s       *nextfree, *prevfree;	// size list, free blocks only
 	int		pad;			// pad to 64 bit boundary
 } memblock_t;
 
@@ -39,13 +47,239 @@ typedef struct
 {
 	int		size;		// total bytes malloced, including header
 	memblock_t	blocklist;		// start / end cap for linked list
-	memblock_t	*rover;
+	memblock_t	*bins[ZONE_BINS];	// free blocks by size
 } memzone_t;
 
+// the first block starts past the bins on a 16 byte boundary.  Sizes are
+// rounded to 8 and the block header must be a multiple of 8 too, or every
+// block after the first would be misaligned.
+#define	ZONE_HEADER		((sizeof(memzone_t)+15)&~15)
+typedef char	zone_headercheck[(sizeof(memblock_t) & 7) ? -1 : 1];
+
 void Cache_FreeLow (int new_low_hunk);
 void Cache_FreeHigh (int new_high_hunk);
 
 
+/*
+==============================================================================
+
+						MEMORY TELEMETRY
+
+Every allocation is added to a running total for its kind and name: hunk
+blocks by the name they were given, cache entries by owner class, and zone
+blocks by tag.  Each total keeps its peak, so after a few maps "memstats"
+shows what a server or client actually needed.
+==============================================================================
+*/
+
+#define	MEM_LOW		0		// low hunk
+#define	MEM_HIGH	1		// high hunk, including temp
+#define	MEM_CACHE	2
+#define	MEM_ZONE	3
+#define	MEM_KINDS	4
+
+#define	MAX_MEMNAMES	512		// must be a power of two
+
+typedef struct
+{
+	char	name[16];		// empty if the slot is unused
+	int		kind;
+	int		current, peak;
+	int		allocs;
+} memname_t;
+
+memname_t	mem_names[MAX_MEMNAMES];
+
+// zone blocks are counted by tag straight into an array, as zone calls are
+// too frequent to hash a name for each.  Tags past the end share the last.
+#define	MEM_ZONETAGS	16
+
+memname_t	mem_zonetags[MEM_ZONETAGS];		// named when printed
+int			mem_current[MEM_KINDS];
+int			mem_peak[MEM_KINDS];
+int			mem_peaktotal;		// highest sum of all kinds at once
+
+char		*mem_kindnames[MEM_KINDS] = {"hunk", "high", "cache", "zone"};
+
+void Memory_CountKind (int kind, int delta);
+
+/*
+========================
+Memory_Count
+
+Adds delta bytes to name's total.  Hunk names are only 8 characters and
+might not be terminated.
+========================
+*/
+void Memory_Count (int kind, char *name, int namelen, int delta)
+{
+	memname_t	*m;
+	char		key[16];
+	unsigned	hash;
+	int			i;
+
+	for (i=0 ; i<namelen && i<(int)sizeof(key)-1 && name[i] ; i++)
+		key[i] = name[i];
+	key[i] = 0;
+
+	hash = kind + COM_HashString (key);
+
+	for (i=0 ; i<MAX_MEMNAMES ; i++)
+	{
+		m = &mem_names[(hash + i) & (MAX_MEMNAMES-1)];
+		if (!m->name[0])
+		{	// first time this name has been seen
+			strcpy (m->name, key[0] ? key : "?");
+			m->kind = kind;
+			break;
+		}
+		if (m->kind == kind && !strcmp (m->name, key[0] ? key : "?"))
+			break;
+	}
+	if (i == MAX_MEMNAMES)
+		m = NULL;	// table is full, only count the kind
+
+	if (m)
+	{
+		m->current += delta;
+		if (delta > 0)
+			m->allocs++;
+		if (m->current > m->peak)
+			m->peak = m->current;
+	}
+
+	Memory_CountKind (kind, delta);
+}
+
+/*
+========================
+Memory_CountZone
+
+Adds delta bytes to a zone tag's total
+========================
+*/
+void Memory_CountZone (int tag, int delta)
+{
+	memname_t	*m;
+
+	m = &mem_zonetags[tag < MEM_ZONETAGS ? tag : MEM_ZONETAGS-1];
+	m->current += delta;
+	if (delta > 0)
+		m->allocs++;
+	if (m->current > m->peak)
+		m->peak = m->current;
+
+	Memory_CountKind (MEM_ZONE, delta);
+}
+
+/*
+========================
+Memory_CountKind
+
+Adds delta bytes to kind's total, and the total of them all
+========================
+*/
+void Memory_CountKind (int kind, int delta)
+{
+	int		i, total;
+
+	mem_current[kind] += delta;
+	if (mem_current[kind] > mem_peak[kind])
+		mem_peak[kind] = mem_current[kind];
+
+	total = 0;
+	for (i=0 ; i<MEM_KINDS ; i++)
+		total += mem_current[i];
+	if (total > mem_peaktotal)
+		mem_peaktotal = total;
+}
+
+/*
+========================
+Memory_Stats_f
+
+memstats [file | reset]
+
+Prints a comma separated report, or writes it to a file in the game
+directory.  reset starts the peaks again from the current totals.
+========================
+*/
+void Memory_Stats_f (void)
+{
+	memname_t	*m;
+	FILE		*f;
+	char		line[128];
+	int			i, kind;
+
+	if (Cmd_Argc () == 2 && !Q_strcasecmp (Cmd_Argv (1), "reset"))
+	{
+		for (i=0 ; i<MAX_MEMNAMES ; i++)
+			mem_names[i].peak = mem_names[i].current;
+		for (i=0 ; i<MEM_ZONETAGS ; i++)
+			mem_zonetags[i].peak = mem_zonetags[i].current;
+		mem_peaktotal = 0;
+		for (i=0 ; i<MEM_KINDS ; i++)
+		{
+			mem_peak[i] = mem_current[i];
+			mem_peaktotal += mem_current[i];
+		}
+		return;
+	}
+
+	f = NULL;
+	if (Cmd_Argc () == 2)
+	{
+		sprintf (line, "%s/%s", com_gamedir, Cmd_Argv (1));
+		f = fopen (line, "w");
+		if (!f)
+		{
+			Con_Printf ("Couldn't write %s\n", line);
+			return;
+		}
+		COM_AddCachedFile (line);
+	}
+
+#define	MEMLINE(x)	if (f) fprintf (f, "%s", x); else Con_Printf ("%s", x)
+
+	MEMLINE ("kind,name,current,peak,allocs\n");
+	for (kind=0 ; kind<MEM_KINDS ; kind++)
+	{
+		sprintf (line, "%s,TOTAL,%i,%i,\n", mem_kindnames[kind],
+			mem_current[kind], mem_peak[kind]);
+		MEMLINE (line);
+	}
+	sprintf (line, "all,TOTAL,%i,%i,\n", mem_current[MEM_LOW] + mem_current[MEM_HIGH]
+		+ mem_current[MEM_CACHE] + mem_current[MEM_ZONE], mem_peaktotal);
+	MEMLINE (line);
+
+	for (kind=0 ; kind<MEM_KINDS ; kind++)
+		for (i=0 ; i<MAX_MEMNAMES ; i++)
+		{
+			m = &mem_names[i];
+			if (!m->name[0] || m->kind != kind)
+				continue;
+			sprintf (line, "%s,%s,%i,%i,%i\n", mem_kindnames[kind], m->name,
+				m->current, m->peak, m->allocs);
+			MEMLINE (line);
+		}
+
+	for (i=1 ; i<MEM_ZONETAGS ; i++)
+	{
+		m = &mem_zonetags[i];
+		if (!m->allocs)
+			continue;
+		sprintf (line, "zone,tag%i%s,%i,%i,%i\n", i, i == MEM_ZONETAGS-1 ? "+" : "",
+			m->current, m->peak, m->allocs);
+		MEMLINE (line);
+	}
+
+#undef	MEMLINE
+
+	if (f)
+		fclose (f);
+}
+
+
 /*
 ==============================================================================
 
@@ -54,7 +288,8 @@ void Cache_FreeHigh (int new_high_hunk);
 There is never any space between memblocks, and there will never be two
 contiguous free memblocks.
 
-The rover can be left pointing at a non-empty block
+Every free block is also on the size list for its size, so an allocation
+goes straight to a block that fits instead of walking the whole zone.
 
 The zone calls are pretty much only used for small strings and structures,
 all big things are allocated on the hunk.
@@ -64,7 +299,58 @@ all big things are allocated on the hunk.
 memzone_t	*mainzone;
 
 void Z_ClearZone (memzone_t *zone, int size);
+void Z_Print (memzone_t *zone, qboolean all);
+
+
+/*
+========================
+Z_BinForSize
+========================
+*/
+int Z_BinForSize (int size)
+{
+	int		bin;
+
+	if (size < ZONE_SMALL_LIMIT)
+		return size >> 3;
+
+	bin = ZONE_SMALL_BINS;
+	for (size /= ZONE_SMALL_LIMIT*2 ; size && bin < ZONE_BINS-1 ; size >>= 1)
+		bin++;
+	return bin;
+}
+
+/*
+========================
+Z_LinkFree
+========================
+*/
+void Z_LinkFree (memzone_t *zone, memblock_t *block)
+{
+	memblock_t	**bin;
+
+	bin = &zone->bins[Z_BinForSize (block->size)];
+	block->prevfree = NULL;
+	block->nextfree = *bin;
+	if (*bin)
+		(*bin)->prevfree = block;
+	*bin = block;
+}
 
+/*
+========================
+Z_UnlinkFree
+========================
+*/
+void Z_UnlinkFree (memzone_t *zone, memblock_t *block)
+{
+	if (block->prevfree)
+		block->prevfree->nextfree = block->nextfree;
+	else
+		zone->bins[Z_BinForSize (block->size)] = block->nextfree;
+	if (block->nextfree)
+		block->nextfree->prevfree = block->prevfree;
+}
 
 /*
 ========================
@@ -78,16 +364,18 @@ void Z_ClearZone (memzone_t *zone, int size)
 // set the entire zone to one free block
 
 	zone->blocklist.next = zone->blocklist.prev = block =
-		(memblock_t *)( (byte *)zone + sizeof(memzone_t) );
+		(memblock_t *)( (byte *)zone + ZONE_HEADER );
 	zone->blocklist.tag = 1;	// in use block
 	zone->blocklist.id = 0;
 	zone->blocklist.size = 0;
-	zone->rover = block;
+	zone->size = size;
+	memset (zone->bins, 0, sizeof(zone->bins));
 	
 	block->prev = block->next = &zone->blocklist;
 	block->tag = 0;			// free block
 	block->id = ZONEID;
-	block->size = size - sizeof(memzone_t);
+	block->size = size - ZONE_HEADER;
+	Z_LinkFree (zone, block);
 }
 
 
@@ -109,28 +397,30 @@ void Z_Free (void *ptr)
 	if (block->tag == 0)
 		Sys_Error ("Z_Free: freed a freed pointer");
 
+	Memory_CountZone (block->tag, -block->size);
+
 	block->tag = 0;		// mark as free
 	
 	other = block->prev;
 	if (!other->tag)
 	{	// merge with previous free block
+		Z_UnlinkFree (mainzone, other);
 		other->size += block->size;
 		other->next = block->next;
 		other->next->prev = other;
-		if (block == mainzone->rover)
-			mainzone->rover = other;
 		block = other;
 	}
 	
 	other = block->next;
 	if (!other->tag)
 	{	// merge the next free block onto the end
+		Z_UnlinkFree (mainzone, other);
 		block->size += other->size;
 		block->next = other->next;
 		block->next->prev = block;
-		if (other == mainzone->rover)
-			mainzone->rover = block;
 	}
+
+	Z_LinkFree (mainzone, block);
 }
 
 
@@ -143,7 +433,9 @@ void *Z_Malloc (int size)
 {
 	void	*buf;
 	
-Z_CheckHeap ();	// DEBUG
+#ifdef PARANOID
+	Z_CheckHeap ();
+#endif
 	buf = Z_TagMalloc (size, 1);
 	if (!buf)
 		Sys_Error ("Z_Malloc: failed on allocation of %i bytes",size);
@@ -155,31 +447,28 @@ Z_CheckHeap ();	// DEBUG
 void *Z_TagMalloc (int size, int tag)
 {
 	int		extra;
-	memblock_t	*start, *rover, *new, *base;
+	int		bin;
+	memblock_t	*new, *base;
 
 	if (!tag)
 		Sys_Error ("Z_TagMalloc: tried to use a 0 tag");
 
-//
-// scan through the block list looking for the first free block
-// of sufficient size
-//
 	size += sizeof(memblock_t);	// account for size of block header
 	size += 4;					// space for memory trash tester
 	size = (size + 7) & ~7;		// align to 8-byte boundary
-	
-	base = rover = mainzone->rover;
-	start = base->prev;
-	
-	do
-	{
-		if (rover == start)	// scaned all the way around the list
-			return NULL;
-		if (rover->tag)
-			base = rover = rover->next;
-		else
-			rover = rover->next;
-	} while (base->tag || base->size < size);
+
+//
+// take the first block big enough from the smallest list that can have one
+//
+	base = NULL;
+	for (bin = Z_BinForSize (size) ; bin < ZONE_BINS && !base ; bin++)
+		for (base = mainzone->bins[bin] ; base ; base = base->nextfree)
+			if (base->size >= size)
+				break;
+	if (!base)
+		return NULL;
+
+	Z_UnlinkFree (mainzone, base);
 	
 //
 // found a block big enough
@@ -196,17 +485,18 @@ void *Z_TagMalloc (int size, int tag)
 		new->next->prev = new;
 		base->next = new;
 		base->size = size;
+		Z_LinkFree (mainzone, new);
 	}
 	
 	base->tag = tag;				// no longer a free block
 	
-	mainzone->rover = base->next;	// next allocation will start looking here
-	
 	base->id = ZONEID;
 
 // marker for memory trash testing
 	*(int *)((byte *)base + base->size - 4) = ZONEID;
 
+	Memory_CountZone (tag, base->size);
+
 	return (void *) ((byte *)base + sizeof(memblock_t));
 }
 
@@ -214,18 +504,42 @@ void *Z_TagMalloc (int size, int tag)
 /*
 ========================
 Z_Print
+
+If "all" is specified, every block is printed before the summary
 ========================
 */
-void Z_Print (memzone_t *zone)
+void Z_Print (memzone_t *zone, qboolean all)
 {
 	memblock_t	*block;
+	int			used, usedblocks;
+	int			free, freeblocks, largest;
+	int			smallfree, bin, count;
 	
-	Con_Printf ("zone size: %i  location: %p\n",mainzone->size,mainzone);
-	
-	for (block = zone->blocklist.next ; ; block = block->next)
+	Con_Printf ("zone size: %i  location: %p\n",zone->size,zone);
+
+	used = usedblocks = 0;
+	free = freeblocks = largest = 0;
+	smallfree = 0;
+	for (block = zone->blocklist.next ; block != &zone->blocklist ; block = block->next)
 	{
-		Con_Printf ("block:%p    size:%7i    tag:%3i\n",
-			block, block->size, block->tag);
+		if (all)
+			Con_Printf ("block:%p    size:%7i    tag:%3i\n",
+				block, block->size, block->tag);
+
+		if (block->tag)
+		{
+			used += block->size;
+			usedblocks++;
+		}
+		else
+		{
+			free += block->size;
+			freeblocks++;
+			if (block->size > largest)
+				largest = block->size;
+			if (block->size < ZONE_SMALL_LIMIT)
+				smallfree += block->size;
+		}
 		
 		if (block->next == &zone->blocklist)
 			break;			// all blocks have been hit	
@@ -236,6 +550,37 @@ void Z_Print (memzone_t *zone)
 		if (!block->tag && !block->next->tag)
 			Con_Printf ("ERROR: two consecutive free blocks\n");
 	}
+
+	Con_Printf ("%7i bytes in %i used blocks (%i in headers)\n",
+		used, usedblocks, usedblocks * (int)sizeof(memblock_t));
+	Con_Printf ("%7i bytes in %i free blocks, largest %i\n",
+		free, freeblocks, largest);
+	if (free)
+		Con_Printf ("%7i%% fragmentation, %i bytes in blocks under %i\n",
+			(int)(100.0 * (free - largest) / free), smallfree, ZONE_SMALL_LIMIT);
+
+	if (!all)
+		return;
+	for (bin=0 ; bin<ZONE_BINS ; bin++)
+	{
+		count = 0;
+		for (block = zone->bins[bin] ; block ; block = block->nextfree)
+			count++;
+		if (count)
+			Con_Printf ("list %2i: %i free blocks\n", bin, count);
+	}
+}
+
+/*
+========================
+Z_Print_f
+
+zone [all]
+========================
+*/
+void Z_Print_f (void)
+{
+	Z_Print (mainzone, Cmd_Argc () == 2 && !Q_strcasecmp (Cmd_Argv (1), "all"));
 }
 
 
@@ -247,9 +592,13 @@ Z_CheckHeap
 void Z_CheckHeap (void)
 {
 	memblock_t	*block;
+	int			freeblocks, bin;
 	
+	freeblocks = 0;
 	for (block = mainzone->blocklist.next ; ; block = block->next)
 	{
+		if (!block->tag)
+			freeblocks++;
 		if (block->next == &mainzone->blocklist)
 			break;			// all blocks have been hit	
 		if ( (byte *)block + block->size != (byte *)block->next)
@@ -259,12 +608,26 @@ void Z_CheckHeap (void)
 		if (!block->tag && !block->next->tag)
 			Sys_Error ("Z_CheckHeap: two consecutive free blocks\n");
 	}
+
+	for (bin=0 ; bin<ZONE_BINS ; bin++)
+		for (block = mainzone->bins[bin] ; block ; block = block->nextfree)
+		{
+			if (block->tag || Z_BinForSize (block->size) != bin)
+				Sys_Error ("Z_CheckHeap: block on the wrong free list\n");
+			if (block->nextfree && block->nextfree->prevfree != block)
+				Sys_Error ("Z_CheckHeap: free list doesn't have proper back link\n");
+			freeblocks--;
+		}
+	if (freeblocks)
+		Sys_Error ("Z_CheckHeap: free block missing from the free lists\n");
 }
 
 //============================================================================
 
 #define	HUNK_SENTINAL	0x1df001ed
 
+#define	HUNK_GROW_SIZE	0x800000	// default size of an overflow arena
+
 typedef struct
 {
 	int		sentinal;
@@ -275,35 +638,114 @@ typedef struct
 byte	*hunk_base;
 int		hunk_size;
 
-int		hunk_low_used;
+int		hunk_low_used;		// in the main block only
 int		hunk_high_used;
 
 qboolean	hunk_tempactive;
 int		hunk_tempmark;
 
+//
+// when the main block fills up, allocations go on to arenas taken from the
+// system.  An arena continues the marks where the block (or the arena before
+// it) left off, so marks still only ever grow, and freeing back to a mark
+// hands whole arenas back.  The main block's own usage stays frozen while
+// there are arenas above it.
+//
+typedef struct hunkarena_s
+{
+	int		start;		// mark at the bottom of the arena
+	int		size;
+	int		used;
+	byte	*data;		// 16 byte aligned
+	void	*alloc;		// what to free
+	struct hunkarena_s	*prev;
+} hunkarena_t;
+
+hunkarena_t	*hunk_lowarena;		// newest of each kind
+hunkarena_t	*hunk_higharena;
+int			hunk_growsize;		// 0 if arenas are not allowed
+
 void R_FreeTextures (void);
 
 /*
 ==============
-Hunk_Check
-
-Run consistancy and sentinal trahing checks
+Hunk_CheckBlocks
 ==============
 */
-void Hunk_Check (void)
+void Hunk_CheckBlocks (byte *base, int used)
 {
 	hunk_t	*h;
-	
-	for (h = (hunk_t *)hunk_base ; (byte *)h != hunk_base + hunk_low_used ; )
+
+	for (h = (hunk_t *)base ; (byte *)h != base + used ; )
 	{
 		if (h->sentinal != HUNK_SENTINAL)
 			Sys_Error ("Hunk_Check: trahsed sentinal");
-		if (h->size < 16 || h->size + (byte *)h - hunk_base > hunk_size)
+		if (h->size < 16 || h->size + (byte *)h - base > used)
 			Sys_Error ("Hunk_Check: bad size");
 		h = (hunk_t *)((byte *)h+h->size);
 	}
 }
 
+/*
+==============
+Hunk_Check
+
+Run consistancy and sentinal trahing checks
+==============
+*/
+void Hunk_Check (void)
+{
+	hunkarena_t	*arena;
+
+	Hunk_CheckBlocks (hunk_base, hunk_low_used);
+
+	for (arena = hunk_lowarena ; arena ; arena = arena->prev)
+		Hunk_CheckBlocks (arena->data, arena->used);
+	for (arena = hunk_higharena ; arena ; arena = arena->prev)
+		Hunk_CheckBlocks (arena->data, arena->used);
+}
+
+/*
+==============
+Hunk_PrintArenas
+==============
+*/
+void Hunk_PrintArenas (hunkarena_t *arena, char *kind, qboolean all)
+{
+	hunk_t	*h, *next, *end;
+	int		sum;
+	char	name[9];
+
+	name[8] = 0;
+	for ( ; arena ; arena = arena->prev)
+	{
+		Con_Printf ("          :%8i %s arena at mark %i, %i used\n",
+			arena->size, kind, arena->start, arena->used);
+
+		h = (hunk_t *)arena->data;
+		end = (hunk_t *)(arena->data + arena->used);
+		sum = 0;
+		while (h != end)
+		{
+			next = (hunk_t *)((byte *)h+h->size);
+			sum += h->size;
+
+			memcpy (name, h->name, 8);
+			if (all)
+				Con_Printf ("%8p :%8i %8s\n",h, h->size, name);
+			if (next == end || strncmp (h->name, next->name, 8))
+			{
+				if (!all)
+					Con_Printf ("          :%8i %8s (TOTAL)\n",sum, name);
+				sum = 0;
+			}
+
+			h = next;
+		}
+		Con_Printf ("-------------------------\n");
+	}
+}
+
 /*
 ==============
 Hunk_Print
@@ -388,7 +830,175 @@ void Hunk_Print (qboolean all)
 
 	Con_Printf ("-------------------------\n");
 	Con_Printf ("%8i total blocks\n", totalblocks);
-	
+
+	if (hunk_lowarena || hunk_higharena)
+	{
+		Con_Printf ("-------------------------\n");
+		Hunk_PrintArenas (hunk_lowarena, "low", all);
+		Hunk_PrintArenas (hunk_higharena, "high", all);
+	}
+}
+
+/*
+===================
+Hunk_NewArena
+
+Opens an arena with room for at least size bytes on top of list
+===================
+*/
+hunkarena_t *Hunk_NewArena (hunkarena_t **list, int mark, int size)
+{
+	hunkarena_t	*arena;
+
+	if (size < hunk_growsize)
+		size = hunk_growsize;
+
+	arena = malloc (sizeof(*arena));
+	if (!arena)
+		return NULL;
+	arena->alloc = malloc (size + 15);
+	if (!arena->alloc)
+	{
+		free (arena);
+		return NULL;
+	}
+
+	arena->data = (byte *)(((long)arena->alloc + 15) & ~15);
+	arena->size = size;
+	arena->used = 0;
+	arena->start = mark;
+	arena->prev = *list;
+	*list = arena;
+
+	return arena;
+}
+
+/*
+===================
+Hunk_FreeArenas
+
+Hands back every arena on list that starts at or above mark
+===================
+*/
+void Hunk_FreeArenas (hunkarena_t **list, int mark)
+{
+	hunkarena_t	*arena;
+
+	while (*list && mark <= (*list)->start)
+	{
+		arena = *list;
+		*list = arena->prev;
+		free (arena->alloc);
+		free (arena);
+	}
+}
+
+/*
+===================
+Hunk_ArenaAlloc
+
+size already includes the hunk_t
+===================
+*/
+hunk_t *Hunk_ArenaAlloc (hunkarena_t **list, int mark, int size)
+{
+	hunkarena_t	*arena;
+	hunk_t		*h;
+
+	arena = *list;
+	if (!arena || arena->size - arena->used < size)
+	{
+		if (!hunk_growsize)
+			return NULL;
+		arena = Hunk_NewArena (list, mark, size);
+		if (!arena)
+			return NULL;
+	}
+
+	h = (hunk_t *)(arena->data + arena->used);
+	arena->used += size;
+
+	return h;
+}
+
+/*
+===================
+Hunk_Reserve
+
+Makes sure the next size bytes of low hunk allocations will be contiguous,
+for callers that copy a run of allocations out in one piece
+===================
+*/
+void Hunk_Reserve (int size)
+{
+	size += 16*sizeof(hunk_t);		// room for the headers of a few blocks
+
+	if (hunk_lowarena)
+	{
+		if (hunk_lowarena->size - hunk_lowarena->used >= size)
+			return;
+	}
+	else if (hunk_size - hunk_low_used - hunk_high_used >= size)
+		return;
+
+	if (!hunk_growsize || !Hunk_NewArena (&hunk_lowarena, Hunk_LowMark (), size))
+		Sys_Error ("Hunk_Reserve: failed on %i bytes",size);
+}
+
+/*
+===================
+Hunk_Contiguous
+
+True if everything allocated on the low hunk since mark is in one piece
+===================
+*/
+qboolean Hunk_Contiguous (int mark)
+{
+	if (!hunk_lowarena)
+		return true;
+	return mark >= hunk_lowarena->start;
+}
+
+/*
+===================
+Hunk_Uncount
+
+Takes the blocks between start and end out of the memory totals
+===================
+*/
+void Hunk_Uncount (int kind, byte *start, byte *end)
+{
+	hunk_t	*h;
+
+	for (h = (hunk_t *)start ; (byte *)h < end ; h = (hunk_t *)((byte *)h+h->size))
+	{
+		if (h->sentinal != HUNK_SENTINAL || h->size < 16)
+			Sys_Error ("Hunk_Uncount: trashed block");
+		Memory_Count (kind, h->name, 8, -h->size);
+	}
+}
+
+/*
+===================
+Hunk_UncountArenas
+
+The same for every arena on list above mark.  Returns true if mark is below
+all of them, so the main block needs uncounting too.
+===================
+*/
+qboolean Hunk_UncountArenas (int kind, hunkarena_t *list, int mark)
+{
+	for ( ; list ; list = list->prev)
+	{
+		if (mark > list->start)
+		{
+			Hunk_Uncount (kind, list->data + mark - list->start, list->data + list->used);
+			return false;
+		}
+		Hunk_Uncount (kind, list->data, list->data + list->used);
+	}
+
+	return true;
 }
 
 /*
@@ -409,19 +1019,26 @@ void *Hunk_AllocName (int size, char *name)
 		
 	size = sizeof(hunk_t) + ((size+15)&~15);
 	
-	if (hunk_size - hunk_low_used - hunk_high_used < size)
-		Sys_Error ("Hunk_Alloc: failed on %i bytes",size);
-	
-	h = (hunk_t *)(hunk_base + hunk_low_used);
-	hunk_low_used += size;
+	if (hunk_lowarena || hunk_size - hunk_low_used - hunk_high_used < size)
+	{
+		h = Hunk_ArenaAlloc (&hunk_lowarena, Hunk_LowMark (), size);
+		if (!h)
+			Sys_Error ("Hunk_Alloc: failed on %i bytes",size);
+	}
+	else
+	{
+		h = (hunk_t *)(hunk_base + hunk_low_used);
+		hunk_low_used += size;
 
-	Cache_FreeLow (hunk_low_used);
+		Cache_FreeLow (hunk_low_used);
+	}
 
 	memset (h, 0, size);
 	
 	h->size = size;
 	h->sentinal = HUNK_SENTINAL;
 	Q_strncpy (h->name, name, 8);
+	Memory_Count (MEM_LOW, name, 8, size);
 	
 	return (void *)(h+1);
 }
@@ -438,13 +1055,30 @@ void *Hunk_Alloc (int size)
 
 int	Hunk_LowMark (void)
 {
+	if (hunk_lowarena)
+		return hunk_lowarena->start + hunk_lowarena->used;
 	return hunk_low_used;
 }
 
 void Hunk_FreeToLowMark (int mark)
 {
-	if (mark < 0 || mark > hunk_low_used)
+	int		used;
+
+	if (mark < 0 || mark > Hunk_LowMark ())
 		Sys_Error ("Hunk_FreeToLowMark: bad mark %i", mark);
+
+	if (Hunk_UncountArenas (MEM_LOW, hunk_lowarena, mark))
+		Hunk_Uncount (MEM_LOW, hunk_base + mark, hunk_base + hunk_low_used);
+
+	Hunk_FreeArenas (&hunk_lowarena, mark);
+	if (hunk_lowarena)
+	{
+		used = mark - hunk_lowarena->start;
+		memset (hunk_lowarena->data + used, 0, hunk_lowarena->used - used);
+		hunk_lowarena->used = used;
+		return;
+	}
+
 	memset (hunk_base + mark, 0, hunk_low_used - mark);
 	hunk_low_used = mark;
 }
@@ -457,18 +1091,36 @@ int	Hunk_HighMark (void)
 		Hunk_FreeToHighMark (hunk_tempmark);
 	}
 
+	if (hunk_higharena)
+		return hunk_higharena->start + hunk_higharena->used;
 	return hunk_high_used;
 }
 
 void Hunk_FreeToHighMark (int mark)
 {
+	int		used;
+
 	if (hunk_tempactive)
 	{
 		hunk_tempactive = false;
 		Hunk_FreeToHighMark (hunk_tempmark);
 	}
-	if (mark < 0 || mark > hunk_high_used)
+	if (mark < 0 || mark > Hunk_HighMark ())
 		Sys_Error ("Hunk_FreeToHighMark: bad mark %i", mark);
+
+	if (Hunk_UncountArenas (MEM_HIGH, hunk_higharena, mark))
+		Hunk_Uncount (MEM_HIGH, hunk_base + hunk_size - hunk_high_used,
+			hunk_base + hunk_size - mark);
+
+	Hunk_FreeArenas (&hunk_higharena, mark);
+	if (hunk_higharena)
+	{
+		used = mark - hunk_higharena->start;
+		memset (hunk_higharena->data + used, 0, hunk_higharena->used - used);
+		hunk_higharena->used = used;
+		return;
+	}
+
 	memset (hunk_base + hunk_size - hunk_high_used, 0, hunk_high_used - mark);
 	hunk_high_used = mark;
 }
@@ -498,21 +1150,28 @@ void *Hunk_HighAllocName (int size, char *name)
 
 	size = sizeof(hunk_t) + ((size+15)&~15);
 
-	if (hunk_size - hunk_low_used - hunk_high_used < size)
+	if (hunk_higharena || hunk_size - hunk_low_used - hunk_high_used < size)
 	{
-		Con_Printf ("Hunk_HighAlloc: failed on %i bytes\n",size);
-		return NULL;
+		h = Hunk_ArenaAlloc (&hunk_higharena, Hunk_HighMark (), size);
+		if (!h)
+		{
+			Con_Printf ("Hunk_HighAlloc: failed on %i bytes\n",size);
+			return NULL;
+		}
 	}
+	else
+	{
+		hunk_high_used += size;
+		Cache_FreeHigh (hunk_high_used);
 
-	hunk_high_used += size;
-	Cache_FreeHigh (hunk_high_used);
-
-	h = (hunk_t *)(hunk_base + hunk_size - hunk_high_used);
+		h = (hunk_t *)(hunk_base + hunk_size - hunk_high_used);
+	}
 
 	memset (h, 0, size);
 	h->size = size;
 	h->sentinal = HUNK_SENTINAL;
 	Q_strncpy (h->name, name, 8);
+	Memory_Count (MEM_HIGH, name, 8, size);
 
 	return (void *)(h+1);
 }
@@ -559,6 +1218,7 @@ typedef struct cache_system_s
 	int						size;		// including this header
 	cache_user_t			*user;
 	char					name[16];
+	unsigned				lastuse;	// cache_tick when last checked
 	struct cache_system_s	*prev, *next;
 	struct cache_system_s	*lru_prev, *lru_next;	// for LRU flushing	
 } cache_system_t;
@@ -567,6 +1227,76 @@ cache_system_t *Cache_TryAlloc (int size, qboolean nobottom);
 
 cache_system_t	cache_head;
 
+// how many of the least recently used entries cache_evict 1 chooses from
+#define	CACHE_EVICT_WINDOW	16
+
+typedef struct
+{
+	int		hits;			// Cache_Check found it
+	int		misses;			// had to be loaded again
+	int		evictions;		// thrown out to make room
+	int		evictedkb;
+} cachestats_t;
+
+cachestats_t	cache_stats[CACHE_OWNERS];
+char			*cache_owners[CACHE_OWNERS] = {"other", "sound", "model"};
+unsigned		cache_tick;		// bumped on every Cache_Check, and wraps
+
+cvar_t	cache_evict = {"cache_evict", "0", true};
+
+/*
+============
+Cache_Evict
+
+Throws out an entry to make room for something else
+============
+*/
+void Cache_Evict (cache_system_t *cs)
+{
+	cachestats_t	*stats;
+
+	stats = &cache_stats[cs->user->owner];
+	stats->evictions++;
+	stats->evictedkb += (cs->size + 1023) / 1024;
+
+	Cache_Free (cs->user);
+}
+
+/*
+============
+Cache_EvictionCandidate
+
+The entry to throw out next.  Normally that is the least recently used one,
+but cache_evict 1 looks at the oldest few and takes the one with the most
+bytes for the time it has gone unused, so a big model nobody has looked at
+for a while goes before a run of small sounds that were just played.
+============
+*/
+cache_system_t *Cache_EvictionCandidate (void)
+{
+	cache_system_t	*cs, *best;
+	double			score, bestscore;
+	int				i;
+
+	best = cache_head.lru_prev;
+	if (!cache_evict.value || best == &cache_head)
+		return best;
+
+	bestscore = 0;
+	for (i=0, cs = cache_head.lru_prev ; i<CACHE_EVICT_WINDOW && cs != &cache_head ;
+		i++, cs = cs->lru_prev)
+	{
+		score = (double)cs->size * ((double)(cache_tick - cs->lastuse) + 1);	// unsigned, so a wrap is fine
+		if (score > bestscore)
+		{
+			bestscore = score;
+			best = cs;
+		}
+	}
+
+	return best;
+}
+
 /*
 ===========
 Cache_Move
@@ -584,6 +1314,8 @@ void Cache_Move ( cache_system_t *c)
 
 		Q_memcpy ( new+1, c+1, c->size - sizeof(cache_system_t) );
 		new->user = c->user;
+		new->lastuse = c->lastuse;
+		Memory_Count (MEM_CACHE, cache_owners[c->user->owner], 16, new->size);
 		Q_memcpy (new->name, c->name, sizeof(new->name));
 		Cache_Free (c->user);
 		new->user->data = (void *)(new+1);
@@ -592,7 +1324,7 @@ void Cache_Move ( cache_system_t *c)
 	{
 //		Con_Printf ("cache_move failed\n");
 
-		Cache_Free (c->user);		// tough luck...
+		Cache_Evict (c);		// tough luck...
 	}
 }
 
@@ -638,7 +1370,7 @@ void Cache_FreeHigh (int new_high_hunk)
 		if ( (byte *)c + c->size <= hunk_base + hunk_size - new_high_hunk)
 			return;		// there is space to grow the hunk
 		if (c == prev)
-			Cache_Free (c->user);	// didn't move out of the way
+			Cache_Evict (c);	// didn't move out of the way
 		else
 		{
 			Cache_Move (c);	// try to move it
@@ -785,9 +1517,53 @@ Cache_Report
 
 ============
 */
+void Cache_PrintReport (void (*print) (char *fmt, ...))
+{
+	cachestats_t	*stats;
+	cache_system_t	*cs;
+	int				i, count[CACHE_OWNERS], bytes[CACHE_OWNERS];
+
+	print ("%4.1f megabyte data cache\n", (hunk_size - hunk_high_used - hunk_low_used) / (float)(1024*1024) );
+
+	memset (count, 0, sizeof(count));
+	memset (bytes, 0, sizeof(bytes));
+	for (cs = cache_head.next ; cs != &cache_head ; cs = cs->next)
+	{
+		count[cs->user->owner]++;
+		bytes[cs->user->owner] += cs->size;
+	}
+
+	print ("        entries    bytes    hits  misses  evicted       kb\n");
+	for (i=0 ; i<CACHE_OWNERS ; i++)
+	{
+		stats = &cache_stats[i];
+		print ("%-6s %8i %8i %7i %7i %8i %8i\n", cache_owners[i], count[i], bytes[i],
+			stats->hits, stats->misses, stats->evictions, stats->evictedkb);
+	}
+	print ("eviction: %s\n", cache_evict.value ? "large and cold first" : "least recently used");
+}
+
 void Cache_Report (void)
 {
-	Con_DPrintf ("%4.1f megabyte data cache\n", (hunk_size - hunk_high_used - hunk_low_used) / (float)(1024*1024) );
+	Cache_PrintReport (Con_DPrintf);
+}
+
+/*
+============
+Cache_Stats_f
+
+cachestats [reset]
+============
+*/
+void Cache_Stats_f (void)
+{
+	if (Cmd_Argc () == 2 && !Q_strcasecmp (Cmd_Argv (1), "reset"))
+	{
+		memset (cache_stats, 0, sizeof(cache_stats));
+		return;
+	}
+
+	Cache_PrintReport (Con_Printf);
 }
 
 /*
@@ -812,6 +1588,7 @@ void Cache_Init (void)
 	cache_head.lru_next = cache_head.lru_prev = &cache_head;
 
 	Cmd_AddCommand ("flush", Cache_Flush);
+	Cmd_AddCommand ("cachestats", Cache_Stats_f);
 }
 
 /*
@@ -829,6 +1606,7 @@ void Cache_Free (cache_user_t *c)
 		Sys_Error ("Cache_Free: not allocated");
 
 	cs = ((cache_system_t *)c->data) - 1;
+	Memory_Count (MEM_CACHE, cache_owners[c->owner], 16, -cs->size);
 
 	cs->prev->next = cs->next;
 	cs->next->prev = cs->prev;
@@ -854,10 +1632,12 @@ void *Cache_Check (cache_user_t *c)
 		return NULL;
 
 	cs = ((cache_system_t *)c->data) - 1;
+	cache_stats[c->owner].hits++;
 
 // move to head of LRU
 	Cache_UnlinkLRU (cs);
 	Cache_MakeLRU (cs);
+	cs->lastuse = ++cache_tick;
 	
 	return c->data;
 }
@@ -880,6 +1660,10 @@ void *Cache_Alloc (cache_user_t *c, int size, char *name)
 
 	size = (size + sizeof(cache_system_t) + 15) & ~15;
 
+	if (c->owner < 0 || c->owner >= CACHE_OWNERS)
+		c->owner = CACHE_OTHER;
+	cache_stats[c->owner].misses++;
+
 // find memory for it	
 	while (1)
 	{
@@ -889,6 +1673,8 @@ void *Cache_Alloc (cache_user_t *c, int size, char *name)
 			strncpy (cs->name, name, sizeof(cs->name)-1);
 			c->data = (void *)(cs+1);
 			cs->user = c;
+			cs->lastuse = ++cache_tick;
+			Memory_Count (MEM_CACHE, cache_owners[c->owner], 16, size);
 			break;
 		}
 	
@@ -896,10 +1682,10 @@ void *Cache_Alloc (cache_user_t *c, int size, char *name)
 		if (cache_head.lru_prev == &cache_head)
 			Sys_Error ("Cache_Alloc: out of memory");
 													// not enough memory at all
-		Cache_Free ( cache_head.lru_prev->user );
+		Cache_Evict (Cache_EvictionCandidate ());
 	} 
 	
-	return Cache_Check (c);
+	return c->data;
 }
 
 //============================================================================
@@ -919,6 +1705,16 @@ void Memory_Init (void *buf, int size)
 	hunk_size = size;
 	hunk_low_used = 0;
 	hunk_high_used = 0;
+
+	hunk_growsize = HUNK_GROW_SIZE;
+	p = COM_CheckParm ("-hunkgrow");
+	if (p)
+	{
+		if (p < com_argc-1)
+			hunk_growsize = Q_atoi (com_argv[p+1]) * 1024;
+		else
+			Sys_Error ("Memory_Init: you must specify a size in KB after -hunkgrow");
+	}
 	
 	Cache_Init ();
 	p = COM_CheckParm ("-zone");
@@ -931,5 +1727,9 @@ void Memory_Init (void *buf, int size)
 	}
 	mainzone = Hunk_AllocName (zonesize, "zone" );
 	Z_ClearZone (mainzone, zonesize);
+	Cmd_AddCommand ("zone", Z_Print_f);
+	Cmd_AddCommand ("memstats", Memory_Stats_f);
+
+	Cvar_RegisterVariable (&cache_evict);
 }
 
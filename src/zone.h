@@ -34,6 +34,11 @@ Hunk allocations are guaranteed to be 16 byte aligned.
 The video buffers are allocated high to avoid leaving a hole underneath
 server allocations when changing to a higher video mode.
 
+When the block runs out, hunk allocations go on in overflow arenas taken from
+the system (-hunkgrow sets their size in KB, 0 turns them off).  Marks carry
+on across arenas, and freeing back to a mark releases the arenas above it, so
+the heap only needs to be as big as the cache and the common case.
+
 
 Z_??? Zone memory functions used for small, dynamic allocations like text
 strings from command input.  There is only about 48K for it, allocated at
@@ -106,11 +111,24 @@ void Hunk_FreeToHighMark (int mark);
 
 void *Hunk_TempAlloc (int size);
 
+void Hunk_Reserve (int size);
+qboolean Hunk_Contiguous (int mark);
+// everything allocated on the low hunk since a mark is only guaranteed to be
+// in one piece if Hunk_Reserve was called for it first, since a full hunk
+// goes on in a new arena
+
 void Hunk_Check (void);
 
+// owner classes, so Cache_Report can tell sounds and models apart
+#define	CACHE_OTHER		0
+#define	CACHE_SOUND		1
+#define	CACHE_MODEL		2
+#define	CACHE_OWNERS	3
+
 typedef struct cache_user_s
 {
 	void	*data;
+	int		owner;		// CACHE_*, set when the user is made
 } cache_user_t;
 
 void Cache_Flush (void);
@@ -126,6 +144,11 @@ void *Cache_Alloc (cache_user_t *c, int size, char *name);
 // wasn't enough room.
 
 void Cache_Report (void);
+// prints the cache size and the hit, miss and eviction counts if developer is set
+
+extern	struct cvar_s	cache_evict;
+// 0 throws out the least recently used data first, 1 prefers large data
+// that hasn't been used for a while
 
 
 